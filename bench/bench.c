@@ -0,0 +1,311 @@
+// Micro-benchmarks for the raster primitives of noe.
+//
+// Usage:
+//   bench [--quick] [--filter <name>] [--out <file.json>] [--no-golden]
+//   bench --golden [--filter <name>] [--update-golden]
+//   bench --compare <baseline.json> <current.json> [--threshold <ratio>]
+//
+// Every benchmark sweeps the canvas sizes and pixel formats below and reports
+// ns/op, MPix/s and GB/s, one JSON object per line so results can be diffed and
+// read back by the compare mode without a JSON parser. The golden image checks
+// and the correctness checks run first and no timings are taken while any of
+// them fails.
+
+#include "../noe.h"
+#include "../noe_ext.h"
+#include "golden.h"
+#include "checks.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_FONT_PATH "res/firacode.ttf"
+#define BENCH_MAX_RESULTS 1024
+
+typedef struct Bench {
+    noe_Context *ctx;   // headless, images are drawn into through the target stack
+    noe_Image dst;
+    noe_Image src;
+    noe_Font font;
+    int size;
+    int min, mag;       // resize strategies
+} Bench;
+
+typedef struct BenchCase {
+    const char *name;
+    void (*run)(Bench *b);
+    int per_format;     // 0 runs once per size in RGBA
+    int src_scale;      // source image is size*src_scale/2, so 2 is the same size
+    int reads;          // bytes read per written pixel, in pixels
+} BenchCase;
+
+typedef struct BenchResult {
+    char name[64];
+    int size;
+    char format[32];
+    double ns_per_op;
+    double mpix_per_s;
+    double gb_per_s;
+} BenchResult;
+
+static const char *g_format_names[_COUNT_NOE_PIXELFORMATS] = {
+    "R8G8B8A8", "R8G8B8", "B8G8R8A8", "B8G8R8", "GRAYSCALE",
+};
+static const int g_sizes[] = { 64, 256, 1024 };
+static const char *g_text = "The quick brown fox jumps over the lazy dog 0123456789";
+
+static void bench_fill(Bench *b)
+{
+    noe_image_draw_rect(b->dst, noe_rgba(0x20, 0x40, 0x60, 0xFF), noe_rect(0, 0, b->dst.w, b->dst.h));
+}
+
+static void bench_pixel(Bench *b)
+{
+    noe_Color c = noe_rgba(0x20, 0x40, 0x60, 0xFF);
+    for(int y = 0; y < b->dst.h; ++y) {
+        for(int x = 0; x < b->dst.w; ++x) noe_image_draw_pixel(b->dst, c, x, y);
+    }
+}
+
+static void bench_blit(Bench *b)
+{
+    noe_draw_image(b->ctx, b->src, 0, 0);
+}
+
+static void bench_resize(Bench *b)
+{
+    noe_image_resize(&b->dst, b->src, noe_rect(0, 0, b->dst.w, b->dst.h), b->min, b->mag);
+}
+
+static void bench_draw_image2(Bench *b)
+{
+    noe_draw_image2(b->ctx, b->src, noe_rect(0, 0, b->src.w, b->src.h), noe_rect(0, 0, b->dst.w, b->dst.h));
+}
+
+static void bench_draw_text(Bench *b)
+{
+    int fontsize = 16;
+    for(int y = 0; y + fontsize <= b->dst.h; y += fontsize) {
+        noe_draw_text(b->ctx, b->font, NOE_WHITE, g_text, 0, y, fontsize);
+    }
+}
+
+static void bench_font_load(Bench *b)
+{
+    noe_Font font = noe_load_font_from_ttf(BENCH_FONT_PATH, b->size / 4);
+    noe_unload_image(font.atlas);
+    noe_unload_font(font);
+}
+
+static double bench_time(Bench *b, void (*run)(Bench *b), double min_time, long *iterations)
+{
+    run(b); // warm up caches and lazy allocations
+    long iters = 0;
+    double begin = noe_gettime(), elapsed = 0.0;
+    long batch = 1;
+    while(elapsed < min_time) {
+        for(long i = 0; i < batch; ++i) run(b);
+        iters += batch;
+        elapsed = noe_gettime() - begin;
+        if(batch < (1 << 20)) batch *= 2;
+    }
+    *iterations = iters;
+    return elapsed;
+}
+
+static int bench_run(const char *filter, double min_time, BenchResult *results)
+{
+    static const char *strategies[] = { "nearest", "linear" };
+    int count = 0;
+    noe_Context *ctx = noe_init("bench", 16, 16, NOE_FLAG_HEADLESS);
+    if(!ctx) return 0;
+    noe_set_target_fps(ctx, 0);
+
+    noe_Font font = noe_load_font_from_ttf(BENCH_FONT_PATH, 32);
+
+    BenchCase cases[] = {
+        { "fill",        bench_fill,        1, 2, 0 },
+        { "pixel",       bench_pixel,       1, 2, 0 },
+        { "blit",        bench_blit,        1, 2, 1 },
+        { "resize",      bench_resize,      1, 1, 1 }, // downscale
+        { "resize",      bench_resize,      1, 4, 1 }, // upscale
+        { "draw_image2", bench_draw_image2, 1, 3, 1 },
+        { "draw_text",   bench_draw_text,   1, 2, 2 },
+        { "font_load",   bench_font_load,   0, 2, 0 },
+    };
+
+    for(size_t ci = 0; ci < sizeof(cases)/sizeof(cases[0]); ++ci) {
+        BenchCase *bc = &cases[ci];
+        if(filter && !strstr(bc->name, filter)) continue;
+        int is_resize = bc->run == bench_resize;
+
+        for(size_t si = 0; si < sizeof(g_sizes)/sizeof(g_sizes[0]); ++si) {
+            int formats = bc->per_format ? _COUNT_NOE_PIXELFORMATS : 1;
+            for(int format = 0; format < formats; ++format) {
+                for(int strategy = 0; strategy < (is_resize ? 2 : 1); ++strategy) {
+                    Bench b = {0};
+                    b.ctx = ctx;
+                    b.size = g_sizes[si];
+                    b.font = font;
+                    b.min = b.mag = strategy;
+                    b.dst = noe_create_image(b.size, b.size, format);
+                    int src_size = b.size * bc->src_scale / 2;
+                    b.src = noe_create_image(src_size, src_size, format);
+                    memset(b.dst.pixels, 0, (size_t)b.size * b.size * noe_pixelformat_channel_amount(format));
+                    for(size_t i = 0; i < (size_t)src_size * src_size * noe_pixelformat_channel_amount(format); ++i) {
+                        b.src.pixels[i] = (uint8_t)(i * 31);
+                    }
+
+                    noe_push_target(ctx, b.dst);
+                    long iters = 0;
+                    double elapsed = bench_time(&b, bc->run, min_time, &iters);
+                    noe_pop_target(ctx);
+
+                    BenchResult *r = &results[count++];
+                    double pixels = (double)b.size * b.size * iters;
+                    double bytes = pixels * noe_pixelformat_channel_amount(format) * (1 + bc->reads);
+                    if(is_resize) {
+                        snprintf(r->name, sizeof(r->name), "resize_%s_%s",
+                                bc->src_scale < 2 ? "down" : "up", strategies[strategy]);
+                    } else {
+                        snprintf(r->name, sizeof(r->name), "%s", bc->name);
+                    }
+                    r->size = b.size;
+                    snprintf(r->format, sizeof(r->format), "%s", g_format_names[format]);
+                    r->ns_per_op = elapsed * 1e9 / iters;
+                    r->mpix_per_s = bc->run == bench_font_load ? 0.0 : pixels / elapsed / 1e6;
+                    r->gb_per_s = bc->run == bench_font_load ? 0.0 : bytes / elapsed / 1e9;
+                    fprintf(stderr, "%-20s %5d %-10s %14.1f ns/op %10.1f MPix/s %8.2f GB/s\n",
+                            r->name, r->size, r->format, r->ns_per_op, r->mpix_per_s, r->gb_per_s);
+
+                    noe_unload_image(b.dst);
+                    noe_unload_image(b.src);
+                    if(count == BENCH_MAX_RESULTS) goto done;
+                }
+            }
+        }
+    }
+
+done:
+    noe_unload_image(font.atlas);
+    noe_unload_font(font);
+    noe_close(ctx);
+    return count;
+}
+
+static bool bench_write_json(FILE *f, const BenchResult *results, int count)
+{
+    fprintf(f, "{\"results\":[\n");
+    for(int i = 0; i < count; ++i) {
+        const BenchResult *r = &results[i];
+        fprintf(f, "{\"name\":\"%s\",\"size\":%d,\"format\":\"%s\",\"ns_per_op\":%.3f,\"mpix_per_s\":%.3f,\"gb_per_s\":%.4f}%s\n",
+                r->name, r->size, r->format, r->ns_per_op, r->mpix_per_s, r->gb_per_s, i + 1 < count ? "," : "");
+    }
+    fprintf(f, "]}\n");
+    return !ferror(f);
+}
+
+static int bench_read_json(const char *filepath, BenchResult *results)
+{
+    FILE *f = fopen(filepath, "rb");
+    if(!f) return -1;
+    char line[512];
+    int count = 0;
+    while(count < BENCH_MAX_RESULTS && fgets(line, sizeof(line), f)) {
+        BenchResult *r = &results[count];
+        if(sscanf(line, "{\"name\":\"%63[^\"]\",\"size\":%d,\"format\":\"%31[^\"]\",\"ns_per_op\":%lf,\"mpix_per_s\":%lf,\"gb_per_s\":%lf",
+                    r->name, &r->size, r->format, &r->ns_per_op, &r->mpix_per_s, &r->gb_per_s) == 6) {
+            count += 1;
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+// Returns the amount of benchmarks that got slower than threshold allows
+static int bench_compare(const char *baseline_path, const char *current_path, double threshold)
+{
+    static BenchResult baseline[BENCH_MAX_RESULTS], current[BENCH_MAX_RESULTS];
+    int baseline_count = bench_read_json(baseline_path, baseline);
+    int current_count = bench_read_json(current_path, current);
+    if(baseline_count < 0 || current_count < 0) {
+        fprintf(stderr, "Failed to read %s\n", baseline_count < 0 ? baseline_path : current_path);
+        return -1;
+    }
+
+    int regressions = 0;
+    for(int i = 0; i < current_count; ++i) {
+        BenchResult *c = &current[i];
+        for(int j = 0; j < baseline_count; ++j) {
+            BenchResult *b = &baseline[j];
+            if(b->size != c->size || strcmp(b->name, c->name) != 0 || strcmp(b->format, c->format) != 0) continue;
+            double ratio = c->ns_per_op / b->ns_per_op;
+            const char *verdict = "";
+            if(ratio > 1.0 + threshold) {
+                verdict = "REGRESSION";
+                regressions += 1;
+            } else if(ratio < 1.0 - threshold) {
+                verdict = "faster";
+            }
+            printf("%-20s %5d %-10s %14.1f -> %14.1f ns/op (%+6.1f%%) %s\n",
+                    c->name, c->size, c->format, b->ns_per_op, c->ns_per_op, (ratio - 1.0)*100.0, verdict);
+            break;
+        }
+    }
+    printf("%d regression(s) beyond %.0f%%\n", regressions, threshold*100.0);
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = NULL, *out = NULL;
+    const char *compare[2] = {0};
+    double threshold = 0.10;
+    double min_time = 0.2;
+    bool golden = true, golden_only = false, update_golden = false;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--quick") == 0) min_time = 0.02;
+        else if(strcmp(argv[i], "--no-golden") == 0) golden = false;
+        else if(strcmp(argv[i], "--golden") == 0) golden_only = true;
+        else if(strcmp(argv[i], "--update-golden") == 0) golden_only = update_golden = true;
+        else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc) out = argv[++i];
+        else if(strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) threshold = atof(argv[++i]);
+        else if(strcmp(argv[i], "--compare") == 0 && i + 2 < argc) {
+            compare[0] = argv[++i];
+            compare[1] = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--quick] [--filter <name>] [--out <file.json>] [--no-golden]\n", argv[0]);
+            fprintf(stderr, "       %s --golden [--filter <name>] [--update-golden]\n", argv[0]);
+            fprintf(stderr, "       %s --compare <baseline.json> <current.json> [--threshold <ratio>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if(compare[0]) return bench_compare(compare[0], compare[1], threshold) == 0 ? 0 : 1;
+
+    if(golden || golden_only) {
+        int failures = golden_run(golden_only ? filter : NULL, update_golden);
+        if(failures != 0) {
+            fprintf(stderr, "%d golden image check(s) failed\n", failures);
+            return 1;
+        }
+        failures = update_golden ? 0 : checks_run(golden_only ? filter : NULL);
+        if(failures != 0) {
+            fprintf(stderr, "%d check(s) failed\n", failures);
+            return 1;
+        }
+        if(golden_only) return 0;
+    }
+
+    static BenchResult results[BENCH_MAX_RESULTS];
+    int count = bench_run(filter, min_time, results);
+    FILE *f = out ? fopen(out, "wb") : stdout;
+    if(!f) {
+        fprintf(stderr, "Failed to open %s\n", out);
+        return 1;
+    }
+    bool ok = bench_write_json(f, results, count);
+    if(out) fclose(f);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,317 @@
+// Every check returns false on the first mismatch after saying what it was.
+// Files are written into CHECKS_TEMP_DIR and removed again.
+
+#include "checks.h"
+#include "../noe.h"
+#include "../noe_ext.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(cond, ...) do { if(!(cond)) { fprintf(stderr, "    " __VA_ARGS__); fputc('\n', stderr); return false; } } while(0)
+
+typedef struct Check {
+    const char *name;
+    bool (*run)(void);
+} Check;
+
+static uint32_t g_check_seed = 1;
+
+static uint32_t check_random(void)
+{
+    g_check_seed = g_check_seed*1664525u + 1013904223u;
+    return g_check_seed >> 8;
+}
+
+static float check_random_float(float min, float max)
+{
+    return min + (max - min) * (float)(check_random() & 0xFFFF) / 65535.0f;
+}
+
+// Noise with a gradient through it, so both the runs and the literals of the codecs get used
+static noe_Image check_pattern(int w, int h, int format)
+{
+    noe_Image image = noe_create_image(w, h, format);
+    for(int y = 0; y < h; ++y) {
+        for(int x = 0; x < w; ++x) {
+            uint8_t noise = (x + y) % 7 == 0 ? (uint8_t)check_random() : 0;
+            noe_image_draw_pixel(image, noe_rgba(x*5, y*3 + noise, (x ^ y) & 0xF0, 0xFF - (x & 0x3F)), x, y);
+        }
+    }
+    return image;
+}
+
+static bool check_same_image(noe_Image expected, noe_Image actual, const char *what)
+{
+    noe_ImageDiff diff;
+    CHECK(actual.pixels, "%s: no pixels", what);
+    CHECK(noe_image_diff(expected, actual, &diff), "%s: size or format changed", what);
+    CHECK(diff.max_delta == 0, "%s: %llu pixels differ", what, (unsigned long long)diff.differing_pixels);
+    return true;
+}
+
+static bool check_qoi(void)
+{
+    const char *path = CHECKS_TEMP_DIR "/check.qoi";
+    const int formats[] = { NOE_PIXELFORMAT_R8G8B8A8, NOE_PIXELFORMAT_B8G8R8 };
+    for(size_t i = 0; i < sizeof(formats)/sizeof(formats[0]); ++i) {
+        noe_Image image = check_pattern(67, 45, formats[i]);
+        bool saved = noe_image_save_to_qoifile(image, path);
+        noe_Image loaded = saved ? noe_load_image_from_file(path, formats[i]) : (noe_Image){0};
+        bool ok = saved && check_same_image(image, loaded, "qoi file");
+        noe_unload_image(loaded);
+        noe_unload_image(image);
+        remove(path);
+        CHECK(saved, "failed to save %s", path);
+        if(!ok) return false;
+    }
+    return true;
+}
+
+static bool check_png(void)
+{
+    const char *path = CHECKS_TEMP_DIR "/check.png";
+    const int levels[] = { 0, 1, NOE_PNG_DEFAULT_LEVEL, 9 };
+    noe_Image image = check_pattern(93, 71, NOE_PIXELFORMAT_R8G8B8A8);
+    bool ok = true;
+    for(size_t i = 0; ok && i < sizeof(levels)/sizeof(levels[0]); ++i) {
+        // Several threads so the rows get split into bands
+        int result = noe_image_write_png(image, path, levels[i], 3);
+        if(result != NOE_PNG_OK) {
+            fprintf(stderr, "    level %d: %s\n", levels[i], noe_png_error_string(result));
+            ok = false;
+            break;
+        }
+        noe_Image loaded = noe_load_image_from_file(path, image.format);
+        ok = check_same_image(image, loaded, "png file");
+        noe_unload_image(loaded);
+    }
+    remove(path);
+    noe_unload_image(image);
+    return ok;
+}
+
+static bool check_pack(void)
+{
+    const char *path = CHECKS_TEMP_DIR "/check.pack";
+    noe_Image image = check_pattern(50, 40, NOE_PIXELFORMAT_R8G8B8A8);
+    char data[3000];
+    for(size_t i = 0; i < sizeof(data); ++i) data[i] = (char)(i % 251 < 100 ? 'a' : check_random());
+
+    noe_PackWriter *writer = noe_pack_writer_begin(path);
+    if(!writer) noe_unload_image(image);
+    CHECK(writer, "failed to begin %s", path);
+    noe_pack_write_image(writer, "image", image, false);
+    noe_pack_write_image(writer, "image.lz", image, true);
+    noe_pack_write_data(writer, "data", data, sizeof(data), false);
+    noe_pack_write_data(writer, "data.lz", data, sizeof(data), true);
+    bool written = noe_pack_writer_end(writer);
+
+    noe_Pack *pack = written ? noe_open_pack(path) : NULL;
+    bool ok = pack != NULL;
+    const char *names[] = { "image", "image.lz" };
+    for(int i = 0; ok && i < 2; ++i) ok = check_same_image(image, noe_pack_image(pack, names[i]), names[i]);
+    for(int i = 0; ok && i < 2; ++i) {
+        size_t size = 0;
+        const void *stored = noe_pack_data(pack, i == 0 ? "data" : "data.lz", &size);
+        ok = stored && size == sizeof(data) && memcmp(stored, data, size) == 0;
+        if(!ok) fprintf(stderr, "    data entry %d differs\n", i);
+    }
+    if(ok && noe_pack_image(pack, "missing").pixels) {
+        fprintf(stderr, "    found an entry that was never written\n");
+        ok = false;
+    }
+    if(pack) noe_close_pack(pack);
+    remove(path);
+    noe_unload_image(image);
+    CHECK(written, "failed to write %s", path);
+    return ok;
+}
+
+// A file stb_truetype can't read has to come back as a failed load, not crash the worker
+static bool check_font_async(void)
+{
+    const char *bad_path = CHECKS_TEMP_DIR "/check_bad.ttf";
+    FILE *f = fopen(bad_path, "wb");
+    CHECK(f, "failed to write %s", bad_path);
+    for(int i = 0; i < 4096; ++i) fputc((int)(check_random() & 0xFF), f);
+    fclose(f);
+
+    noe_AssetLoader *loader = noe_create_asset_loader(2);
+    if(!loader) remove(bad_path);
+    CHECK(loader, "failed to create the asset loader");
+    const char *paths[] = { bad_path, CHECKS_FONT_PATH, CHECKS_TEMP_DIR "/missing.ttf" };
+    const bool expected[] = { false, true, false };
+    noe_AssetHandle handles[3];
+    for(int i = 0; i < 3; ++i) handles[i] = noe_load_font_async(loader, paths[i], 16, (void *)(intptr_t)i);
+
+    bool ok = true, seen[3] = {0};
+    double timeout = noe_gettime() + 10.0;
+    while(noe_asset_loader_pending(loader) > 0 && noe_gettime() < timeout) {
+        noe_AssetResult results[3];
+        int count = noe_asset_loader_poll(loader, results, 3);
+        for(int i = 0; i < count; ++i) {
+            int index = (int)(intptr_t)results[i].userdata;
+            seen[index] = true;
+            if(results[i].handle != handles[index] || results[i].ok != expected[index]) {
+                fprintf(stderr, "    %s loaded with ok=%d\n", paths[index], results[i].ok);
+                ok = false;
+            }
+            if(results[i].ok) {
+                noe_unload_image(results[i].font.atlas);
+                noe_unload_font(results[i].font);
+            }
+        }
+        if(count == 0) noe_sleep(1);
+    }
+    noe_destroy_asset_loader(loader);
+    remove(bad_path);
+    CHECK(seen[0] && seen[1] && seen[2], "the loads did not finish in time");
+    return ok;
+}
+
+static int check_compare_pairs(const void *a, const void *b)
+{
+    const noe_GridPair *p = a, *q = b;
+    if(p->a != q->a) return p->a < q->a ? -1 : 1;
+    return (p->b > q->b) - (p->b < q->b);
+}
+
+static bool check_grid(void)
+{
+    enum { RECTS = 600, MAX_PAIRS = RECTS*RECTS/2 };
+    noe_Grid *grid = noe_create_grid(noe_rect(0, 0, 1000, 1000), 32);
+    CHECK(grid, "failed to create the grid");
+    // Some rects reach out of the bounds, they end up in the border cells
+    for(int i = 0; i < RECTS; ++i) {
+        noe_grid_insert(grid, noe_rect((int)(check_random() % 1100) - 50, (int)(check_random() % 1100) - 50,
+                    1 + check_random() % 60, 1 + check_random() % 60));
+    }
+    for(int i = 0; i < RECTS; i += 7) noe_grid_move(grid, i, noe_rect(check_random() % 1000, check_random() % 1000, 20, 20));
+    for(int i = 3; i < RECTS; i += 11) noe_grid_remove(grid, i);
+
+    static noe_GridPair expected[MAX_PAIRS], actual[MAX_PAIRS];
+    int expected_count = 0;
+    for(int a = 0; a < RECTS; ++a) {
+        if(a >= 3 && (a - 3) % 11 == 0) continue;
+        noe_Rect ra = noe_grid_rect(grid, a);
+        for(int b = a + 1; b < RECTS; ++b) {
+            if(b >= 3 && (b - 3) % 11 == 0) continue;
+            noe_Rect rb = noe_grid_rect(grid, b);
+            if(ra.x < rb.x + rb.w && rb.x < ra.x + ra.w && ra.y < rb.y + rb.h && rb.y < ra.y + ra.h) {
+                expected[expected_count++] = (noe_GridPair){ a, b };
+            }
+        }
+    }
+
+    bool built = noe_grid_build(grid, 2);
+    int count = noe_grid_pairs(grid, actual, MAX_PAIRS);
+    noe_destroy_grid(grid);
+    CHECK(built, "failed to build the grid");
+    CHECK(count == expected_count, "%d pairs, brute force found %d", count, expected_count);
+    qsort(actual, count, sizeof(*actual), check_compare_pairs);
+    for(int i = 0; i < count; ++i) {
+        CHECK(actual[i].a == expected[i].a && actual[i].b == expected[i].b,
+                "pair %d is (%d, %d), brute force has (%d, %d)", i, actual[i].a, actual[i].b, expected[i].a, expected[i].b);
+    }
+    return true;
+}
+
+// NaN compares unequal to itself, the bits are what has to match
+static bool check_same_floats(const float *a, const float *b, int count, const char *what)
+{
+    CHECK(memcmp(a, b, sizeof(float) * count) == 0, "%s: differs from the scalar result", what);
+    return true;
+}
+
+static bool check_soa(void)
+{
+    // Not a multiple of 4, so the scalar tail runs too
+    enum { COUNT = 39 };
+    float xs[COUNT], ys[COUNT], zs[COUNT];
+    float out[4][COUNT], expected[4][COUNT];
+    for(int i = 0; i < COUNT; ++i) {
+        xs[i] = check_random_float(-500.0f, 500.0f);
+        ys[i] = check_random_float(-500.0f, 500.0f);
+        zs[i] = check_random_float(-500.0f, 500.0f);
+    }
+
+    noe_Mat2x3 m = noe_mat2x3_multiply(noe_mat2x3_translate(3.5f, -7.25f),
+            noe_mat2x3_multiply(noe_mat2x3_rotate(0.3f), noe_mat2x3_scale(1.7f, 0.6f)));
+    noe_mat2x3_transform_soa(m, xs, ys, out[0], out[1], COUNT);
+    for(int i = 0; i < COUNT; ++i) {
+        noe_Vec2 p = noe_mat2x3_transform(m, noe_vec2(xs[i], ys[i]));
+        expected[0][i] = p.x;
+        expected[1][i] = p.y;
+    }
+    if(!check_same_floats(out[0], expected[0], COUNT, "mat2x3 x")) return false;
+    if(!check_same_floats(out[1], expected[1], COUNT, "mat2x3 y")) return false;
+
+    noe_Mat4 m4;
+    for(int i = 0; i < 16; ++i) m4.es[i] = check_random_float(-2.0f, 2.0f);
+    noe_mat4_transform_soa(&m4, xs, ys, zs, out[0], out[1], out[2], out[3], COUNT);
+    for(int i = 0; i < COUNT; ++i) {
+        noe_Vec3 p = noe_mat4_transform_point(m4, noe_vec3(xs[i], ys[i], zs[i]));
+        expected[0][i] = p.x;
+        expected[1][i] = p.y;
+        expected[2][i] = p.z;
+        expected[3][i] = noe_mat4_transform(m4, noe_vec4(xs[i], ys[i], zs[i], 1.0f)).w;
+    }
+    const char *components[4] = { "mat4 x", "mat4 y", "mat4 z", "mat4 w" };
+    for(int k = 0; k < 4; ++k) {
+        if(!check_same_floats(out[k], expected[k], COUNT, components[k])) return false;
+    }
+
+    // Zero and denormal lengths are what noe_rsqrt can't refine
+    xs[0] = ys[0] = 0.0f;
+    xs[5] = 1e-30f; ys[5] = 0.0f;
+    memcpy(out[0], xs, sizeof(xs));
+    memcpy(out[1], ys, sizeof(ys));
+    noe_vec2_normalize_soa(out[0], out[1], COUNT);
+    for(int i = 0; i < COUNT; ++i) {
+        noe_Vec2 p = noe_vec2_normalize_fast(noe_vec2(xs[i], ys[i]));
+        expected[0][i] = p.x;
+        expected[1][i] = p.y;
+    }
+    if(!check_same_floats(out[0], expected[0], COUNT, "normalize x")) return false;
+    if(!check_same_floats(out[1], expected[1], COUNT, "normalize y")) return false;
+    return true;
+}
+
+static bool check_rsqrt(void)
+{
+    CHECK(noe_rsqrt(0.0f) == INFINITY, "noe_rsqrt(0) is %g", noe_rsqrt(0.0f));
+    CHECK(noe_rsqrt(INFINITY) == 0.0f, "noe_rsqrt(inf) is %g", noe_rsqrt(INFINITY));
+    CHECK(noe_rsqrt(1e-40f) == 1.0f/sqrtf(1e-40f), "noe_rsqrt of a denormal is %g", noe_rsqrt(1e-40f));
+    for(int i = 0; i < 1000; ++i) {
+        float x = ldexpf(check_random_float(1.0f, 4.0f), (int)(check_random() % 200) - 100);
+        float expected = 1.0f/sqrtf(x);
+        CHECK(fabsf(noe_rsqrt(x) - expected) <= expected * NOE_RSQRT_TOLERANCE,
+                "noe_rsqrt(%g) is %g instead of %g", x, noe_rsqrt(x), expected);
+    }
+    return true;
+}
+
+static const Check g_checks[] = {
+    { "qoi_roundtrip",  check_qoi },
+    { "png_roundtrip",  check_png },
+    { "pack_roundtrip", check_pack },
+    { "font_async",     check_font_async },
+    { "grid_pairs",     check_grid },
+    { "soa_transforms", check_soa },
+    { "rsqrt",          check_rsqrt },
+};
+
+int checks_run(const char *filter)
+{
+    int failures = 0;
+    for(size_t i = 0; i < sizeof(g_checks)/sizeof(g_checks[0]); ++i) {
+        const Check *check = &g_checks[i];
+        if(filter && !strstr(check->name, filter)) continue;
+        g_check_seed = 1;
+        bool ok = check->run();
+        fprintf(stderr, "check  %-20s %s\n", check->name, ok ? "ok" : "FAILED");
+        if(!ok) failures += 1;
+    }
+    return failures;
+}
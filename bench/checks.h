@@ -0,0 +1,14 @@
+// Correctness checks of the parts of noe the golden images don't draw: codec
+// and pack round trips, the grid against brute force and the batch math
+// against its scalar counterparts. They run together with the golden checks.
+
+#ifndef NOE_BENCH_CHECKS_H_
+#define NOE_BENCH_CHECKS_H_
+
+#define CHECKS_TEMP_DIR "build"
+#define CHECKS_FONT_PATH "res/firacode.ttf"
+
+// Returns the amount of checks that failed
+int checks_run(const char *filter);
+
+#endif // NOE_BENCH_CHECKS_H_
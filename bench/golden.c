@@ -0,0 +1,231 @@
+// Deterministic scenes rendered into offscreen images and compared against
+// stored references. References are PAM files (netpbm P7) holding the raw
+// pixels of the image, the tuple type names the noe pixel format.
+
+#include "golden.h"
+#include "../noe.h"
+#include "../noe_ext.h"
+#include <stdio.h>
+#include <string.h>
+
+#define GOLDEN_FONT_PATH "res/firacode.ttf"
+#define GOLDEN_EXACT INFINITY
+
+typedef struct GoldenScene {
+    const char *name;
+    int w, h, format;
+    double min_psnr; // GOLDEN_EXACT requires identical pixels
+    void (*render)(noe_Context *ctx, noe_Image image);
+} GoldenScene;
+
+static const char *g_golden_formats[_COUNT_NOE_PIXELFORMATS] = {
+    "R8G8B8A8", "R8G8B8", "B8G8R8A8", "B8G8R8", "GRAYSCALE",
+};
+
+static noe_Font g_golden_font;
+
+static noe_Image golden_pattern(int w, int h, int format)
+{
+    noe_Image image = noe_create_image(w, h, format);
+    for(int y = 0; y < h; ++y) {
+        for(int x = 0; x < w; ++x) {
+            noe_image_draw_pixel(image, noe_rgba(x*8, y*8, (x ^ y)*4, 0xFF), x, y);
+        }
+    }
+    return image;
+}
+
+static void golden_rects(noe_Context *ctx, noe_Image image)
+{
+    (void)ctx;
+    noe_image_draw_rect(image, noe_rgb(0x30, 0x30, 0x30), noe_rect(0, 0, image.w, image.h));
+    noe_image_draw_rect(image, NOE_RED, noe_rect(4, 4, 24, 16));
+    noe_image_draw_rect(image, noe_rgb(0x20, 0xC0, 0x60), noe_rect(-8, 30, 40, 12));
+    noe_image_draw_rect(image, noe_rgb(0x40, 0x60, 0xE0), noe_rect(50, 50, 40, 40));
+}
+
+static void golden_pixels(noe_Context *ctx, noe_Image image)
+{
+    (void)ctx;
+    for(int y = 0; y < image.h; ++y) {
+        for(int x = 0; x < image.w; ++x) {
+            noe_image_draw_pixel(image, noe_rgba(x*4, 255 - y*4, (x*y) & 0xFF, 0xFF), x, y);
+        }
+    }
+}
+
+static void golden_resize(noe_Image image, int src_size, int strategy)
+{
+    noe_Image src = golden_pattern(src_size, src_size, image.format);
+    noe_image_resize(&image, src, noe_rect(0, 0, image.w, image.h), strategy, strategy);
+    noe_unload_image(src);
+}
+
+static void golden_resize_up_nearest(noe_Context *ctx, noe_Image image)   { (void)ctx; golden_resize(image, 24, NOE_RESIZE_NEAREST); }
+static void golden_resize_up_linear(noe_Context *ctx, noe_Image image)    { (void)ctx; golden_resize(image, 24, NOE_RESIZE_LINEAR); }
+static void golden_resize_down_nearest(noe_Context *ctx, noe_Image image) { (void)ctx; golden_resize(image, 100, NOE_RESIZE_NEAREST); }
+static void golden_resize_down_linear(noe_Context *ctx, noe_Image image)  { (void)ctx; golden_resize(image, 100, NOE_RESIZE_LINEAR); }
+
+static void golden_blit_convert(noe_Context *ctx, noe_Image image)
+{
+    noe_Image src = golden_pattern(40, 40, NOE_PIXELFORMAT_R8G8B8A8);
+    noe_push_target(ctx, image);
+    noe_clear_background(ctx, NOE_BLACK);
+    noe_draw_image(ctx, src, 10, 10);
+    noe_draw_image(ctx, src, -20, 40);
+    noe_pop_target(ctx);
+    noe_unload_image(src);
+}
+
+static void golden_text(noe_Context *ctx, noe_Image image)
+{
+    noe_push_target(ctx, image);
+    noe_clear_background(ctx, noe_rgb(0x10, 0x10, 0x20));
+    noe_draw_text(ctx, g_golden_font, NOE_WHITE, "Hello, noe! 0123", 2, 2, 16);
+    noe_draw_text(ctx, g_golden_font, noe_rgb(0xFF, 0xC0, 0x40), "clipped text", 100, 16, 16);
+    noe_pop_target(ctx);
+}
+
+static void golden_shapes(noe_Context *ctx, noe_Image image)
+{
+    noe_push_target(ctx, image);
+    noe_clear_background(ctx, NOE_WHITE);
+    noe_draw_triangle_colors(ctx, noe_vec2(4, 4), noe_vec2(60, 10), noe_vec2(20, 60), NOE_RED, NOE_GREEN, NOE_BLUE);
+
+    noe_Path *path = noe_create_path();
+    noe_path_rounded_rect(path, 30.5f, 30.5f, 30, 24, 6);
+    noe_fill_path(ctx, noe_rgba(0x20, 0x20, 0x20, 0xC0), path, NOE_FILL_NONZERO);
+    noe_path_clear(path);
+    noe_path_move_to(path, 2, 62);
+    noe_path_cubic_to(path, 20, 30, 40, 70, 62, 40);
+    noe_stroke_path(ctx, noe_rgb(0x00, 0x80, 0xFF), path, 2.5f);
+    noe_destroy_path(path);
+    noe_pop_target(ctx);
+}
+
+static void golden_transformed(noe_Context *ctx, noe_Image image)
+{
+    noe_Image src = golden_pattern(32, 32, NOE_PIXELFORMAT_R8G8B8A8);
+    noe_Mat2x3 xform = noe_mat2x3_multiply(noe_mat2x3_translate(32, 32),
+            noe_mat2x3_multiply(noe_mat2x3_rotate(0.5f), noe_mat2x3_translate(-16, -16)));
+    noe_push_target(ctx, image);
+    noe_clear_background(ctx, NOE_BLACK);
+    noe_draw_image_transformed(ctx, src, noe_rect(0, 0, 32, 32), xform, NOE_RESIZE_LINEAR);
+    noe_pop_target(ctx);
+    noe_unload_image(src);
+}
+
+static const GoldenScene g_scenes[] = {
+    { "rects_rgba",          64, 64, NOE_PIXELFORMAT_R8G8B8A8,  GOLDEN_EXACT, golden_rects },
+    { "rects_rgb",           64, 64, NOE_PIXELFORMAT_R8G8B8,    GOLDEN_EXACT, golden_rects },
+    { "rects_bgra",          64, 64, NOE_PIXELFORMAT_B8G8R8A8,  GOLDEN_EXACT, golden_rects },
+    { "rects_bgr",           64, 64, NOE_PIXELFORMAT_B8G8R8,    GOLDEN_EXACT, golden_rects },
+    { "rects_gray",          64, 64, NOE_PIXELFORMAT_GRAYSCALE, GOLDEN_EXACT, golden_rects },
+    { "pixels_rgba",         64, 64, NOE_PIXELFORMAT_R8G8B8A8,  GOLDEN_EXACT, golden_pixels },
+    { "pixels_bgr",          64, 64, NOE_PIXELFORMAT_B8G8R8,    GOLDEN_EXACT, golden_pixels },
+    { "pixels_gray",         64, 64, NOE_PIXELFORMAT_GRAYSCALE, GOLDEN_EXACT, golden_pixels },
+    { "resize_up_nearest",   64, 64, NOE_PIXELFORMAT_R8G8B8A8,  GOLDEN_EXACT, golden_resize_up_nearest },
+    { "resize_up_linear",    64, 64, NOE_PIXELFORMAT_R8G8B8A8,  50.0,         golden_resize_up_linear },
+    { "resize_down_nearest", 64, 64, NOE_PIXELFORMAT_R8G8B8,    GOLDEN_EXACT, golden_resize_down_nearest },
+    { "resize_down_linear",  64, 64, NOE_PIXELFORMAT_R8G8B8,    50.0,         golden_resize_down_linear },
+    { "blit_convert_bgr",    64, 64, NOE_PIXELFORMAT_B8G8R8,    GOLDEN_EXACT, golden_blit_convert },
+    { "text_rgba",          160, 32, NOE_PIXELFORMAT_R8G8B8A8,  40.0,         golden_text },
+    { "text_bgra",          160, 32, NOE_PIXELFORMAT_B8G8R8A8,  40.0,         golden_text },
+    { "shapes_rgba",         64, 64, NOE_PIXELFORMAT_R8G8B8A8,  45.0,         golden_shapes },
+    { "transformed_rgba",    64, 64, NOE_PIXELFORMAT_R8G8B8A8,  45.0,         golden_transformed },
+};
+
+static bool golden_write_pam(const char *filepath, noe_Image image)
+{
+    FILE *f = fopen(filepath, "wb");
+    if(!f) return false;
+    int chans = noe_pixelformat_channel_amount(image.format);
+    fprintf(f, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n",
+            image.w, image.h, chans, g_golden_formats[image.format]);
+    fwrite(image.pixels, chans, (size_t)image.w * image.h, f);
+    bool ok = !ferror(f);
+    if(fclose(f) != 0) ok = false;
+    return ok;
+}
+
+static noe_Image golden_read_pam(const char *filepath)
+{
+    noe_Image image = {0};
+    FILE *f = fopen(filepath, "rb");
+    if(!f) return image;
+
+    int w = 0, h = 0, depth = 0, maxval = 0;
+    char tupltype[32] = {0};
+    if(fscanf(f, "P7 WIDTH %d HEIGHT %d DEPTH %d MAXVAL %d TUPLTYPE %31s ENDHDR", &w, &h, &depth, &maxval, tupltype) != 5
+            || fgetc(f) != '\n' || maxval != 255) {
+        fclose(f);
+        return image;
+    }
+    for(int format = 0; format < _COUNT_NOE_PIXELFORMATS; ++format) {
+        if(strcmp(tupltype, g_golden_formats[format]) != 0) continue;
+        if(noe_pixelformat_channel_amount(format) != depth) break;
+        image = noe_create_image(w, h, format);
+        if(fread(image.pixels, depth, (size_t)w * h, f) != (size_t)w * h) {
+            noe_unload_image(image);
+            image = (noe_Image){0};
+        }
+        break;
+    }
+    fclose(f);
+    return image;
+}
+
+int golden_run(const char *filter, bool update)
+{
+    noe_Context *ctx = noe_init("golden", 16, 16, NOE_FLAG_HEADLESS);
+    if(!ctx) return -1;
+    g_golden_font = noe_load_font_from_ttf(GOLDEN_FONT_PATH, 32);
+
+    int failures = 0;
+    for(size_t i = 0; i < sizeof(g_scenes)/sizeof(g_scenes[0]); ++i) {
+        const GoldenScene *scene = &g_scenes[i];
+        if(filter && !strstr(scene->name, filter)) continue;
+
+        noe_Image actual = noe_create_image(scene->w, scene->h, scene->format);
+        memset(actual.pixels, 0, (size_t)scene->w * scene->h * noe_pixelformat_channel_amount(scene->format));
+        scene->render(ctx, actual);
+
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s.pam", GOLDEN_DIR, scene->name);
+        if(update) {
+            if(!golden_write_pam(path, actual)) {
+                fprintf(stderr, "golden %-20s FAILED to write %s\n", scene->name, path);
+                failures += 1;
+            }
+            noe_unload_image(actual);
+            continue;
+        }
+
+        noe_Image expected = golden_read_pam(path);
+        noe_ImageDiff diff;
+        bool ok = false;
+        if(!expected.pixels) {
+            fprintf(stderr, "golden %-20s MISSING %s, run with --update-golden\n", scene->name, path);
+        } else if(!noe_image_diff(actual, expected, &diff)) {
+            fprintf(stderr, "golden %-20s FAILED size or format changed\n", scene->name);
+        } else {
+            ok = scene->min_psnr == GOLDEN_EXACT ? diff.max_delta == 0 : diff.psnr >= scene->min_psnr;
+            fprintf(stderr, "golden %-20s %s (%llu pixels differ, max delta %d, psnr %.1f dB)\n",
+                    scene->name, ok ? "ok" : "FAILED",
+                    (unsigned long long)diff.differing_pixels, diff.max_delta, diff.psnr);
+        }
+        if(!ok) {
+            // Keep the output around so it can be looked at next to the reference
+            snprintf(path, sizeof(path), "%s/%s.actual.pam", GOLDEN_DIR, scene->name);
+            golden_write_pam(path, actual);
+            failures += 1;
+        }
+        noe_unload_image(expected);
+        noe_unload_image(actual);
+    }
+
+    noe_unload_image(g_golden_font.atlas);
+    noe_unload_font(g_golden_font);
+    noe_close(ctx);
+    return failures;
+}
@@ -0,0 +1,15 @@
+// Golden image checks that guard the benchmarks: every scene is rendered
+// offscreen and compared against a reference stored in bench/golden.
+
+#ifndef NOE_BENCH_GOLDEN_H_
+#define NOE_BENCH_GOLDEN_H_
+
+#include <stdbool.h>
+
+#define GOLDEN_DIR "bench/golden"
+
+// Returns the amount of scenes that don't match their reference. With update
+// the references are rewritten from the current output instead.
+int golden_run(const char *filter, bool update);
+
+#endif // NOE_BENCH_GOLDEN_H_
@@ -1,15 +1,13 @@
 #include "../noe.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "../vendors/stb_image.h"
+#include "../noe_ext.h"
 
 int main(void)
 {
     noe_Context *c = noe_init("Test", 800, 600, 0);
-    int w, h, comp;
 
-    stbi_uc *data = stbi_load("res/example_cropping.png", &w, &h, &comp, 0);
-    noe_Image img = noe_load_image(data, w, h,comp == 4 ? NOE_PIXELFORMAT_R8G8B8A8 : NOE_PIXELFORMAT_R8G8B8);
+    // Decoded in the canvas format so drawing it doesn't convert every pixel
+    noe_Image img = noe_load_image_from_file("res/example_cropping.png", NOE_PIXELFORMAT_B8G8R8A8);
+    if(!img.pixels) return 1;
     noe_Rect src = noe_rect(0, 0, 16, 16);
     noe_Rect dst = noe_rect(0, 0, 100, 100);
 
@@ -29,6 +27,6 @@ int main(void)
 
         noe_draw_image2(c, img, src, dst);
     }
-    stbi_image_free(data);
+    noe_unload_image(img);
     noe_close(c);
 }
@@ -0,0 +1,40 @@
+#include "../noe.h"
+#include "../noe_ext.h"
+#include "../noe_microui.h"
+#include <stdio.h>
+
+int main(void)
+{
+    noe_Context *ctx = noe_init("microui example", 800, 600, NOE_FLAG_DEFAULT);
+    noe_Font font = noe_load_font_from_ttf("./res/firacode.ttf", 16);
+
+    static mu_Context mu;
+    mu_init(&mu);
+    noe_MuRenderer renderer;
+    noe_mu_init(&renderer, &mu, font);
+
+    int checked = 1;
+    mu_Real volume = 50;
+    int clicks = 0;
+    char label[64];
+
+    while(noe_step(ctx, NULL)) {
+        noe_mu_input(ctx, &mu);
+        mu_begin(&mu);
+        if(mu_begin_window(&mu, "Settings", mu_rect(40, 40, 300, 200))) {
+            mu_layout_row(&mu, 2, (int[]) { 120, -1 }, 0);
+            if(mu_button(&mu, "Click me")) clicks += 1;
+            snprintf(label, sizeof(label), "Clicked %d times", clicks);
+            mu_label(&mu, label);
+            mu_checkbox(&mu, "Enabled", &checked);
+            mu_slider(&mu, &volume, 0, 100);
+            mu_end_window(&mu);
+        }
+        mu_end(&mu);
+        noe_mu_render(&renderer, ctx, &mu);
+    }
+
+    noe_mu_deinit(&renderer);
+    noe_unload_font(font);
+    noe_close(ctx);
+}
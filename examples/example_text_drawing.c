@@ -8,8 +8,8 @@ int main(void)
     noe_font_to_c_header(font, "firacode.h");
     while(noe_step(c, NULL)) {
         noe_clear_background(c, NOE_BLACK);
-        noe_draw_text(c, font, "Hello, World", 100, 100, 24);
-        noe_draw_text(c, font, "Hello, World", 100, 200, 24);
+        noe_draw_text(c, font, NOE_WHITE, "Hello, World", 100, 100, 24);
+        noe_draw_text(c, font, NOE_WHITE, "Hello, World", 100, 200, 24);
     }
     noe_unload_font(font);
     noe_close(c);
@@ -1,11 +1,16 @@
 #include "../noe.h"
 #include <stdio.h>
+#include <string.h>
 
 #define GAME_TITLE "The Follower"
+#define GAME_TICK (1.0/120.0)
+#define GAME_MAX_TICKS 8
 
 typedef struct Game {
     noe_Context *ctx;
-    noe_Rect enemy;
+    // Kept in floats, sub-pixel steps of a tick would truncate away in a noe_Rect
+    noe_Vec2 enemy;
+    noe_Vec2 prev_enemy;
     double dt;
     char title[1024];
     float threshold;
@@ -17,7 +22,8 @@ typedef struct Game {
 
 void game_init(Game *game)
 {
-    game->enemy = noe_rect(0, 0, 20, 20);
+    game->enemy = noe_vec2(0, 0);
+    game->prev_enemy = game->enemy;
     game->dt = 0;
     game->speed = 100.0;
     game->threshold = 1.0;
@@ -40,18 +46,23 @@ void game_update(Game *game)
         noe_set_window_title(game->ctx, game->title);
 
         noe_Vec2 cursor = noe_cursor_pos(game->ctx);
-        noe_Vec2 dir = noe_vec2_sub(cursor, 
-                noe_vec2(game->enemy.x, game->enemy.y));
         float t2 = game->threshold*game->threshold;
-        if(noe_vec2_distance_sqr(dir) > t2) {
-            dir = noe_vec2_normalize(dir);
-            game->enemy.x += dir.x * game->speed * game->dt;
-            game->enemy.y += dir.y * game->speed * game->dt;
-        } else {
-            game->play = false;
-            double now = noe_gettime();
-            game->playtime = now - game->starttime;
-            game->enemy = noe_rect(0, 0, 20, 20);
+        int ticks = noe_fixed_steps(game->ctx);
+        for(int i = 0; i < ticks && game->play; ++i) {
+            game->prev_enemy = game->enemy;
+            noe_Vec2 dir = noe_vec2_sub(cursor, 
+                    game->enemy);
+            if(noe_vec2_distance_sqr(dir) > t2) {
+                dir = noe_vec2_normalize(dir);
+                game->enemy.x += dir.x * game->speed * GAME_TICK;
+                game->enemy.y += dir.y * game->speed * GAME_TICK;
+            } else {
+                game->play = false;
+                double now = noe_gettime();
+                game->playtime = now - game->starttime;
+                game->enemy = noe_vec2(0, 0);
+                game->prev_enemy = game->enemy;
+            }
         }
     } else {
         snprintf(game->title, sizeof(game->title), 
@@ -65,15 +76,35 @@ void game_update(Game *game)
         }
     }
 
+    // Render between the last two ticks so motion stays smooth at any frame rate
+    float alpha = noe_fixed_alpha(game->ctx);
+    noe_Rect enemy = noe_rect(
+            game->prev_enemy.x + (game->enemy.x - game->prev_enemy.x) * alpha,
+            game->prev_enemy.y + (game->enemy.y - game->prev_enemy.y) * alpha,
+            20, 20);
+
     noe_clear_background(game->ctx, NOE_WHITE);
-    noe_draw_rect(game->ctx, NOE_RED, game->enemy);
+    noe_draw_rect(game->ctx, NOE_RED, enemy);
 }
 
-int main(void)
+// Usage: game [--record <file> | --replay <file>] [--headless]
+int main(int argc, char **argv)
 {
+    const char *record = NULL, *replay = NULL;
+    uint8_t flags = NOE_FLAG_DEFAULT;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--record") == 0 && i + 1 < argc) record = argv[++i];
+        else if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc) replay = argv[++i];
+        else if(strcmp(argv[i], "--headless") == 0) flags |= NOE_FLAG_HEADLESS;
+    }
+
     Game game;
-    game.ctx = noe_init(GAME_TITLE, 800, 600, NOE_FLAG_DEFAULT);
+    game.ctx = noe_init(GAME_TITLE, 800, 600, flags);
+    if(!game.ctx) return 1;
+    if(record && !noe_record_begin(game.ctx, record)) fprintf(stderr, "Failed to record into %s\n", record);
+    if(replay && !noe_replay_begin(game.ctx, replay)) fprintf(stderr, "Failed to replay %s\n", replay);
 
+    noe_set_fixed_timestep(game.ctx, GAME_TICK, GAME_MAX_TICKS);
     game_init(&game);
     while(noe_step(game.ctx, &game.dt)) {
         game_update(&game);
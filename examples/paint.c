@@ -1,16 +1,20 @@
 #include "../noe.h"
 #include "../noe_ext.h"
+#include <stdio.h>
 
 #define MICROUI_IMPLEMENTATION
 #include "../vendors/microui.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "../vendors/stb_image_write.h"
-
 #define WINDOW_WIDTH 480
 #define WINDOW_HEIGHT 480
 #define WINDOW_TITLE "Paint"
 
+static void on_saved(const char *filepath, bool ok, void *userdata)
+{
+    (void)userdata;
+    if(ok) printf("Saved %s\n", filepath);
+    else printf("Failed to save %s\n", filepath);
+}
 
 int main(void)
 {
@@ -42,7 +46,7 @@ int main(void)
 
         if(noe_key_pressed(ctx, NOE_KEY_S)) {
             printf("Saving\n");
-            noe_image_save_to_pngfile(canvas, "result.png");
+            noe_image_save_async(ctx, canvas, "result.png", NOE_IMAGE_FILE_PNG, on_saved, NULL);
         }
         if(noe_key_pressed(ctx, NOE_KEY_C)) {
             printf("Clear mode\n");
@@ -61,5 +65,6 @@ int main(void)
         noe_draw_image_scaled_to_screen(ctx, canvas);
     }
 
+    noe_image_save_wait(ctx);
     noe_close(ctx);
 }
@@ -5,15 +5,42 @@
 ** under the terms of the MIT license. See the bottom of this file for details.
 */
 
+// clock_gettime and nanosleep for the POSIX backend under strict -std=c11
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "noe.h"
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+#if !defined(NOE_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define NOE_HAS_SSE2
+#include <emmintrin.h>
+#endif
 
 //////////////////////////////////////////////////////
 ///
 /// Utility APIs
 ///
 
+#if defined(_MSC_VER)
+#define NOE_THREAD_LOCAL __declspec(thread)
+#else
+#define NOE_THREAD_LOCAL _Thread_local
+#endif
+
+// Every allocation noe makes is counted for noe_FrameStats
+static atomic_ullong g_bytes_allocated;
+
+static void *noe_alloc(size_t size)
+{
+    atomic_fetch_add_explicit(&g_bytes_allocated, size, memory_order_relaxed);
+    return NOE_MALLOC(size);
+}
+
 noe_Rect noe_clip_rect(noe_Rect outer, noe_Rect inner)
 {
     int l, t, r, b;
@@ -25,6 +52,19 @@ noe_Rect noe_clip_rect(noe_Rect outer, noe_Rect inner)
     return noe_rect(l, t, r - l, b - t);
 }
 
+// The pixels covering [l, r] x [t, b], clipped. Clamping happens in float, so
+// huge or infinite coordinates never reach an int conversion, NaN gives nothing.
+static noe_Rect noe_clip_float_bounds(noe_Rect clip, float l, float t, float r, float b)
+{
+    // Written so that NaN fails it
+    if(!(l <= r) || !(t <= b)) return noe_rect(0, 0, 0, 0);
+    float cl = (float)clip.x, ct = (float)clip.y;
+    float cr = (float)clip.x + (float)clip.w, cb = (float)clip.y + (float)clip.h;
+    int x0 = (int)floorf(NOE_CLAMP(l, cl, cr)), y0 = (int)floorf(NOE_CLAMP(t, ct, cb));
+    int x1 = (int)ceilf(NOE_CLAMP(r, cl, cr)), y1 = (int)ceilf(NOE_CLAMP(b, ct, cb));
+    return noe_clip_rect(clip, noe_rect(x0, y0, x1 - x0, y1 - y0));
+}
+
 //////////////////////////////////////////////////////
 ///
 /// Image Related APIs
@@ -58,12 +98,13 @@ noe_Image noe_load_image(void *data, int width, int height, int format)
     res.pixels = data;
     res.texture = NULL;
     res.format = format;
+    res.stride = 0;
     return res;
 }
 
 noe_Image noe_create_image(int width, int height, int pixelformat)
 {
-    uint8_t *pixels = NOE_MALLOC(width * height * g_pixelformatinfos[pixelformat].channels);
+    uint8_t *pixels = noe_alloc(width * height * g_pixelformatinfos[pixelformat].channels);
     return noe_load_image(pixels, width, height, pixelformat);
 }
 
@@ -72,55 +113,194 @@ void noe_unload_image(noe_Image image)
     NOE_FREE(image.pixels);
 }
 
-void noe_image_draw_pixel(noe_Image image, noe_Color color, int x, int y)
+// Swaps the first and third channel of every pixel
+static void noe_swap_red_blue(uint8_t *pixels, size_t count, int chans)
 {
-    if((0 > x || x > image.w) || (0 > y || y > image.h)) return;
-    int index = (image.w * y + x) * g_pixelformatinfos[image.format].channels;
-    switch(image.format) {
-        case NOE_PIXELFORMAT_R8G8B8:
-            {
-                image.pixels[index + 0] = color.r;
-                image.pixels[index + 1] = color.g;
-                image.pixels[index + 2] = color.b;
-            }
-            break;
+    size_t i = 0;
+#ifdef NOE_HAS_SSE2
+    if(chans == 4) {
+        const __m128i rb_mask = _mm_set1_epi32(0x00FF00FF);
+        for(; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(pixels + i*4));
+            __m128i rb = _mm_and_si128(v, rb_mask);
+            rb = _mm_shufflelo_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1));
+            rb = _mm_shufflehi_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_or_si128(_mm_andnot_si128(rb_mask, v), rb);
+            _mm_storeu_si128((__m128i *)(pixels + i*4), v);
+        }
+    }
+#endif
+    for(uint8_t *px = pixels + i*chans; i < count; ++i, px += chans) NOE_SWAP(uint8_t, px[0], px[2]);
+}
+
+static inline int noe_stride(noe_Image image)
+{
+    return image.stride ? image.stride : image.w * g_pixelformatinfos[image.format].channels;
+}
+
+int noe_image_stride(noe_Image image)
+{
+    return noe_stride(image);
+}
+
+bool noe_image_convert_in_place(noe_Image *image, int format)
+{
+    if(image->format == format) return true;
+    if(noe_pixelformat_channel_amount(format) != noe_pixelformat_channel_amount(image->format)) return false;
+    // Formats with the same amount of channels only differ in the order of red and blue
+    if(format == NOE_PIXELFORMAT_GRAYSCALE) return false;
+    int chans = g_pixelformatinfos[format].channels;
+    if(noe_stride(*image) == image->w * chans) {
+        noe_swap_red_blue(image->pixels, (size_t)image->w * image->h, chans);
+    } else {
+        for(int y = 0; y < image->h; ++y) {
+            noe_swap_red_blue(image->pixels + (size_t)y * image->stride, image->w, chans);
+        }
+    }
+    image->format = format;
+    return true;
+}
+
+static inline uint8_t *noe_image_pixel_ptr(noe_Image image, int x, int y)
+{
+    return image.pixels + (size_t)y * noe_stride(image) + x * g_pixelformatinfos[image.format].channels;
+}
+
+// Packs a color into the byte order of the given pixel format
+static void noe_color_to_pixel(int format, noe_Color color, uint8_t px[4])
+{
+    switch(format) {
         case NOE_PIXELFORMAT_R8G8B8A8:
-            {
-                image.pixels[index + 0] = color.r;
-                image.pixels[index + 1] = color.g;
-                image.pixels[index + 2] = color.b;
-                image.pixels[index + 3] = color.a;
-            }
+        case NOE_PIXELFORMAT_R8G8B8:
+            px[0] = color.r; px[1] = color.g; px[2] = color.b; px[3] = color.a;
             break;
+        case NOE_PIXELFORMAT_B8G8R8A8:
         case NOE_PIXELFORMAT_B8G8R8:
-            {
-                image.pixels[index + 0] = color.b;
-                image.pixels[index + 1] = color.g;
-                image.pixels[index + 2] = color.r;
-            }
+            px[0] = color.b; px[1] = color.g; px[2] = color.r; px[3] = color.a;
             break;
-        case NOE_PIXELFORMAT_B8G8R8A8:
-            {
-                image.pixels[index + 0] = color.b;
-                image.pixels[index + 1] = color.g;
-                image.pixels[index + 2] = color.r;
-                image.pixels[index + 3] = color.a;
+        case NOE_PIXELFORMAT_GRAYSCALE:
+            px[0] = (uint8_t)(0.299f * color.r + 0.587f * color.g + 0.114f * color.b);
+            px[1] = px[2] = px[3] = px[0];
+            break;
+    }
+}
+
+static inline noe_Color noe_pixel_to_color(int format, const uint8_t *px)
+{
+    switch(format) {
+        case NOE_PIXELFORMAT_R8G8B8A8: return noe_rgba(px[0], px[1], px[2], px[3]);
+        case NOE_PIXELFORMAT_R8G8B8:   return noe_rgba(px[0], px[1], px[2], 0xFF);
+        case NOE_PIXELFORMAT_B8G8R8A8: return noe_rgba(px[2], px[1], px[0], px[3]);
+        case NOE_PIXELFORMAT_B8G8R8:   return noe_rgba(px[2], px[1], px[0], 0xFF);
+        case NOE_PIXELFORMAT_GRAYSCALE: return noe_rgba(px[0], px[0], px[0], 0xFF);
+    }
+    return NOE_BLACK;
+}
+
+// Writes `len` copies of an already packed pixel starting at (x, y). The caller
+// is responsible for clipping the span to the image.
+static void noe_image_fill_span(noe_Image image, const uint8_t *px, int x, int y, int len)
+{
+    uint8_t *dst = noe_image_pixel_ptr(image, x, y);
+    switch(g_pixelformatinfos[image.format].channels) {
+        case 1:
+            memset(dst, px[0], len);
+            break;
+        case 3:
+            for(int i = 0; i < len; ++i, dst += 3) {
+                dst[0] = px[0]; dst[1] = px[1]; dst[2] = px[2];
             }
             break;
-        case NOE_PIXELFORMAT_GRAYSCALE:
+        case 4:
             {
-                image.pixels[index] = (uint8_t )(0.299f * color.r 
-                        + 0.587f * color.g 
-                        + 0.114f * color.g);
+                uint32_t v;
+                memcpy(&v, px, 4);
+                for(int i = 0; i < len; ++i, dst += 4) memcpy(dst, &v, 4);
             }
             break;
     }
 }
 
+// Blends a packed pixel (with its alpha channel already at 255) over `dst`
+static inline void noe_blend_pixel(uint8_t *dst, const uint8_t *px, int chans, int alpha)
+{
+    for(int i = 0; i < chans; ++i) {
+        dst[i] = (uint8_t)((px[i] * alpha + dst[i] * (255 - alpha) + 127) / 255);
+    }
+}
+
+static void noe_blend_span(noe_Image image, const uint8_t *px, int x, int y, int len, int alpha)
+{
+    const int chans = g_pixelformatinfos[image.format].channels;
+    uint8_t *dst = noe_image_pixel_ptr(image, x, y);
+    for(int i = 0; i < len; ++i, dst += chans) noe_blend_pixel(dst, px, chans, alpha);
+}
+
+// Blends `count` pixels of a 4 channel format over `out` in the same format,
+// like noe_blend_pixel does with the alpha of each one. The SSE2 path rounds the
+// same way, since x/255 is (x*0x8081) >> 23 for any 16 bit x.
+static void noe_blend_pixels(uint8_t *out, const uint8_t *in, int count)
+{
+    int i = 0;
+#ifdef NOE_HAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000u);
+    const __m128i max = _mm_set1_epi16(255), round = _mm_set1_epi16(127);
+    const __m128i div255 = _mm_set1_epi16((short)0x8081);
+    for(; i + 4 <= count; i += 4, out += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(in + i*4));
+        __m128i d = _mm_loadu_si128((const __m128i *)out);
+        // The alpha of every texel in both 16 bit halves of its lane
+        __m128i a = _mm_srli_epi32(s, 24);
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+        s = _mm_or_si128(s, opaque);
+        __m128i a16[2] = { _mm_unpacklo_epi32(a, a), _mm_unpackhi_epi32(a, a) };
+        __m128i s16[2] = { _mm_unpacklo_epi8(s, zero), _mm_unpackhi_epi8(s, zero) };
+        __m128i d16[2] = { _mm_unpacklo_epi8(d, zero), _mm_unpackhi_epi8(d, zero) };
+        for(int h = 0; h < 2; ++h) {
+            // At most 255*255 + 127, so the sums stay within unsigned 16 bits
+            __m128i v = _mm_add_epi16(_mm_mullo_epi16(s16[h], a16[h]),
+                    _mm_mullo_epi16(d16[h], _mm_sub_epi16(max, a16[h])));
+            v = _mm_add_epi16(v, round);
+            d16[h] = _mm_srli_epi16(_mm_mulhi_epu16(v, div255), 7);
+        }
+        _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(d16[0], d16[1]));
+    }
+#endif
+    for(; i < count; ++i, out += 4) {
+        uint8_t px[4];
+        memcpy(px, in + i*4, 4);
+        int alpha = px[3];
+        px[3] = 0xFF;
+        noe_blend_pixel(out, px, 4, alpha);
+    }
+}
+
+// Blends a pixel of any format over `out`, by its alpha when it has one
+static inline void noe_blend_converted(uint8_t *out, int dst_format, const uint8_t *in, int src_format)
+{
+    uint8_t px[4];
+    noe_Color c = noe_pixel_to_color(src_format, in);
+    int alpha = c.a;
+    c.a = 0xFF;
+    noe_color_to_pixel(dst_format, c, px);
+    if(alpha == 0xFF) memcpy(out, px, g_pixelformatinfos[dst_format].channels);
+    else if(alpha > 0) noe_blend_pixel(out, px, g_pixelformatinfos[dst_format].channels, alpha);
+}
+
+void noe_image_draw_pixel(noe_Image image, noe_Color color, int x, int y)
+{
+    if((0 > x || x >= image.w) || (0 > y || y >= image.h)) return;
+    int chans = g_pixelformatinfos[image.format].channels;
+    uint8_t px[4];
+    noe_color_to_pixel(image.format, color, px);
+    memcpy(noe_image_pixel_ptr(image, x, y), px, chans);
+}
+
 noe_Color noe_image_get_pixel(noe_Image image, int x, int y)
 {
     if (x < 0 || x >= image.w || y < 0 || y >= image.h) return NOE_BLACK;
-    int index = (image.w * y + x) * g_pixelformatinfos[image.format].channels;
+    size_t index = noe_image_pixel_ptr(image, x, y) - image.pixels;
     noe_Color color;
     switch(image.format) {
         case NOE_PIXELFORMAT_GRAYSCALE:
@@ -164,6 +344,82 @@ noe_Color noe_image_get_pixel(noe_Image image, int x, int y)
     return color;
 }
 
+// Sum of squared differences and the largest difference over n bytes
+static void noe_diff_bytes(const uint8_t *a, const uint8_t *b, size_t n, uint64_t *sse, int *max_delta)
+{
+    size_t i = 0;
+    uint64_t sum = 0;
+    int maxd = 0;
+#ifdef NOE_HAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vmax = zero;
+    while(i + 16 <= n) {
+        // 16 bit squares of up to 255 summed in pairs fit in 32 bits, so a block of
+        // up to 2^14 vectors can accumulate before spilling into the 64 bit total
+        __m128i acc = zero;
+        size_t end = NOE_MIN(n - (n - i) % 16, i + 16 * 16384);
+        for(; i < end; i += 16) {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+            __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            vmax = _mm_max_epu8(vmax, d);
+            __m128i lo = _mm_unpacklo_epi8(d, zero);
+            __m128i hi = _mm_unpackhi_epi8(d, zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(lo, lo));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(hi, hi));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    uint8_t maxes[16];
+    _mm_storeu_si128((__m128i *)maxes, vmax);
+    for(int k = 0; k < 16; ++k) maxd = NOE_MAX(maxd, maxes[k]);
+#endif
+    for(; i < n; ++i) {
+        int d = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        sum += d * d;
+        maxd = NOE_MAX(maxd, d);
+    }
+    *sse = sum;
+    *max_delta = maxd;
+}
+
+bool noe_image_diff(noe_Image a, noe_Image b, noe_ImageDiff *diff)
+{
+    memset(diff, 0, sizeof(*diff));
+    if(a.w != b.w || a.h != b.h || a.format != b.format) return false;
+    int chans = g_pixelformatinfos[a.format].channels;
+    size_t row_size = (size_t)a.w * chans;
+    size_t n = row_size * a.h;
+    // Packed images are compared as one row
+    bool packed = noe_stride(a) == (int)row_size && noe_stride(b) == (int)row_size;
+    int rows = packed ? 1 : a.h;
+    size_t span = packed ? n : row_size;
+
+    uint64_t sse = 0;
+    for(int y = 0; y < rows; ++y) {
+        uint64_t row_sse;
+        int row_max;
+        noe_diff_bytes(a.pixels + (size_t)y * noe_stride(a), b.pixels + (size_t)y * noe_stride(b), span, &row_sse, &row_max);
+        sse += row_sse;
+        diff->max_delta = NOE_MAX(diff->max_delta, row_max);
+    }
+    diff->mse = n ? (double)sse / n : 0.0;
+    diff->psnr = diff->mse > 0 ? 10.0 * log10(255.0 * 255.0 / diff->mse) : INFINITY;
+
+    // Identical images are the common case, only count pixels when there is something to count
+    if(diff->max_delta > 0) {
+        for(int y = 0; y < rows; ++y) {
+            const uint8_t *pa = a.pixels + (size_t)y * noe_stride(a), *pb = b.pixels + (size_t)y * noe_stride(b);
+            for(size_t i = 0; i < span; i += chans) {
+                if(memcmp(pa + i, pb + i, chans) != 0) diff->differing_pixels += 1;
+            }
+        }
+    }
+    return true;
+}
+
 // Helper for bilinear interpolation
 static noe_Color noe_color_interpolate(noe_Color c1, noe_Color c2, float t) 
 {
@@ -175,30 +431,24 @@ static noe_Color noe_color_interpolate(noe_Color c1, noe_Color c2, float t)
     return result;
 }
 
-static void noe_image_resize_fill_and_crop(noe_Image dst, noe_Image src)
+// Scales the `region` of `src` into `dstdim`, only the part of `dstdim` that
+// lies within `clip` is computed. Samples are clamped to the region.
+static void noe_resize_region(noe_Image dst, noe_Rect clip, noe_Image src, noe_Rect region,
+        noe_Rect dstdim, int min, int mag)
 {
-    for(int dy = 0; dy < dst.h; ++dy) {
-        for(int dx = 0; dx < dst.w; ++dx) {
-            int sx = dx;
-            int sy = dy;
-            if(dx > src.w) sx = src.w - 1;
-            if(dy > src.h) sy = src.h - 1;
-            noe_Color color = noe_image_get_pixel(src, sx, sy);
-            noe_image_draw_pixel(dst, color, dx, dy);
-        }
-    }
-}
+    noe_Rect visible = noe_clip_rect(clip, dstdim);
+    if(visible.w <= 0 || visible.h <= 0 || region.w <= 0 || region.h <= 0) return;
 
-void noe_image_resize(noe_Image *dst, noe_Image src, noe_Rect dstdim, int min, int mag)
-{
-    float scale_x = ((float)dstdim.w)/src.w;
-    float scale_y = ((float)dstdim.h)/src.h;
+    float scale_x = ((float)dstdim.w)/region.w;
+    float scale_y = ((float)dstdim.h)/region.h;
 
     bool x_resize_strat = (scale_x < 1.0f) ? min : mag;
     bool y_resize_strat = (scale_y < 1.0f) ? min : mag;
 
-    for (int dy = 0; dy < dstdim.h; ++dy) {
-        for (int dx = 0; dx < dstdim.w; ++dx) {
+    const int xs = visible.x - dstdim.x, xe = xs + visible.w;
+    const int ys = visible.y - dstdim.y, ye = ys + visible.h;
+    for (int dy = ys; dy < ye; ++dy) {
+        for (int dx = xs; dx < xe; ++dx) {
             float sx = ((float)dx + 0.5f) / scale_x - 0.5f;
             float sy = ((float)dy + 0.5f) / scale_y - 0.5f;
 
@@ -207,24 +457,24 @@ void noe_image_resize(noe_Image *dst, noe_Image src, noe_Rect dstdim, int min, i
             if (x_resize_strat == NOE_RESIZE_NEAREST) {
                 // Nearest neighbor for x
                 int nearest_x = roundf(sx);
-                nearest_x = NOE_CLAMP(nearest_x, 0, src.w - 1);
+                nearest_x = NOE_CLAMP(nearest_x, 0, region.w - 1);
 
                 if (y_resize_strat == NOE_RESIZE_NEAREST) {
                     // Nearest neighbor for y
                     int nearest_y = roundf(sy);
-                    nearest_y = NOE_CLAMP(nearest_y, 0, src.h - 1);
-                    result = noe_image_get_pixel(src, nearest_x, nearest_y);
+                    nearest_y = NOE_CLAMP(nearest_y, 0, region.h - 1);
+                    result = noe_image_get_pixel(src, region.x + nearest_x, region.y + nearest_y);
                 } else {
                     // Linear for y
                     int y0 = (int)sy;
                     int y1 = y0 + 1;
                     float ty = sy - y0;
 
-                    y0 = NOE_CLAMP(y0, 0, src.h - 1);
-                    y1 = NOE_CLAMP(y1, 0, src.h - 1);
+                    y0 = NOE_CLAMP(y0, 0, region.h - 1);
+                    y1 = NOE_CLAMP(y1, 0, region.h - 1);
 
-                    noe_Color c0 = noe_image_get_pixel(src, nearest_x, y0);
-                    noe_Color c1 = noe_image_get_pixel(src, nearest_x, y1);
+                    noe_Color c0 = noe_image_get_pixel(src, region.x + nearest_x, region.y + y0);
+                    noe_Color c1 = noe_image_get_pixel(src, region.x + nearest_x, region.y + y1);
 
                     result = noe_color_interpolate(c0, c1, ty);
                 }
@@ -234,16 +484,16 @@ void noe_image_resize(noe_Image *dst, noe_Image src, noe_Rect dstdim, int min, i
                 int x1 = x0 + 1;
                 float tx = sx - x0;
 
-                x0 = NOE_CLAMP(x0, 0, src.w - 1);
-                x1 = NOE_CLAMP(x1, 0, src.w - 1);
+                x0 = NOE_CLAMP(x0, 0, region.w - 1);
+                x1 = NOE_CLAMP(x1, 0, region.w - 1);
 
                 if (y_resize_strat == NOE_RESIZE_NEAREST) {
                     // Nearest neighbor for y
                     int nearest_y = roundf(sy);
-                    nearest_y = (nearest_y < 0) ? 0 : (nearest_y >= src.h ? src.h - 1 : nearest_y);
+                    nearest_y = (nearest_y < 0) ? 0 : (nearest_y >= region.h ? region.h - 1 : nearest_y);
 
-                    noe_Color c0 = noe_image_get_pixel(src, x0, nearest_y);
-                    noe_Color c1 = noe_image_get_pixel(src, x1, nearest_y);
+                    noe_Color c0 = noe_image_get_pixel(src, region.x + x0, region.y + nearest_y);
+                    noe_Color c1 = noe_image_get_pixel(src, region.x + x1, region.y + nearest_y);
 
                     result = noe_color_interpolate(c0, c1, tx);
                 } else {
@@ -252,13 +502,13 @@ void noe_image_resize(noe_Image *dst, noe_Image src, noe_Rect dstdim, int min, i
                     int y1 = y0 + 1;
                     float ty = sy - y0;
 
-                    y0 = NOE_CLAMP(y0, 0, src.h - 1);
-                    y1 = NOE_CLAMP(y1, 0, src.h - 1);
+                    y0 = NOE_CLAMP(y0, 0, region.h - 1);
+                    y1 = NOE_CLAMP(y1, 0, region.h - 1);
 
-                    noe_Color c00 = noe_image_get_pixel(src, x0, y0);
-                    noe_Color c10 = noe_image_get_pixel(src, x1, y0);
-                    noe_Color c01 = noe_image_get_pixel(src, x0, y1);
-                    noe_Color c11 = noe_image_get_pixel(src, x1, y1);
+                    noe_Color c00 = noe_image_get_pixel(src, region.x + x0, region.y + y0);
+                    noe_Color c10 = noe_image_get_pixel(src, region.x + x1, region.y + y0);
+                    noe_Color c01 = noe_image_get_pixel(src, region.x + x0, region.y + y1);
+                    noe_Color c11 = noe_image_get_pixel(src, region.x + x1, region.y + y1);
 
                     // Interpolate along x-axis
                     noe_Color cx0 = noe_color_interpolate(c00, c10, tx);
@@ -269,11 +519,16 @@ void noe_image_resize(noe_Image *dst, noe_Image src, noe_Rect dstdim, int min, i
                 }
             }
 
-            noe_image_draw_pixel(*dst, result, dstdim.x + dx, dstdim.y + dy);
+            noe_image_draw_pixel(dst, result, dstdim.x + dx, dstdim.y + dy);
         }
     }
 }
 
+void noe_image_resize(noe_Image *dst, noe_Image src, noe_Rect dstdim, int min, int mag)
+{
+    noe_resize_region(*dst, noe_rect(0, 0, dst->w, dst->h), src, noe_rect(0, 0, src.w, src.h), dstdim, min, mag);
+}
+
 // void noe_image_resize(noe_Image *dst, noe_Image src)
 // {
 //     float scale_x = (float)src.w/(float)dst->w;
@@ -332,153 +587,2134 @@ void noe_image_resize(noe_Image *dst, noe_Image src, noe_Rect dstdim, int min, i
 //     }
 // }
 
+static void noe_raster_rect(noe_Image image, noe_Rect clip, noe_Color c, noe_Rect r)
+{
+    r = noe_clip_rect(clip, r);
+    if(r.w <= 0 || r.h <= 0) return;
+    uint8_t px[4];
+    noe_color_to_pixel(image.format, c, px);
+    for(int dy = r.y; dy < r.y + r.h; ++dy) {
+        noe_image_fill_span(image, px, r.x, dy, r.w);
+    }
+}
+
+// Draws `image` with its top-left corner at (x, y), converting the pixel format
+// if needed. Images with an alpha channel are blended over the target.
+static void noe_blit(noe_Image dst, noe_Rect clip, noe_Image image, int x, int y)
+{
+    noe_Rect r = noe_clip_rect(clip, noe_rect(x, y, image.w, image.h));
+    if(r.w <= 0 || r.h <= 0) return;
+    const int schans = g_pixelformatinfos[image.format].channels;
+    const int dchans = g_pixelformatinfos[dst.format].channels;
+    for(int dy = r.y; dy < r.y + r.h; ++dy) {
+        const uint8_t *in = noe_image_pixel_ptr(image, r.x - x, dy - y);
+        uint8_t *out = noe_image_pixel_ptr(dst, r.x, dy);
+        if(image.format == dst.format) {
+            if(schans == 4) noe_blend_pixels(out, in, r.w);
+            else memcpy(out, in, r.w * dchans);
+            continue;
+        }
+        for(int i = 0; i < r.w; ++i, in += schans, out += dchans) {
+            noe_blend_converted(out, dst.format, in, image.format);
+        }
+    }
+}
+
+// Blends `color` into `dst` using the scaled `region` of `mask` as coverage.
+// Grayscale masks are used as is, masks with an alpha channel use their alpha.
+static void noe_blend_mask_region(noe_Image dst, noe_Rect clip, noe_Image mask, noe_Rect region,
+        noe_Rect dstdim, noe_Color color)
+{
+    noe_Rect visible = noe_clip_rect(clip, dstdim);
+    if(visible.w <= 0 || visible.h <= 0 || region.w <= 0 || region.h <= 0 || color.a == 0) return;
+    region = noe_clip_rect(noe_rect(0, 0, mask.w, mask.h), region);
+    if(region.w <= 0 || region.h <= 0) return;
+
+    const int mchans = g_pixelformatinfos[mask.format].channels;
+    const int dchans = g_pixelformatinfos[dst.format].channels;
+    const int cov_offset = mchans == 4 ? 3 : 0;
+    uint8_t px[4];
+    noe_color_to_pixel(dst.format, noe_rgba(color.r, color.g, color.b, 0xFF), px);
+
+    const int32_t du = (int32_t)(((int64_t)region.w << 16) / dstdim.w);
+    const int32_t dv = (int32_t)(((int64_t)region.h << 16) / dstdim.h);
+    int32_t v = (visible.y - dstdim.y) * dv;
+    for(int y = visible.y; y < visible.y + visible.h; ++y, v += dv) {
+        int sy = NOE_MIN(v >> 16, region.h - 1);
+        const uint8_t *row = noe_image_pixel_ptr(mask, region.x, region.y + sy);
+        uint8_t *out = noe_image_pixel_ptr(dst, visible.x, y);
+        int32_t u = (visible.x - dstdim.x) * du;
+        for(int x = 0; x < visible.w; ++x, u += du, out += dchans) {
+            int sx = NOE_MIN(u >> 16, region.w - 1);
+            int alpha = row[sx*mchans + cov_offset] * color.a / 255;
+            if(alpha >= 255) memcpy(out, px, dchans);
+            else if(alpha > 0) noe_blend_pixel(out, px, dchans, alpha);
+        }
+    }
+}
+
+void noe_image_draw_mask(noe_Image image, noe_Image mask, noe_Rect src, noe_Rect dst, noe_Color color)
+{
+    noe_blend_mask_region(image, noe_rect(0, 0, image.w, image.h), mask, src, dst, color);
+}
+
 void noe_image_draw_rect(noe_Image image, noe_Color c, noe_Rect r)
 {
-    r = noe_clip_rect(noe_rect(0,0, image.w, image.h), r);
-    int xs = r.x, xd = r.x + r.w;
-    int ys = r.y, yd = r.y + r.h;
-    for(int dy = ys; dy < yd; ++dy) {
-        for(int dx = xs; dx < xd; ++dx) {
-            noe_image_draw_pixel(image, c, dx, dy);
+    noe_raster_rect(image, noe_rect(0, 0, image.w, image.h), c, r);
+}
+
+
+//////////////////////////////////////////////////////
+///
+/// Triangle Rasterization
+///
+/// Half-space rasterizer: every triangle is described by three edge functions
+/// E(x, y) = a*x + b*y + c that are positive inside. The bounding box is walked
+/// in 4x4 blocks; a block whose corners are all inside one edge's negative side
+/// is skipped, a block fully inside all three edges is filled with spans, and
+/// only the blocks on the border are tested per pixel (4 lanes at once with SSE2).
+///
+
+#define NOE_RASTER_BLOCK 4
+
+typedef struct noe_EdgeFn {
+    float a, b, c;
+    bool topleft;
+} noe_EdgeFn;
+
+static noe_EdgeFn noe_edgefn_make(noe_Vec2 p, noe_Vec2 q)
+{
+    noe_EdgeFn e;
+    e.a = p.y - q.y;
+    e.b = q.x - p.x;
+    e.c = p.x*q.y - p.y*q.x;
+    // Pixels exactly on an edge belong to the triangle only when that edge is
+    // a top or a left one, so triangles sharing an edge never write twice.
+    e.topleft = e.a > 0 || (e.a == 0 && e.b > 0);
+    return e;
+}
+
+static inline bool noe_edgefn_inside(noe_EdgeFn e, float v)
+{
+    return v > 0 || (v == 0 && e.topleft);
+}
+
+static void noe_raster_triangle(noe_Image image, noe_Rect clip, noe_Vec2 v0, noe_Vec2 v1, noe_Vec2 v2,
+        const noe_Color *colors, noe_Color flat)
+{
+    noe_Color c0, c1, c2;
+    if(colors) {
+        c0 = colors[0];
+        c1 = colors[1];
+        c2 = colors[2];
+    } else {
+        c0 = c1 = c2 = flat;
+    }
+
+    float area = (v1.x - v0.x)*(v2.y - v0.y) - (v1.y - v0.y)*(v2.x - v0.x);
+    if(area == 0.0f || !isfinite(area)) return;
+    if(area < 0) {
+        NOE_SWAP(noe_Vec2, v1, v2);
+        NOE_SWAP(noe_Color, c1, c2);
+        area = -area;
+    }
+
+    noe_Rect bbox = noe_clip_float_bounds(clip,
+            NOE_MIN(v0.x, NOE_MIN(v1.x, v2.x)), NOE_MIN(v0.y, NOE_MIN(v1.y, v2.y)),
+            NOE_MAX(v0.x, NOE_MAX(v1.x, v2.x)), NOE_MAX(v0.y, NOE_MAX(v1.y, v2.y)));
+    if(bbox.w <= 0 || bbox.h <= 0) return;
+
+    // e[0] is opposite to v0 so its value is the (unnormalized) weight of v0
+    noe_EdgeFn e[3];
+    e[0] = noe_edgefn_make(v1, v2);
+    e[1] = noe_edgefn_make(v2, v0);
+    e[2] = noe_edgefn_make(v0, v1);
+
+    const int chans = g_pixelformatinfos[image.format].channels;
+    const float inv_area = 1.0f/area;
+    uint8_t flatpx[4];
+    noe_color_to_pixel(image.format, c0, flatpx);
+
+    const int xend = bbox.x + bbox.w;
+    const int yend = bbox.y + bbox.h;
+
+#ifdef NOE_HAS_SSE2
+    const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 stepx[3], tlmask[3];
+    for(int i = 0; i < 3; ++i) {
+        stepx[i] = _mm_mul_ps(_mm_set1_ps(e[i].a), lane);
+        tlmask[i] = _mm_castsi128_ps(_mm_set1_epi32(e[i].topleft ? -1 : 0));
+    }
+#endif
+
+    for(int by = bbox.y; by < yend; by += NOE_RASTER_BLOCK) {
+        int bh = NOE_MIN(NOE_RASTER_BLOCK, yend - by);
+        for(int bx = bbox.x; bx < xend; bx += NOE_RASTER_BLOCK) {
+            int bw = NOE_MIN(NOE_RASTER_BLOCK, xend - bx);
+
+            // Edge values at the center of the top-left pixel of the block and
+            // the classification of the whole block from its extreme corners.
+            float px = bx + 0.5f, py = by + 0.5f;
+            float origin[3];
+            bool reject = false, accept = true;
+            for(int i = 0; i < 3; ++i) {
+                origin[i] = e[i].a*px + e[i].b*py + e[i].c;
+                float dx = (float)(bw - 1), dy = (float)(bh - 1);
+                float emax = origin[i] + NOE_MAX(e[i].a, 0.0f)*dx + NOE_MAX(e[i].b, 0.0f)*dy;
+                float emin = origin[i] + NOE_MIN(e[i].a, 0.0f)*dx + NOE_MIN(e[i].b, 0.0f)*dy;
+                if(!noe_edgefn_inside(e[i], emax)) reject = true;
+                if(!noe_edgefn_inside(e[i], emin)) accept = false;
+            }
+            if(reject) continue;
+
+            if(accept && !colors) {
+                for(int y = by; y < by + bh; ++y) {
+                    noe_image_fill_span(image, flatpx, bx, y, bw);
+                }
+                continue;
+            }
+
+            for(int row = 0; row < bh; ++row) {
+                int y = by + row;
+                float w[3][NOE_RASTER_BLOCK];
+                int mask = 0;
+#ifdef NOE_HAS_SSE2
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for(int i = 0; i < 3; ++i) {
+                    __m128 ev = _mm_add_ps(_mm_set1_ps(origin[i] + e[i].b*row), stepx[i]);
+                    __m128 on = _mm_and_ps(_mm_cmpeq_ps(ev, zero), tlmask[i]);
+                    inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(ev, zero), on));
+                    _mm_storeu_ps(w[i], _mm_mul_ps(ev, _mm_set1_ps(inv_area)));
+                }
+                mask = _mm_movemask_ps(inside) & ((1 << bw) - 1);
+#else
+                for(int lx = 0; lx < bw; ++lx) {
+                    bool in = true;
+                    for(int i = 0; i < 3; ++i) {
+                        float ev = origin[i] + e[i].b*row + e[i].a*lx;
+                        if(!noe_edgefn_inside(e[i], ev)) in = false;
+                        w[i][lx] = ev*inv_area;
+                    }
+                    if(in) mask |= 1 << lx;
+                }
+#endif
+                if(!mask) continue;
+                uint8_t *dst = noe_image_pixel_ptr(image, bx, y);
+                for(int lx = 0; lx < bw; ++lx) {
+                    if(!(mask & (1 << lx))) continue;
+                    if(colors) {
+                        noe_Color c;
+                        c.r = (uint8_t)NOE_CLAMP(c0.r*w[0][lx] + c1.r*w[1][lx] + c2.r*w[2][lx] + 0.5f, 0.0f, 255.0f);
+                        c.g = (uint8_t)NOE_CLAMP(c0.g*w[0][lx] + c1.g*w[1][lx] + c2.g*w[2][lx] + 0.5f, 0.0f, 255.0f);
+                        c.b = (uint8_t)NOE_CLAMP(c0.b*w[0][lx] + c1.b*w[1][lx] + c2.b*w[2][lx] + 0.5f, 0.0f, 255.0f);
+                        c.a = (uint8_t)NOE_CLAMP(c0.a*w[0][lx] + c1.a*w[1][lx] + c2.a*w[2][lx] + 0.5f, 0.0f, 255.0f);
+                        uint8_t pixel[4];
+                        noe_color_to_pixel(image.format, c, pixel);
+                        memcpy(dst + lx*chans, pixel, chans);
+                    } else {
+                        memcpy(dst + lx*chans, flatpx, chans);
+                    }
+                }
+            }
         }
     }
 }
 
+static void noe_raster_polygon(noe_Image image, noe_Rect clip, noe_Color color, const noe_Vec2 *points, int count)
+{
+    // Convex polygons are split into a fan; the shared diagonals are resolved
+    // by the top-left rule so no pixel is touched twice.
+    for(int i = 1; i + 1 < count; ++i) {
+        noe_raster_triangle(image, clip, points[0], points[i], points[i + 1], NULL, color);
+    }
+}
+
+void noe_image_draw_triangle(noe_Image image, noe_Color color, noe_Vec2 a, noe_Vec2 b, noe_Vec2 c)
+{
+    noe_raster_triangle(image, noe_rect(0, 0, image.w, image.h), a, b, c, NULL, color);
+}
+
+void noe_image_draw_triangle_colors(noe_Image image, noe_Vec2 a, noe_Vec2 b, noe_Vec2 c,
+        noe_Color ca, noe_Color cb, noe_Color cc)
+{
+    noe_Color colors[3] = { ca, cb, cc };
+    noe_raster_triangle(image, noe_rect(0, 0, image.w, image.h), a, b, c, colors, ca);
+}
+
+void noe_image_draw_polygon(noe_Image image, noe_Color color, const noe_Vec2 *points, int count)
+{
+    noe_raster_polygon(image, noe_rect(0, 0, image.w, image.h), color, points, count);
+}
 
 //////////////////////////////////////////////////////
 ///
-/// Context Related APIs
+/// Vector Paths
+///
+/// Paths are flattened into polylines as they are built. Filling accumulates the
+/// signed area every edge covers into a per-scanline cell buffer (the same idea
+/// stb_truetype uses for glyphs), then a running sum over each scanline gives the
+/// winding coverage of every pixel. Only the cells an edge touched need blending,
+/// everything between them is either empty or a solid span.
 ///
 
-#define NOE_SUPPORTED_KEYS 256
-#define NOE_SUPPORTED_BTNS 8
+#define NOE_PATH_TOLERANCE 0.25f
+
+typedef struct noe_PathContour {
+    int start;
+    bool closed;
+} noe_PathContour;
+
+struct noe_Path {
+    noe_Vec2 *points;
+    int points_count;
+    int points_capacity;
+    noe_PathContour *contours;
+    int contours_count;
+    int contours_capacity;
+    bool failed; // a point could not be stored, drawing the path does nothing
+};
 
-typedef struct noe_PlatformContext noe_PlatformContext;
+// Returns NULL when the array can not grow, `items` is left as it was then
+static void *noe_grow_array(void *items, int count, int *capacity, int needed, size_t size)
+{
+    if(needed <= *capacity) return items;
+    int newcap = *capacity ? *capacity : 16;
+    while(newcap < needed) {
+        if(newcap > INT_MAX / 2) return NULL;
+        newcap *= 2;
+    }
+    void *newitems = noe_alloc((size_t)newcap * size);
+    if(!newitems) return NULL;
+    if(items) {
+        memcpy(newitems, items, count * size);
+        NOE_FREE(items);
+    }
+    *capacity = newcap;
+    return newitems;
+}
 
-typedef struct noe_Context {
-    bool initialized;
-    bool should_close;
+noe_Path *noe_create_path(void)
+{
+    noe_Path *path = noe_alloc(sizeof(*path));
+    if(!path) return NULL;
+    memset(path, 0, sizeof(*path));
+    return path;
+}
 
-    const char *name;
-    const char *title;
-    noe_Image canvas;
+void noe_destroy_path(noe_Path *path)
+{
+    if(!path) return;
+    if(path->points) NOE_FREE(path->points);
+    if(path->contours) NOE_FREE(path->contours);
+    NOE_FREE(path);
+}
 
-    bool prev_key_states[NOE_SUPPORTED_KEYS];
-    bool curr_key_states[NOE_SUPPORTED_KEYS];
-    bool prev_btn_states[NOE_SUPPORTED_BTNS];
-    bool curr_btn_states[NOE_SUPPORTED_BTNS];
+void noe_path_clear(noe_Path *path)
+{
+    path->points_count = 0;
+    path->contours_count = 0;
+    path->failed = false;
+}
 
-    noe_Vec2 prev_cursor_pos;
-    noe_Vec2 curr_cursor_pos;
-    noe_Vec2 prev_wheel_mov;
-    noe_Vec2 curr_wheel_mov;
+static void noe_path_push_point(noe_Path *path, noe_Vec2 p)
+{
+    noe_Vec2 *points = noe_grow_array(path->points, path->points_count,
+            &path->points_capacity, path->points_count + 1, sizeof(*path->points));
+    if(!points) {
+        path->failed = true;
+        return;
+    }
+    path->points = points;
+    path->points[path->points_count++] = p;
+}
 
-    double init_time;
-    double last_frame_time;
-    double target_frame_time;
+static noe_Vec2 noe_path_last_point(noe_Path *path)
+{
+    if(path->points_count == 0) return noe_vec2(0, 0);
+    return path->points[path->points_count - 1];
+}
 
-    noe_PlatformContext *platform;
-} noe_Context;
+void noe_path_move_to(noe_Path *path, float x, float y)
+{
+    noe_PathContour *contours = noe_grow_array(path->contours, path->contours_count,
+            &path->contours_capacity, path->contours_count + 1, sizeof(*path->contours));
+    if(!contours) {
+        path->failed = true;
+        return;
+    }
+    path->contours = contours;
+    noe_PathContour *contour = &path->contours[path->contours_count++];
+    contour->start = path->points_count;
+    contour->closed = false;
+    noe_path_push_point(path, noe_vec2(x, y));
+}
 
+void noe_path_line_to(noe_Path *path, float x, float y)
+{
+    if(path->contours_count == 0) noe_path_move_to(path, x, y);
+    else noe_path_push_point(path, noe_vec2(x, y));
+}
 
-/// Platform spesific functions forward declaration
+// The number of segments is picked from the length of the control polygon so
+// that the flattening error stays around NOE_PATH_TOLERANCE pixels.
+static int noe_path_curve_segments(float length)
+{
+    int n = (int)ceilf(sqrtf(length / NOE_PATH_TOLERANCE) * 0.5f);
+    return NOE_CLAMP(n, 1, 128);
+}
 
-bool noe_platform_init(noe_Context *ctx);
-void noe_platform_close(noe_Context *ctx);
-void noe_platform_poll_inputs(noe_Context *ctx);
-void noe_platform_redraw_surface(noe_Context *ctx);
-void noe_sleep(int milis);
-void noe_set_window_title(noe_Context *ctx, const char *title);
-double noe_gettime(void);
+void noe_path_quad_to(noe_Path *path, float cx, float cy, float x, float y)
+{
+    if(path->contours_count == 0) noe_path_move_to(path, cx, cy);
+    noe_Vec2 p0 = noe_path_last_point(path);
+    float length = hypotf(cx - p0.x, cy - p0.y) + hypotf(x - cx, y - cy);
+    int n = noe_path_curve_segments(length);
+    for(int i = 1; i <= n; ++i) {
+        float t = (float)i / n, mt = 1.0f - t;
+        noe_path_push_point(path, noe_vec2(
+                mt*mt*p0.x + 2*mt*t*cx + t*t*x,
+                mt*mt*p0.y + 2*mt*t*cy + t*t*y));
+    }
+}
 
-noe_Context *noe_init(const char *name, int w, int h, uint8_t flags)
+void noe_path_cubic_to(noe_Path *path, float c1x, float c1y, float c2x, float c2y, float x, float y)
 {
-    (void)flags;
-    noe_Context *ctx = NOE_MALLOC(sizeof(*ctx));
-    memset(ctx, 0, sizeof(noe_Context));
-    if(!ctx) return NULL;
+    if(path->contours_count == 0) noe_path_move_to(path, c1x, c1y);
+    noe_Vec2 p0 = noe_path_last_point(path);
+    float length = hypotf(c1x - p0.x, c1y - p0.y) + hypotf(c2x - c1x, c2y - c1y) + hypotf(x - c2x, y - c2y);
+    int n = noe_path_curve_segments(length);
+    for(int i = 1; i <= n; ++i) {
+        float t = (float)i / n, mt = 1.0f - t;
+        float k0 = mt*mt*mt, k1 = 3*mt*mt*t, k2 = 3*mt*t*t, k3 = t*t*t;
+        noe_path_push_point(path, noe_vec2(
+                k0*p0.x + k1*c1x + k2*c2x + k3*x,
+                k0*p0.y + k1*c1y + k2*c2y + k3*y));
+    }
+}
 
-    ctx->name = name;
-    ctx->title = name;
-    ctx->should_close = false;
+void noe_path_close(noe_Path *path)
+{
+    if(path->contours_count == 0) return;
+    path->contours[path->contours_count - 1].closed = true;
+}
+
+void noe_path_rounded_rect(noe_Path *path, float x, float y, float w, float h, float r)
+{
+    // Cubic approximation of a quarter circle
+    const float k = 0.5522847f;
+    r = NOE_MIN(r, NOE_MIN(w, h) * 0.5f);
+    noe_path_move_to(path, x + r, y);
+    noe_path_line_to(path, x + w - r, y);
+    noe_path_cubic_to(path, x + w - r + r*k, y, x + w, y + r - r*k, x + w, y + r);
+    noe_path_line_to(path, x + w, y + h - r);
+    noe_path_cubic_to(path, x + w, y + h - r + r*k, x + w - r + r*k, y + h, x + w - r, y + h);
+    noe_path_line_to(path, x + r, y + h);
+    noe_path_cubic_to(path, x + r - r*k, y + h, x, y + h - r + r*k, x, y + h - r);
+    noe_path_line_to(path, x, y + r);
+    noe_path_cubic_to(path, x, y + r - r*k, x + r - r*k, y, x + r, y);
+    noe_path_close(path);
+}
+
+typedef struct noe_Coverage {
+    float *cells;      // (w + 2) cells per scanline
+    int *span_min;     // first touched cell per scanline
+    int *span_max;     // last touched cell per scanline
+    noe_Rect area;
+    int pitch;
+} noe_Coverage;
+
+static void noe_coverage_add_line(noe_Coverage *cov, noe_Vec2 p0, noe_Vec2 p1)
+{
+    if(p0.y == p1.y) return;
+    float dir = 1.0f;
+    if(p0.y > p1.y) {
+        NOE_SWAP(noe_Vec2, p0, p1);
+        dir = -1.0f;
+    }
+    p0.x -= cov->area.x; p1.x -= cov->area.x;
+    p0.y -= cov->area.y; p1.y -= cov->area.y;
+    if(p1.y <= 0 || p0.y >= cov->area.h) return;
+
+    const float maxx = (float)cov->area.w;
+    float dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+    float ystart = NOE_MAX(p0.y, 0.0f);
+    float yend = NOE_MIN(p1.y, (float)cov->area.h);
+    float x = p0.x + (ystart - p0.y) * dxdy;
+
+    for(int y = (int)ystart; (float)y < yend; ++y) {
+        float ytop = NOE_MAX((float)y, ystart);
+        float ybot = NOE_MIN((float)(y + 1), yend);
+        float dy = ybot - ytop;
+        float xnext = x + dxdy * dy;
+        float d = dy * dir;
+        // Cells left of the coverage area only shift the running sum, so the
+        // edge can be projected onto the boundary without changing the result.
+        float xa = NOE_CLAMP(NOE_MIN(x, xnext), 0.0f, maxx);
+        float xb = NOE_CLAMP(NOE_MAX(x, xnext), 0.0f, maxx);
+        float *row = cov->cells + y * cov->pitch;
+
+        float xafloor = floorf(xa);
+        int xai = (int)xafloor;
+        int xbi = (int)ceilf(xb);
+        if(xbi <= xai + 1) {
+            float xmf = 0.5f * (xa + xb) - xafloor;
+            row[xai] += d - d * xmf;
+            row[xai + 1] += d * xmf;
+        } else {
+            float s = 1.0f / (xb - xa);
+            float xaf = xa - xafloor;
+            float a0 = 0.5f * s * (1.0f - xaf) * (1.0f - xaf);
+            float xbf = xb - xbi + 1.0f;
+            float am = 0.5f * s * xbf * xbf;
+            row[xai] += d * a0;
+            if(xbi == xai + 2) {
+                row[xai + 1] += d * (1.0f - a0 - am);
+            } else {
+                float a1 = s * (1.5f - xaf);
+                row[xai + 1] += d * (a1 - a0);
+                for(int xi = xai + 2; xi < xbi - 1; ++xi) row[xi] += d * s;
+                float a2 = a1 + (xbi - xai - 3) * s;
+                row[xbi - 1] += d * (1.0f - a2 - am);
+            }
+            row[xbi] += d * am;
+        }
+        cov->span_min[y] = NOE_MIN(cov->span_min[y], xai);
+        cov->span_max[y] = NOE_MAX(cov->span_max[y], xbi);
+        x = xnext;
+    }
+}
+
+static inline float noe_coverage_apply_rule(float winding, int fill_rule)
+{
+    winding = fabsf(winding);
+    if(fill_rule == NOE_FILL_EVENODD) {
+        winding = fmodf(winding, 2.0f);
+        if(winding > 1.0f) winding = 2.0f - winding;
+        return winding;
+    }
+    return NOE_MIN(winding, 1.0f);
+}
+
+static void noe_raster_path(noe_Image image, noe_Rect clip, noe_Color color, const noe_Path *path, int fill_rule)
+{
+    if(path->failed || path->points_count < 2 || color.a == 0) return;
+
+    float minx = path->points[0].x, maxx = minx;
+    float miny = path->points[0].y, maxy = miny;
+    for(int i = 0; i < path->points_count; ++i) {
+        noe_Vec2 p = path->points[i];
+        // Coverage would turn into NaN alphas
+        if(!isfinite(p.x) || !isfinite(p.y)) return;
+        minx = NOE_MIN(minx, p.x);
+        maxx = NOE_MAX(maxx, p.x);
+        miny = NOE_MIN(miny, p.y);
+        maxy = NOE_MAX(maxy, p.y);
+    }
+    noe_Rect bbox = noe_clip_float_bounds(clip, minx, miny, maxx + 1.0f, maxy + 1.0f);
+    if(bbox.w <= 0 || bbox.h <= 0) return;
+
+    noe_Coverage cov;
+    cov.area = bbox;
+    cov.pitch = bbox.w + 2;
+    cov.cells = noe_alloc(sizeof(float) * cov.pitch * bbox.h);
+    cov.span_min = noe_alloc(sizeof(int) * bbox.h * 2);
+    cov.span_max = cov.span_min + bbox.h;
+    if(!cov.cells || !cov.span_min) {
+        if(cov.cells) NOE_FREE(cov.cells);
+        if(cov.span_min) NOE_FREE(cov.span_min);
+        return;
+    }
+    memset(cov.cells, 0, sizeof(float) * cov.pitch * bbox.h);
+    for(int y = 0; y < bbox.h; ++y) {
+        cov.span_min[y] = cov.pitch;
+        cov.span_max[y] = -1;
+    }
+
+    for(int c = 0; c < path->contours_count; ++c) {
+        int start = path->contours[c].start;
+        int end = c + 1 < path->contours_count ? path->contours[c + 1].start : path->points_count;
+        for(int i = start; i < end; ++i) {
+            // Filling always closes the contour
+            noe_Vec2 p1 = path->points[i + 1 < end ? i + 1 : start];
+            noe_coverage_add_line(&cov, path->points[i], p1);
+        }
+    }
+
+    const int chans = g_pixelformatinfos[image.format].channels;
+    uint8_t px[4];
+    noe_color_to_pixel(image.format, noe_rgba(color.r, color.g, color.b, 0xFF), px);
+
+    for(int y = 0; y < bbox.h; ++y) {
+        if(cov.span_max[y] < 0) continue;
+        const float *row = cov.cells + y * cov.pitch;
+        int xend = NOE_MIN(bbox.w, cov.span_max[y] + 1);
+        float winding = 0.0f;
+        int x = cov.span_min[y];
+        for(int i = 0; i < x; ++i) winding += row[i];
+
+        while(x < xend) {
+            winding += row[x];
+            float a = noe_coverage_apply_rule(winding, fill_rule);
+            // Runs of untouched cells keep the same coverage, emit them as one span
+            int run = 1;
+            while(x + run < xend && row[x + run] == 0.0f) ++run;
+            int alpha = (int)(a * color.a + 0.5f);
+            if(alpha >= 255) {
+                noe_image_fill_span(image, px, bbox.x + x, bbox.y + y, run);
+            } else if(alpha > 0) {
+                if(run == 1) {
+                    uint8_t *dst = noe_image_pixel_ptr(image, bbox.x + x, bbox.y + y);
+                    noe_blend_pixel(dst, px, chans, alpha);
+                } else {
+                    noe_blend_span(image, px, bbox.x + x, bbox.y + y, run, alpha);
+                }
+            }
+            x += run;
+        }
+    }
+
+    NOE_FREE(cov.cells);
+    NOE_FREE(cov.span_min);
+}
+
+static void noe_path_push_polygon(noe_Path *path, const noe_Vec2 *points, int count, float orientation)
+{
+    float area = 0.0f;
+    for(int i = 0; i < count; ++i) {
+        noe_Vec2 p = points[i], q = points[(i + 1) % count];
+        area += p.x*q.y - q.x*p.y;
+    }
+    // Every piece of a stroke must wind the same way, otherwise overlapping
+    // pieces would cancel each other out under the nonzero rule.
+    bool reverse = area * orientation < 0;
+    for(int i = 0; i < count; ++i) {
+        noe_Vec2 p = points[reverse ? count - 1 - i : i];
+        if(i == 0) noe_path_move_to(path, p.x, p.y);
+        else noe_path_line_to(path, p.x, p.y);
+    }
+    noe_path_close(path);
+}
+
+static void noe_stroke_to_path(noe_Path *out, const noe_Path *path, float width)
+{
+    const float hw = width * 0.5f;
+    for(int c = 0; c < path->contours_count; ++c) {
+        int start = path->contours[c].start;
+        int end = c + 1 < path->contours_count ? path->contours[c + 1].start : path->points_count;
+        bool closed = path->contours[c].closed;
+        int segments = closed ? end - start : end - start - 1;
+
+        bool has_prev = false;
+        noe_Vec2 prev_normal = noe_vec2(0, 0), first_normal = noe_vec2(0, 0);
+        for(int s = 0; s < segments; ++s) {
+            noe_Vec2 p = path->points[start + s];
+            noe_Vec2 q = path->points[start + (s + 1) % (end - start)];
+            noe_Vec2 d = noe_vec2_sub(q, p);
+            float len = sqrtf(noe_vec2_dot(d, d));
+            if(len <= 0.0f) continue;
+            noe_Vec2 n = noe_vec2(-d.y / len * hw, d.x / len * hw);
+
+            noe_Vec2 quad[4] = {
+                noe_vec2(p.x + n.x, p.y + n.y), noe_vec2(q.x + n.x, q.y + n.y),
+                noe_vec2(q.x - n.x, q.y - n.y), noe_vec2(p.x - n.x, p.y - n.y),
+            };
+            noe_path_push_polygon(out, quad, 4, 1.0f);
+
+            // Bevel joins, one of the two triangles always ends up inside the stroke
+            if(has_prev) {
+                noe_Vec2 outer[3] = { p, noe_vec2(p.x + prev_normal.x, p.y + prev_normal.y), noe_vec2(p.x + n.x, p.y + n.y) };
+                noe_Vec2 inner[3] = { p, noe_vec2(p.x - prev_normal.x, p.y - prev_normal.y), noe_vec2(p.x - n.x, p.y - n.y) };
+                noe_path_push_polygon(out, outer, 3, 1.0f);
+                noe_path_push_polygon(out, inner, 3, 1.0f);
+            } else {
+                first_normal = n;
+            }
+            prev_normal = n;
+            has_prev = true;
+        }
+
+        if(closed && has_prev) {
+            noe_Vec2 p = path->points[start];
+            noe_Vec2 outer[3] = { p, noe_vec2(p.x + prev_normal.x, p.y + prev_normal.y), noe_vec2(p.x + first_normal.x, p.y + first_normal.y) };
+            noe_Vec2 inner[3] = { p, noe_vec2(p.x - prev_normal.x, p.y - prev_normal.y), noe_vec2(p.x - first_normal.x, p.y - first_normal.y) };
+            noe_path_push_polygon(out, outer, 3, 1.0f);
+            noe_path_push_polygon(out, inner, 3, 1.0f);
+        }
+    }
+}
+
+static void noe_raster_stroke(noe_Image image, noe_Rect clip, noe_Color color, const noe_Path *path, float width)
+{
+    if(path->failed || width <= 0.0f) return;
+    noe_Path *outline = noe_create_path();
+    if(!outline) return;
+    noe_stroke_to_path(outline, path, width);
+    noe_raster_path(image, clip, color, outline, NOE_FILL_NONZERO);
+    noe_destroy_path(outline);
+}
+
+void noe_image_fill_path(noe_Image image, noe_Color color, const noe_Path *path, int fill_rule)
+{
+    noe_raster_path(image, noe_rect(0, 0, image.w, image.h), color, path, fill_rule);
+}
+
+void noe_image_stroke_path(noe_Image image, noe_Color color, const noe_Path *path, float width)
+{
+    noe_raster_stroke(image, noe_rect(0, 0, image.w, image.h), color, path, width);
+}
+
+//////////////////////////////////////////////////////
+///
+/// Transformed Blits
+///
+/// The inverse transform maps every destination pixel back into the source
+/// rect. Because it is affine, the source coordinate moves by a constant amount
+/// per destination pixel, so each scanline only computes the span that lands
+/// inside the source and then steps (u, v) in 16.16 fixed point. Texels are
+/// sampled a chunk of a scanline at a time and then blended over the target
+/// by their alpha, 4 at once with SSE2. Nearest sampling is a gather SSE2 has
+/// no instruction for, so that part stays scalar for both filters.
+///
+
+#define NOE_FIXED_SHIFT 16
+#define NOE_FIXED_ONE (1 << NOE_FIXED_SHIFT)
+#define NOE_BLIT_CHUNK 64
+
+static inline uint32_t noe_pixel_load(const uint8_t *px, int chans)
+{
+    uint32_t v = 0;
+    memcpy(&v, px, chans);
+    return v;
+}
+
+// Channel-agnostic bilinear filter of four packed pixels, fx and fy are 8 bit fractions
+static inline uint32_t noe_bilerp(uint32_t p00, uint32_t p10, uint32_t p01, uint32_t p11, int fx, int fy)
+{
+#ifdef NOE_HAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i top = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128((int)p00), _mm_cvtsi32_si128((int)p10)), zero);
+    __m128i bot = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128((int)p01), _mm_cvtsi32_si128((int)p11)), zero);
+    __m128i wx = _mm_setr_epi16(256 - fx, 256 - fx, 256 - fx, 256 - fx, fx, fx, fx, fx);
+    top = _mm_mullo_epi16(top, wx);
+    bot = _mm_mullo_epi16(bot, wx);
+    top = _mm_srli_epi16(_mm_add_epi16(top, _mm_srli_si128(top, 8)), 8);
+    bot = _mm_srli_epi16(_mm_add_epi16(bot, _mm_srli_si128(bot, 8)), 8);
+    __m128i r = _mm_add_epi16(_mm_mullo_epi16(top, _mm_set1_epi16((short)(256 - fy))),
+            _mm_mullo_epi16(bot, _mm_set1_epi16((short)fy)));
+    r = _mm_packus_epi16(_mm_srli_epi16(r, 8), zero);
+    return (uint32_t)_mm_cvtsi128_si32(r);
+#else
+    uint32_t result = 0;
+    for(int shift = 0; shift < 32; shift += 8) {
+        uint32_t top = (((p00 >> shift) & 0xFF) * (256 - fx) + ((p10 >> shift) & 0xFF) * fx) >> 8;
+        uint32_t bot = (((p01 >> shift) & 0xFF) * (256 - fx) + ((p11 >> shift) & 0xFF) * fx) >> 8;
+        result |= ((top * (256 - fy) + bot * fy) >> 8) << shift;
+    }
+    return result;
+#endif
+}
+
+// Finds the pixels [*xs, *xe) of a scanline for which `value + slope*(x + 0.5)`
+// stays within [0, limit)
+static void noe_span_limit(float value, float slope, float limit, int *xs, int *xe)
+{
+    if(slope == 0.0f) {
+        if(value < 0.0f || value >= limit) *xe = *xs;
+        return;
+    }
+    float a = -value / slope - 0.5f;
+    float b = (limit - value) / slope - 0.5f;
+    if(slope < 0.0f) NOE_SWAP(float, a, b);
+    // A nearly flat slope puts the limits far outside of any int
+    int lo = (int)ceilf(NOE_CLAMP(a, (float)*xs, (float)*xe));
+    int hi = (int)ceilf(NOE_CLAMP(b, (float)*xs, (float)*xe));
+    *xs = NOE_MAX(*xs, lo);
+    *xe = NOE_MIN(*xe, hi);
+}
+
+static void noe_blit_transformed(noe_Image dst, noe_Rect clip, noe_Image image, noe_Rect src, noe_Mat2x3 xform, int filter)
+{
+    src = noe_clip_rect(noe_rect(0, 0, image.w, image.h), src);
+    if(src.w <= 0 || src.h <= 0) return;
+
+    noe_Mat2x3 inv;
+    if(!noe_mat2x3_invert(xform, &inv)) return;
+    for(int i = 0; i < 6; ++i) {
+        if(!isfinite(xform.es[i]) || !isfinite(inv.es[i])) return;
+    }
+
+    noe_Vec2 corners[4] = {
+        noe_mat2x3_transform(xform, noe_vec2(0, 0)),
+        noe_mat2x3_transform(xform, noe_vec2(src.w, 0)),
+        noe_mat2x3_transform(xform, noe_vec2(src.w, src.h)),
+        noe_mat2x3_transform(xform, noe_vec2(0, src.h)),
+    };
+    float minx = corners[0].x, maxx = corners[0].x, miny = corners[0].y, maxy = corners[0].y;
+    for(int i = 1; i < 4; ++i) {
+        minx = NOE_MIN(minx, corners[i].x);
+        maxx = NOE_MAX(maxx, corners[i].x);
+        miny = NOE_MIN(miny, corners[i].y);
+        maxy = NOE_MAX(maxy, corners[i].y);
+    }
+    noe_Rect bbox = noe_clip_float_bounds(clip, minx, miny, maxx, maxy);
+    if(bbox.w <= 0 || bbox.h <= 0) return;
+
+    const int schans = g_pixelformatinfos[image.format].channels;
+    const int dchans = g_pixelformatinfos[dst.format].channels;
+    const bool same_format = image.format == dst.format;
+    const bool linear = filter == NOE_RESIZE_LINEAR;
+    // The coordinates are kept in 64 bits, with the steps bounded well below
+    // where they could overflow. A step that large leaves the source after
+    // one pixel anyway, so the span around it is a single pixel at most.
+    const float max_step = (float)((int64_t)1 << 40);
+    const int64_t du = (int64_t)NOE_CLAMP(inv.es[0] * NOE_FIXED_ONE, -max_step, max_step);
+    const int64_t dv = (int64_t)NOE_CLAMP(inv.es[3] * NOE_FIXED_ONE, -max_step, max_step);
+    const int64_t umax = (int64_t)(src.w - 1) << NOE_FIXED_SHIFT;
+    const int64_t vmax = (int64_t)(src.h - 1) << NOE_FIXED_SHIFT;
+
+    for(int y = bbox.y; y < bbox.y + bbox.h; ++y) {
+        float yc = y + 0.5f;
+        float urow = inv.es[1]*yc + inv.es[2];
+        float vrow = inv.es[4]*yc + inv.es[5];
+        int xs = bbox.x, xe = bbox.x + bbox.w;
+        noe_span_limit(urow, inv.es[0], (float)src.w, &xs, &xe);
+        noe_span_limit(vrow, inv.es[3], (float)src.h, &xs, &xe);
+        if(xs >= xe) continue;
+
+        // Bilinear samples are centered on the texel, nearest samples pick the covering one
+        float bias = linear ? 0.5f : 0.0f;
+        // Within the span these start inside the source, up to float rounding
+        int64_t u = (int64_t)NOE_CLAMP((urow + inv.es[0]*(xs + 0.5f) - bias) * NOE_FIXED_ONE, -max_step, max_step);
+        int64_t v = (int64_t)NOE_CLAMP((vrow + inv.es[3]*(xs + 0.5f) - bias) * NOE_FIXED_ONE, -max_step, max_step);
+        // Sampled a chunk at a time, then composited over the destination
+        for(int x0 = xs; x0 < xe; x0 += NOE_BLIT_CHUNK) {
+            int n = NOE_MIN(NOE_BLIT_CHUNK, xe - x0);
+            uint32_t texels[NOE_BLIT_CHUNK];
+            for(int i = 0; i < n; ++i, u += du, v += dv) {
+                int64_t cu = NOE_CLAMP(u, 0, umax);
+                int64_t cv = NOE_CLAMP(v, 0, vmax);
+                int sx = (int)(cu >> NOE_FIXED_SHIFT);
+                int sy = (int)(cv >> NOE_FIXED_SHIFT);
+                const uint8_t *p00 = noe_image_pixel_ptr(image, src.x + sx, src.y + sy);
+                if(linear) {
+                    int fx = (int)(cu >> (NOE_FIXED_SHIFT - 8)) & 0xFF;
+                    int fy = (int)(cv >> (NOE_FIXED_SHIFT - 8)) & 0xFF;
+                    int nx = sx + 1 < src.w ? schans : 0;
+                    const uint8_t *p01 = sy + 1 < src.h ? noe_image_pixel_ptr(image, src.x + sx, src.y + sy + 1) : p00;
+                    texels[i] = noe_bilerp(noe_pixel_load(p00, schans), noe_pixel_load(p00 + nx, schans),
+                            noe_pixel_load(p01, schans), noe_pixel_load(p01 + nx, schans), fx, fy);
+                } else {
+                    texels[i] = noe_pixel_load(p00, schans);
+                }
+            }
+
+            uint8_t *out = noe_image_pixel_ptr(dst, x0, y);
+            if(same_format && schans == 4) {
+                noe_blend_pixels(out, (const uint8_t *)texels, n);
+            } else if(same_format) {
+                // Nothing to blend without an alpha channel
+                for(int i = 0; i < n; ++i, out += dchans) memcpy(out, &texels[i], dchans);
+            } else {
+                for(int i = 0; i < n; ++i, out += dchans) {
+                    noe_blend_converted(out, dst.format, (const uint8_t *)&texels[i], image.format);
+                }
+            }
+        }
+    }
+}
+
+void noe_image_draw_image_transformed(noe_Image dst, noe_Image image, noe_Rect src, noe_Mat2x3 transform, int filter)
+{
+    noe_blit_transformed(dst, noe_rect(0, 0, dst.w, dst.h), image, src, transform, filter);
+}
+
+//////////////////////////////////////////////////////
+///
+/// Batch vector math
+///
+/// Four points per iteration, every lane doing what the scalar loop does for
+/// one point in the same order, so the tail and NOE_NO_SIMD builds match it
+/// exactly. That only holds while the compiler isn't allowed to contract the
+/// scalar code into FMAs (-ffp-contract=off when building with FMA enabled).
+///
+
+void noe_vec2_normalize_soa(float *xs, float *ys, int count)
+{
+    int i = 0;
+#ifdef NOE_HAS_SSE2
+    const __m128 half = _mm_set1_ps(0.5f), three_halves = _mm_set1_ps(1.5f);
+    const __m128 min = _mm_set1_ps(FLT_MIN), max = _mm_set1_ps(FLT_MAX);
+    for(; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i), y = _mm_loadu_ps(ys + i);
+        __m128 d = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y));
+        // The Newton step of noe_rsqrt
+        __m128 r = _mm_rsqrt_ps(d);
+        r = _mm_mul_ps(r, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(half, d), r), r)));
+        // Lanes it doesn't cover take the scalar path of noe_rsqrt
+        __m128 normal = _mm_and_ps(_mm_cmpge_ps(d, min), _mm_cmple_ps(d, max));
+        if(_mm_movemask_ps(normal) != 0xF) {
+            float rs[4], ds[4];
+            _mm_storeu_ps(rs, r);
+            _mm_storeu_ps(ds, d);
+            for(int k = 0; k < 4; ++k) rs[k] = noe_rsqrt(ds[k]);
+            r = _mm_loadu_ps(rs);
+        }
+        _mm_storeu_ps(xs + i, _mm_mul_ps(x, r));
+        _mm_storeu_ps(ys + i, _mm_mul_ps(y, r));
+    }
+#endif
+    for(; i < count; ++i) {
+        float r = noe_rsqrt(xs[i]*xs[i] + ys[i]*ys[i]);
+        xs[i] *= r;
+        ys[i] *= r;
+    }
+}
+
+void noe_mat2x3_transform_soa(noe_Mat2x3 m, const float *xs, const float *ys, float *out_xs, float *out_ys, int count)
+{
+    int i = 0;
+#ifdef NOE_HAS_SSE2
+    const __m128 m0 = _mm_set1_ps(m.es[0]), m1 = _mm_set1_ps(m.es[1]), m2 = _mm_set1_ps(m.es[2]);
+    const __m128 m3 = _mm_set1_ps(m.es[3]), m4 = _mm_set1_ps(m.es[4]), m5 = _mm_set1_ps(m.es[5]);
+    for(; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i), y = _mm_loadu_ps(ys + i);
+        _mm_storeu_ps(out_xs + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m1, y)), m2));
+        _mm_storeu_ps(out_ys + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m3, x), _mm_mul_ps(m4, y)), m5));
+    }
+#endif
+    for(; i < count; ++i) {
+        // Both are read first, the outputs may be the inputs
+        float x = xs[i], y = ys[i];
+        out_xs[i] = m.es[0]*x + m.es[1]*y + m.es[2];
+        out_ys[i] = m.es[3]*x + m.es[4]*y + m.es[5];
+    }
+}
+
+void noe_mat4_transform_soa(const noe_Mat4 *m, const float *xs, const float *ys, const float *zs,
+        float *out_xs, float *out_ys, float *out_zs, float *out_ws, int count)
+{
+    const float *e = m->es;
+    int i = 0;
+#ifdef NOE_HAS_SSE2
+    __m128 es[16];
+    for(int k = 0; k < 16; ++k) es[k] = _mm_set1_ps(e[k]);
+    float *outs[4] = { out_xs, out_ys, out_zs, out_ws };
+    int rows = out_ws ? 4 : 3;
+    for(; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i), y = _mm_loadu_ps(ys + i), z = _mm_loadu_ps(zs + i);
+        __m128 r[4];
+        for(int k = 0; k < rows; ++k) {
+            const __m128 *row = es + k*4;
+            r[k] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(row[0], x), _mm_mul_ps(row[1], y)), _mm_mul_ps(row[2], z)), row[3]);
+        }
+        for(int k = 0; k < rows; ++k) _mm_storeu_ps(outs[k] + i, r[k]);
+    }
+#endif
+    for(; i < count; ++i) {
+        float x = xs[i], y = ys[i], z = zs[i];
+        out_xs[i] = e[0]*x + e[1]*y + e[2]*z + e[3];
+        out_ys[i] = e[4]*x + e[5]*y + e[6]*z + e[7];
+        out_zs[i] = e[8]*x + e[9]*y + e[10]*z + e[11];
+        if(out_ws) out_ws[i] = e[12]*x + e[13]*y + e[14]*z + e[15];
+    }
+}
+
+//////////////////////////////////////////////////////
+///
+/// Context Related APIs
+///
+
+#define NOE_SUPPORTED_KEYS 256
+#define NOE_SUPPORTED_BTNS 8
+#define NOE_TARGET_STACK_SIZE 16
+#define NOE_CLIP_STACK_SIZE 32
+#define NOE_EVENT_RING_SIZE 1024 // must be a power of two
+#define NOE_MAX_STEP_HOOKS 8
+#define NOE_MAX_PRESENT_BUFFERS 3
+
+// Events the platform layer queued for the next noe_step. Both run on the
+// main thread, the platform pumps its messages from noe_step itself.
+typedef struct noe_EventRing {
+    noe_Event items[NOE_EVENT_RING_SIZE];
+    unsigned head;
+    unsigned tail;
+    unsigned dropped;
+} noe_EventRing;
+
+typedef struct noe_PlatformContext noe_PlatformContext;
+
+typedef struct {
+    noe_Image image;
+    int capacity_w, capacity_h;
+    bool busy; // queued for or being presented, must not be drawn into
+} noe_PresentBuffer;
+
+typedef struct noe_Context {
+    bool initialized;
+    bool should_close;
+    bool skip_present;
+    uint8_t flags;
+
+    const char *name;
+    const char *title;
+    noe_Image canvas;
+    int canvas_capacity_w; // the canvas rows and pixels can grow up to this without reallocating
+    int canvas_capacity_h;
+    bool resized;
+    noe_Image targets[NOE_TARGET_STACK_SIZE];
+    int targets_clip_base[NOE_TARGET_STACK_SIZE];
+    int targets_clips_dropped[NOE_TARGET_STACK_SIZE];
+    int targets_count;
+    int targets_dropped; // pushes ignored on a full stack, their pops are too
+    noe_Rect clips[NOE_CLIP_STACK_SIZE];
+    int clips_count;
+    int clips_dropped; // same as targets_dropped but for clip rects
+
+    // Current state plus the transitions that happened during the last frame,
+    // all of them are derived from the events of the frame.
+    bool curr_key_states[NOE_SUPPORTED_KEYS];
+    bool curr_btn_states[NOE_SUPPORTED_BTNS];
+    uint8_t key_pressed_bits[NOE_SUPPORTED_KEYS/8];
+    uint8_t key_released_bits[NOE_SUPPORTED_KEYS/8];
+    uint8_t btn_pressed_bits;
+    uint8_t btn_released_bits;
+
+    noe_Vec2 prev_cursor_pos;
+    noe_Vec2 curr_cursor_pos;
+    noe_Vec2 curr_wheel_mov;
+
+    noe_EventRing event_ring;
+    noe_Event frame_events[NOE_EVENT_RING_SIZE];
+    int frame_events_count;
+
+    FILE *record_file;
+    FILE *replay_file;
+    double replay_dt;
+
+    double init_time;
+    double last_frame_time;
+    double target_frame_time; // 0 means unlimited
+    double frame_begin_time;  // when the last noe_step returned
+    noe_PacingStats pacing;
+
+    // Fixed timestep, disabled while fixed_dt is 0
+    double fixed_dt;
+    double fixed_accumulator;
+    double fixed_alpha;
+    int fixed_max_steps;
+    int fixed_steps;
+
+    noe_FrameStats frame_stats;    // the last finished frame
+    noe_FrameStats frame_counters; // the frame being drawn
+    uint64_t canvas_pixels_written;
+    unsigned long long frame_alloc_mark;
+    uint8_t *overdraw_counts; // canvas sized, only while the heatmap is enabled
+    noe_Image overdraw_heatmap;
+
+    // N-buffered presenting while present_buffers_count > 1, canvas is then the
+    // back buffer and present_buffers[back_buffer] is only synced on a swap
+    noe_PresentBuffer present_buffers[NOE_MAX_PRESENT_BUFFERS];
+    int present_buffers_count;
+    int back_buffer;
+    int present_queue[NOE_MAX_PRESENT_BUFFERS];
+    int present_queue_count;
+    int presented_buffer; // the last one the present thread finished, -1 before any
+    noe_Thread *present_thread;
+    noe_Mutex *present_mutex;
+    noe_Cond *present_cond;
+    bool present_quit;
+
+    noe_StepHook step_hooks[NOE_MAX_STEP_HOOKS];
+    void *step_hooks_userdata[NOE_MAX_STEP_HOOKS];
+    int step_hooks_count;
+
+    noe_PlatformContext *platform;
+} noe_Context;
+
+
+/// Platform spesific functions forward declaration
+
+bool noe_platform_init(noe_Context *ctx);
+void noe_platform_close(noe_Context *ctx);
+void noe_platform_poll_inputs(noe_Context *ctx);
+void noe_platform_redraw_surface(noe_Context *ctx);
+void noe_platform_present_image(noe_Context *ctx, noe_Image image); // callable from any thread
+void noe_platform_push_event(noe_Context *ctx, noe_Event event);
+void noe_sleep(int milis);
+void noe_set_window_title(noe_Context *ctx, const char *title);
+double noe_gettime(void);
+
+noe_Context *noe_init(const char *name, int w, int h, uint8_t flags)
+{
+    noe_Context *ctx = noe_alloc(sizeof(*ctx));
+    if(!ctx) return NULL;
+    memset(ctx, 0, sizeof(noe_Context));
+
+    ctx->name = name;
+    ctx->title = name;
+    ctx->should_close = false;
+    ctx->flags = flags;
+
+    ctx->canvas.w = w;
+    ctx->canvas.h = h;
+
+    if(flags & NOE_FLAG_HEADLESS) {
+        ctx->canvas = noe_create_image(w, h, NOE_PIXELFORMAT_B8G8R8A8);
+        if(!ctx->canvas.pixels) {
+            NOE_FREE(ctx);
+            return NULL;
+        }
+        memset(ctx->canvas.pixels, 0, w * h * 4);
+    } else if(!noe_platform_init(ctx)) {
+        NOE_FREE(ctx);
+        return NULL;
+    }
+
+    ctx->target_frame_time = 1.0/60.0;
+    ctx->init_time = noe_gettime();
+    ctx->last_frame_time = ctx->init_time;
+    ctx->frame_begin_time = ctx->init_time;
+    ctx->initialized = true;
+    return ctx;
+}
+
+void noe_close(noe_Context *ctx)
+{
+    if(!ctx) return;
+    noe_record_end(ctx);
+    noe_replay_end(ctx);
+    noe_set_present_buffers(ctx, 1);
+    if(!(ctx->flags & NOE_FLAG_HEADLESS)) noe_platform_close(ctx);
+    noe_unload_image(ctx->canvas);
+    noe_set_overdraw_heatmap(ctx, false);
+    NOE_FREE(ctx);
+}
+
+// Resizes within the capacity only change the visible size. Growing past it
+// reallocates 1.5 times as much as needed, so dragging the window border only
+// reallocates a handful of times. Content is kept where the sizes overlap.
+static void noe_fit_canvas(noe_Context *ctx, int w, int h)
+{
+    noe_Image *canvas = &ctx->canvas;
+    if(w == canvas->w && h == canvas->h) return;
+    const int chans = g_pixelformatinfos[canvas->format].channels;
+    if(canvas->stride == 0) {
+        // Still the packed canvas the platform created
+        canvas->stride = canvas->w * chans;
+        ctx->canvas_capacity_w = canvas->w;
+        ctx->canvas_capacity_h = canvas->h;
+    }
+    if(w <= ctx->canvas_capacity_w && h <= ctx->canvas_capacity_h) {
+        canvas->w = w;
+        canvas->h = h;
+        return;
+    }
+
+    int capacity_w = ctx->canvas_capacity_w, capacity_h = ctx->canvas_capacity_h;
+    if(w > capacity_w) capacity_w = NOE_MAX(w, capacity_w + capacity_w / 2);
+    if(h > capacity_h) capacity_h = NOE_MAX(h, capacity_h + capacity_h / 2);
+    size_t size = (size_t)capacity_w * capacity_h * chans;
+    uint8_t *pixels = noe_alloc(size);
+    if(!pixels) {
+        // Keep drawing into what there is
+        canvas->w = NOE_MIN(w, ctx->canvas_capacity_w);
+        canvas->h = NOE_MIN(h, ctx->canvas_capacity_h);
+        return;
+    }
+    memset(pixels, 0, size);
+    int keep_w = NOE_MIN(w, canvas->w), keep_h = NOE_MIN(h, canvas->h);
+    for(int y = 0; y < keep_h; ++y) {
+        memcpy(pixels + (size_t)y * capacity_w * chans, canvas->pixels + (size_t)y * canvas->stride, (size_t)keep_w * chans);
+    }
+    NOE_FREE(canvas->pixels);
+    canvas->pixels = pixels;
+    canvas->stride = capacity_w * chans;
+    canvas->w = w;
+    canvas->h = h;
+    ctx->canvas_capacity_w = capacity_w;
+    ctx->canvas_capacity_h = capacity_h;
+}
+
+void noe_set_should_close(noe_Context *ctx, bool should_close)
+{
+    ctx->should_close = should_close;
+}
+
+void noe_skip_present(noe_Context *ctx)
+{
+    ctx->skip_present = true;
+}
+
+void noe_platform_push_event(noe_Context *ctx, noe_Event event)
+{
+    noe_EventRing *ring = &ctx->event_ring;
+    if(ring->head - ring->tail >= NOE_EVENT_RING_SIZE) {
+        ring->dropped += 1;
+        return;
+    }
+    ring->items[ring->head++ & (NOE_EVENT_RING_SIZE - 1)] = event;
+}
+
+#define NOE_BIT_SET(bits, i) ((bits)[(i) >> 3] |= (uint8_t)(1 << ((i) & 7)))
+#define NOE_BIT_GET(bits, i) (((bits)[(i) >> 3] >> ((i) & 7)) & 1)
+
+static void noe_apply_event(noe_Context *ctx, const noe_Event *ev)
+{
+    switch(ev->type) {
+        case NOE_EVENT_KEY_DOWN:
+            if(!ctx->curr_key_states[ev->code]) NOE_BIT_SET(ctx->key_pressed_bits, ev->code);
+            ctx->curr_key_states[ev->code] = true;
+            break;
+        case NOE_EVENT_KEY_UP:
+            if(ctx->curr_key_states[ev->code]) NOE_BIT_SET(ctx->key_released_bits, ev->code);
+            ctx->curr_key_states[ev->code] = false;
+            break;
+        case NOE_EVENT_BUTTON_DOWN:
+            if(!ctx->curr_btn_states[ev->code]) ctx->btn_pressed_bits |= (uint8_t)(1 << ev->code);
+            ctx->curr_btn_states[ev->code] = true;
+            break;
+        case NOE_EVENT_BUTTON_UP:
+            if(ctx->curr_btn_states[ev->code]) ctx->btn_released_bits |= (uint8_t)(1 << ev->code);
+            ctx->curr_btn_states[ev->code] = false;
+            break;
+        case NOE_EVENT_MOTION:
+            ctx->curr_cursor_pos = noe_vec2(ev->x, ev->y);
+            break;
+        case NOE_EVENT_WHEEL:
+            ctx->curr_wheel_mov.x += ev->x;
+            ctx->curr_wheel_mov.y += ev->y;
+            break;
+    }
+}
+
+//////////////////////////////////////////////////////
+///
+/// Input Recording
+///
+/// A recording is a small header followed by one record per frame: the delta
+/// time noe_step reported and the events of that frame. Values are stored
+/// little endian so recordings can be shared between machines. Text events
+/// have no modifiers, their mods byte holds bits 16-23 of the codepoint.
+///
+
+#define NOE_RECORDING_MAGIC 0x52454F4E // "NOER"
+#define NOE_RECORDING_VERSION 1
+
+static void noe_write_u32(FILE *f, uint32_t v)
+{
+    uint8_t b[4] = { v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF, (v >> 24) & 0xFF };
+    fwrite(b, 1, 4, f);
+}
+
+static bool noe_read_u32(FILE *f, uint32_t *v)
+{
+    uint8_t b[4];
+    if(fread(b, 1, 4, f) != 4) return false;
+    *v = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+    return true;
+}
+
+static void noe_write_f32(FILE *f, float v)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, 4);
+    noe_write_u32(f, bits);
+}
+
+static bool noe_read_f32(FILE *f, float *v)
+{
+    uint32_t bits;
+    if(!noe_read_u32(f, &bits)) return false;
+    memcpy(v, &bits, 4);
+    return true;
+}
+
+static void noe_write_f64(FILE *f, double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, 8);
+    noe_write_u32(f, (uint32_t)bits);
+    noe_write_u32(f, (uint32_t)(bits >> 32));
+}
+
+static bool noe_read_f64(FILE *f, double *v)
+{
+    uint32_t lo, hi;
+    if(!noe_read_u32(f, &lo) || !noe_read_u32(f, &hi)) return false;
+    uint64_t bits = ((uint64_t)hi << 32) | lo;
+    memcpy(v, &bits, 8);
+    return true;
+}
+
+bool noe_record_begin(noe_Context *ctx, const char *filepath)
+{
+    noe_record_end(ctx);
+    ctx->record_file = fopen(filepath, "wb");
+    if(!ctx->record_file) return false;
+    noe_write_u32(ctx->record_file, NOE_RECORDING_MAGIC);
+    noe_write_u32(ctx->record_file, NOE_RECORDING_VERSION);
+    return true;
+}
+
+void noe_record_end(noe_Context *ctx)
+{
+    if(!ctx->record_file) return;
+    fclose(ctx->record_file);
+    ctx->record_file = NULL;
+}
+
+bool noe_replay_begin(noe_Context *ctx, const char *filepath)
+{
+    noe_replay_end(ctx);
+    FILE *f = fopen(filepath, "rb");
+    if(!f) return false;
+    uint32_t magic, version;
+    if(!noe_read_u32(f, &magic) || !noe_read_u32(f, &version)
+            || magic != NOE_RECORDING_MAGIC || version != NOE_RECORDING_VERSION) {
+        fclose(f);
+        return false;
+    }
+    ctx->replay_file = f;
+    return true;
+}
+
+void noe_replay_end(noe_Context *ctx)
+{
+    if(!ctx->replay_file) return;
+    fclose(ctx->replay_file);
+    ctx->replay_file = NULL;
+}
+
+bool noe_is_replaying(noe_Context *ctx)
+{
+    return ctx->replay_file != NULL;
+}
+
+static void noe_record_frame(noe_Context *ctx, double dt)
+{
+    FILE *f = ctx->record_file;
+    noe_write_f64(f, dt);
+    noe_write_u32(f, (uint32_t)ctx->frame_events_count);
+    for(int i = 0; i < ctx->frame_events_count; ++i) {
+        const noe_Event *ev = &ctx->frame_events[i];
+        int mods = ev->type == NOE_EVENT_TEXT ? ev->code >> 16 : ev->mods;
+        uint8_t head[4] = { (uint8_t)ev->type, (uint8_t)mods, ev->code & 0xFF, (ev->code >> 8) & 0xFF };
+        fwrite(head, 1, 4, f);
+        noe_write_f32(f, ev->x);
+        noe_write_f32(f, ev->y);
+        noe_write_f32(f, (float)(ev->time - ctx->init_time));
+    }
+}
+
+static bool noe_recorded_event_valid(const noe_Event *ev)
+{
+    switch(ev->type) {
+        case NOE_EVENT_KEY_DOWN:
+        case NOE_EVENT_KEY_UP:
+            return ev->code < NOE_SUPPORTED_KEYS;
+        case NOE_EVENT_BUTTON_DOWN:
+        case NOE_EVENT_BUTTON_UP:
+            return ev->code < NOE_SUPPORTED_BTNS;
+        case NOE_EVENT_MOTION:
+        case NOE_EVENT_WHEEL:
+            return true;
+        case NOE_EVENT_TEXT:
+            return ev->code > 0 && ev->code <= 0x10FFFF;
+    }
+    return false;
+}
+
+static bool noe_replay_frame(noe_Context *ctx)
+{
+    FILE *f = ctx->replay_file;
+    uint32_t count;
+    if(!noe_read_f64(f, &ctx->replay_dt) || !noe_read_u32(f, &count) || count > NOE_EVENT_RING_SIZE) {
+        return false;
+    }
+    int kept = 0;
+    for(uint32_t i = 0; i < count; ++i) {
+        noe_Event *ev = &ctx->frame_events[kept];
+        uint8_t head[4];
+        float time;
+        if(fread(head, 1, 4, f) != 4 || !noe_read_f32(f, &ev->x)
+                || !noe_read_f32(f, &ev->y) || !noe_read_f32(f, &time)) {
+            return false;
+        }
+        ev->type = head[0];
+        ev->mods = head[1];
+        ev->code = head[2] | (head[3] << 8);
+        if(ev->type == NOE_EVENT_TEXT) {
+            ev->code |= ev->mods << 16;
+            ev->mods = 0;
+        }
+        ev->time = ctx->init_time + time;
+        // A damaged recording must not index past the key and button states
+        if(noe_recorded_event_valid(ev)) kept += 1;
+    }
+    ctx->frame_events_count = kept;
+    return true;
+}
+
+// Moves everything the platform queued since the last frame into the frame's
+// event list and derives the pressed/released transitions from it. While a
+// replay is running the live events are discarded and the recorded ones used.
+static void noe_process_events(noe_Context *ctx)
+{
+    noe_EventRing *ring = &ctx->event_ring;
+    memset(ctx->key_pressed_bits, 0, sizeof(ctx->key_pressed_bits));
+    memset(ctx->key_released_bits, 0, sizeof(ctx->key_released_bits));
+    ctx->btn_pressed_bits = 0;
+    ctx->btn_released_bits = 0;
+    ctx->prev_cursor_pos = ctx->curr_cursor_pos;
+    ctx->curr_wheel_mov = noe_vec2(0, 0);
+
+    ctx->frame_events_count = 0;
+    if(ctx->replay_file) {
+        ring->tail = ring->head;
+        if(!noe_replay_frame(ctx)) {
+            // The recording is over, so is the session
+            noe_replay_end(ctx);
+            ctx->frame_events_count = 0;
+            ctx->should_close = true;
+        }
+    } else {
+        for(; ring->tail != ring->head; ++ring->tail) {
+            ctx->frame_events[ctx->frame_events_count++] = ring->items[ring->tail & (NOE_EVENT_RING_SIZE - 1)];
+        }
+    }
+
+    for(int i = 0; i < ctx->frame_events_count; ++i) {
+        noe_apply_event(ctx, &ctx->frame_events[i]);
+    }
+}
+
+const noe_Event *noe_get_events(noe_Context *ctx, int *count)
+{
+    if(count) *count = ctx->frame_events_count;
+    return ctx->frame_events;
+}
+
+unsigned noe_dropped_events(noe_Context *ctx)
+{
+    return ctx->event_ring.dropped;
+}
+
+//////////////////////////////////////////////////////
+///
+/// Profiler
+///
+/// Each thread owns a ring of finished zones and a stack of open ones, so
+/// recording never takes a lock. A thread registers its ring in a global table
+/// the first time it records, which is what the exporter walks.
+///
+
+#ifdef NOE_PROFILE
+
+#ifndef NOE_PROFILE_RING_SIZE
+#define NOE_PROFILE_RING_SIZE 16384 // zones kept per thread, must be a power of two
+#endif
+#define NOE_PROFILE_MAX_DEPTH 32
+#define NOE_PROFILE_MAX_THREADS 64
+
+typedef struct {
+    const char *name;
+    double begin, end;
+} noe_ProfileZone;
+
+typedef struct {
+    noe_ProfileZone zones[NOE_PROFILE_RING_SIZE];
+    atomic_uint written;
+    const char *open_names[NOE_PROFILE_MAX_DEPTH];
+    double open_begins[NOE_PROFILE_MAX_DEPTH];
+    int depth;
+    int id;
+} noe_ProfileThread;
+
+static noe_ProfileThread *g_profile_threads[NOE_PROFILE_MAX_THREADS];
+static atomic_int g_profile_threads_count;
+static NOE_THREAD_LOCAL noe_ProfileThread *g_profile_thread;
+static NOE_THREAD_LOCAL bool g_profile_thread_failed;
+
+static noe_ProfileThread *noe_profile_thread(void)
+{
+    if(g_profile_thread || g_profile_thread_failed) return g_profile_thread;
+    int id = atomic_fetch_add(&g_profile_threads_count, 1);
+    noe_ProfileThread *thread = NULL;
+    if(id < NOE_PROFILE_MAX_THREADS) thread = NOE_MALLOC(sizeof(*thread));
+    if(!thread) {
+        g_profile_thread_failed = true;
+        return NULL;
+    }
+    memset(thread, 0, sizeof(*thread));
+    thread->id = id;
+    g_profile_threads[id] = thread;
+    g_profile_thread = thread;
+    return thread;
+}
+
+static void noe_profile_record(noe_ProfileThread *thread, const char *name, double begin, double end)
+{
+    unsigned index = atomic_load_explicit(&thread->written, memory_order_relaxed);
+    noe_ProfileZone *zone = &thread->zones[index & (NOE_PROFILE_RING_SIZE - 1)];
+    zone->name = name;
+    zone->begin = begin;
+    zone->end = end;
+    atomic_store_explicit(&thread->written, index + 1, memory_order_release);
+}
+
+void noe_profile_begin(const char *name)
+{
+    noe_ProfileThread *thread = noe_profile_thread();
+    if(!thread) return;
+    if(thread->depth < NOE_PROFILE_MAX_DEPTH) {
+        thread->open_names[thread->depth] = name;
+        thread->open_begins[thread->depth] = noe_gettime();
+    }
+    thread->depth += 1;
+}
+
+void noe_profile_end(void)
+{
+    noe_ProfileThread *thread = g_profile_thread;
+    if(!thread || thread->depth == 0) return;
+    thread->depth -= 1;
+    if(thread->depth >= NOE_PROFILE_MAX_DEPTH) return;
+    noe_profile_record(thread, thread->open_names[thread->depth],
+            thread->open_begins[thread->depth], noe_gettime());
+}
+
+static void noe_profile_write_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for(; *s; ++s) {
+        if(*s == '"' || *s == '\\') fputc('\\', f);
+        if((unsigned char)*s >= 0x20) fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+bool noe_profile_export_chrome_trace(const char *filepath)
+{
+    FILE *f = fopen(filepath, "wb");
+    if(!f) return false;
+
+    int threads_count = NOE_MIN(atomic_load(&g_profile_threads_count), NOE_PROFILE_MAX_THREADS);
+    double epoch = -1.0;
+    for(int t = 0; t < threads_count; ++t) {
+        noe_ProfileThread *thread = g_profile_threads[t];
+        if(!thread) continue;
+        unsigned written = atomic_load_explicit(&thread->written, memory_order_acquire);
+        unsigned first = written > NOE_PROFILE_RING_SIZE ? written - NOE_PROFILE_RING_SIZE : 0;
+        for(unsigned i = first; i < written; ++i) {
+            double begin = thread->zones[i & (NOE_PROFILE_RING_SIZE - 1)].begin;
+            if(epoch < 0 || begin < epoch) epoch = begin;
+        }
+    }
+
+    fprintf(f, "{\"traceEvents\":[");
+    bool first_event = true;
+    for(int t = 0; t < threads_count; ++t) {
+        noe_ProfileThread *thread = g_profile_threads[t];
+        if(!thread) continue;
+        unsigned written = atomic_load_explicit(&thread->written, memory_order_acquire);
+        unsigned first = written > NOE_PROFILE_RING_SIZE ? written - NOE_PROFILE_RING_SIZE : 0;
+        for(unsigned i = first; i < written; ++i) {
+            noe_ProfileZone *zone = &thread->zones[i & (NOE_PROFILE_RING_SIZE - 1)];
+            fprintf(f, "%s\n{\"name\":", first_event ? "" : ",");
+            noe_profile_write_string(f, zone->name);
+            fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    thread->id, (zone->begin - epoch)*1e6, (zone->end - zone->begin)*1e6);
+            first_event = false;
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    bool ok = !ferror(f);
+    if(fclose(f) != 0) ok = false;
+    return ok;
+}
+
+// Records a zone whose boundaries were measured before it could be opened
+#define NOE_PROFILE_ZONE(name, begin, end) \
+    do { \
+        noe_ProfileThread *thread_ = noe_profile_thread(); \
+        if(thread_) noe_profile_record(thread_, (name), (begin), (end)); \
+    } while(0)
+
+#else
+#define NOE_PROFILE_ZONE(name, begin, end) ((void)0)
+#endif // NOE_PROFILE
+
+//////////////////////////////////////////////////////
+///
+/// Frame Pacing
+///
+/// The OS sleep is only precise to its scheduler granularity (up to ~15ms on
+/// Windows without a raised timer resolution). noe_sleep_precise sleeps in 1ms
+/// steps while the remaining time is larger than what such a sleep has been
+/// observed to take, then spins on the high resolution clock for the rest.
+/// Every thread keeps its own model, and old samples decay so it follows the
+/// scheduler when its behaviour changes.
+///
+
+#define NOE_SLEEP_MODEL_WEIGHT (1.0/16) // of every new sample
+#define NOE_SLEEP_MODEL_DEVIATIONS 3.0  // margin, a longer sleep overshoots the deadline
+
+typedef struct {
+    double estimate;  // expected duration of noe_sleep(1) plus the margin
+    double mean;
+    double variance;
+} noe_SleepModel;
+
+static NOE_THREAD_LOCAL noe_SleepModel g_sleep_model = { 8e-3, 5e-3, 1e-6 };
+
+void noe_sleep_precise(double seconds)
+{
+    double now = noe_gettime();
+    const double deadline = now + seconds;
+
+    while(deadline - now > g_sleep_model.estimate) {
+        noe_sleep(1);
+        double after = noe_gettime();
+        double observed = after - now;
+        now = after;
+
+        // Exponentially weighted mean/variance of how long a 1ms sleep really takes
+        noe_SleepModel *model = &g_sleep_model;
+        const double w = NOE_SLEEP_MODEL_WEIGHT;
+        double delta = observed - model->mean;
+        model->mean += w * delta;
+        model->variance = (1.0 - w) * (model->variance + w * delta * delta);
+        model->estimate = model->mean + NOE_SLEEP_MODEL_DEVIATIONS * sqrt(model->variance);
+    }
+
+    while(now < deadline) now = noe_gettime();
+}
+
+void noe_set_target_fps(noe_Context *ctx, double fps)
+{
+    ctx->target_frame_time = fps > 0 ? 1.0/fps : 0.0;
+}
+
+double noe_get_target_fps(noe_Context *ctx)
+{
+    return ctx->target_frame_time > 0 ? 1.0/ctx->target_frame_time : 0.0;
+}
+
+noe_PacingStats noe_get_pacing_stats(noe_Context *ctx)
+{
+    return ctx->pacing;
+}
+
+// Waits for the next frame deadline and returns the delta time of the frame
+static double noe_pace_frame(noe_Context *ctx, double step_begin, double present_end)
+{
+    noe_PacingStats *stats = &ctx->pacing;
+    double prev = ctx->last_frame_time;
+    double now = present_end;
+
+    stats->work_time = step_begin - ctx->frame_begin_time;
+    stats->present_time = present_end - step_begin;
+    stats->sleep_time = 0.0;
+    stats->lateness = 0.0;
+
+    if(ctx->target_frame_time > 0) {
+        double deadline = prev + ctx->target_frame_time;
+        if(deadline > now) {
+            noe_sleep_precise(deadline - now);
+            double woke = noe_gettime();
+            stats->sleep_time = woke - now;
+            stats->lateness = woke - deadline;
+            ctx->last_frame_time = deadline;
+        } else {
+            stats->lateness = now - deadline;
+            stats->missed_frames += 1;
+            ctx->last_frame_time = now;
+        }
+    } else {
+        ctx->last_frame_time = now;
+    }
+
+    double dt = ctx->last_frame_time - prev;
+    stats->frame_time = dt;
+    stats->frames += 1;
+    stats->max_lateness = NOE_MAX(stats->max_lateness, stats->lateness);
+    // Exponential moving average over roughly the last 64 frames
+    if(stats->frames == 1) stats->avg_frame_time = dt;
+    else stats->avg_frame_time += (dt - stats->avg_frame_time) / 64.0;
+    return dt;
+}
+
+//////////////////////////////////////////////////////
+///
+/// Frame Statistics
+///
+/// Draw calls only account for their clipped bounds, which costs a handful of
+/// integer operations per call instead of counting inside the raster loops.
+///
+
+static void noe_count_draw(noe_Context *ctx, int kind)
+{
+    ctx->frame_counters.draw_calls[kind] += 1;
+    ctx->frame_counters.draw_calls_total += 1;
+}
+
+// reads is how many pixels are fetched per written pixel
+static void noe_count_pixels(noe_Context *ctx, noe_Rect bounds, int reads)
+{
+    noe_Rect r = noe_clip_rect(noe_get_clip_rect(ctx), bounds);
+    if(r.w <= 0 || r.h <= 0) return;
+    uint64_t area = (uint64_t)r.w * r.h;
+    ctx->frame_counters.pixels_written += area;
+    ctx->frame_counters.pixels_read += area * reads;
+    if(ctx->targets_count > 0) return;
+
+    ctx->canvas_pixels_written += area;
+    if(!ctx->overdraw_counts) return;
+    for(int y = r.y; y < r.y + r.h; ++y) {
+        uint8_t *count = &ctx->overdraw_counts[y * ctx->canvas.w + r.x];
+        for(int x = 0; x < r.w; ++x) if(count[x] < 255) count[x] += 1;
+    }
+}
+
+static noe_Rect noe_bounds_of_points(noe_Context *ctx, const noe_Vec2 *points, int count, float pad)
+{
+    if(count <= 0) return noe_rect(0, 0, 0, 0);
+    float l = points[0].x, t = points[0].y, r = l, b = t;
+    for(int i = 1; i < count; ++i) {
+        l = NOE_MIN(l, points[i].x);
+        t = NOE_MIN(t, points[i].y);
+        r = NOE_MAX(r, points[i].x);
+        b = NOE_MAX(b, points[i].y);
+    }
+    return noe_clip_float_bounds(noe_get_clip_rect(ctx), l - pad, t - pad, r + pad, b + pad);
+}
+
+static void noe_render_overdraw_heatmap(noe_Context *ctx)
+{
+    // black, blue, cyan, green, yellow, orange, red for 0..8+ writes
+    static const uint8_t ramp[9][3] = {
+        {0, 0, 0}, {0, 0, 160}, {0, 0, 255}, {0, 160, 255}, {0, 255, 128},
+        {128, 255, 0}, {255, 255, 0}, {255, 128, 0}, {255, 0, 0},
+    };
+    noe_Image *heatmap = &ctx->overdraw_heatmap;
+    int n = ctx->canvas.w * ctx->canvas.h;
+    if(heatmap->w * heatmap->h == n) {
+        for(int i = 0; i < n; ++i) {
+            const uint8_t *c = ramp[NOE_MIN(ctx->overdraw_counts[i], 8)];
+            heatmap->pixels[i*4 + 0] = c[0];
+            heatmap->pixels[i*4 + 1] = c[1];
+            heatmap->pixels[i*4 + 2] = c[2];
+            heatmap->pixels[i*4 + 3] = 0xFF;
+        }
+    }
+
+    // The canvas may have been resized by the platform during the frame
+    if(heatmap->w != ctx->canvas.w || heatmap->h != ctx->canvas.h) {
+        noe_set_overdraw_heatmap(ctx, false);
+        noe_set_overdraw_heatmap(ctx, true);
+    } else {
+        memset(ctx->overdraw_counts, 0, n);
+    }
+}
+
+static void noe_finish_frame_stats(noe_Context *ctx, double present_time, double sleep_time, double poll_time)
+{
+    noe_FrameStats *stats = &ctx->frame_counters;
+    unsigned long long allocated = atomic_load_explicit(&g_bytes_allocated, memory_order_relaxed);
+    stats->bytes_allocated = allocated - ctx->frame_alloc_mark;
+    stats->present_time = present_time;
+    stats->sleep_time = sleep_time;
+    stats->poll_time = poll_time;
+    int canvas_area = ctx->canvas.w * ctx->canvas.h;
+    stats->overdraw = canvas_area > 0 ? (float)ctx->canvas_pixels_written / canvas_area : 0.0f;
+    if(ctx->overdraw_counts) noe_render_overdraw_heatmap(ctx);
+
+    ctx->frame_stats = *stats;
+    memset(stats, 0, sizeof(*stats));
+    ctx->canvas_pixels_written = 0;
+    ctx->frame_alloc_mark = atomic_load_explicit(&g_bytes_allocated, memory_order_relaxed);
+}
+
+noe_FrameStats noe_get_frame_stats(noe_Context *ctx)
+{
+    return ctx->frame_stats;
+}
+
+void noe_set_overdraw_heatmap(noe_Context *ctx, bool enabled)
+{
+    if(!enabled) {
+        NOE_FREE(ctx->overdraw_counts);
+        noe_unload_image(ctx->overdraw_heatmap);
+        ctx->overdraw_counts = NULL;
+        ctx->overdraw_heatmap = (noe_Image){0};
+        return;
+    }
+    if(ctx->overdraw_counts) return;
+    int n = ctx->canvas.w * ctx->canvas.h;
+    ctx->overdraw_counts = noe_alloc(n);
+    ctx->overdraw_heatmap = noe_create_image(ctx->canvas.w, ctx->canvas.h, NOE_PIXELFORMAT_R8G8B8A8);
+    if(!ctx->overdraw_counts || !ctx->overdraw_heatmap.pixels) {
+        noe_set_overdraw_heatmap(ctx, false);
+        return;
+    }
+    memset(ctx->overdraw_counts, 0, n);
+    memset(ctx->overdraw_heatmap.pixels, 0, n * 4);
+}
+
+noe_Image noe_get_overdraw_heatmap(noe_Context *ctx)
+{
+    return ctx->overdraw_heatmap;
+}
+
+void noe_set_fixed_timestep(noe_Context *ctx, double dt, int max_steps)
+{
+    ctx->fixed_dt = dt > 0 ? dt : 0.0;
+    ctx->fixed_max_steps = max_steps > 0 ? max_steps : 1;
+    ctx->fixed_accumulator = 0.0;
+    ctx->fixed_steps = 0;
+    ctx->fixed_alpha = 0.0;
+}
+
+int noe_fixed_steps(noe_Context *ctx)
+{
+    return ctx->fixed_steps;
+}
+
+double noe_fixed_alpha(noe_Context *ctx)
+{
+    return ctx->fixed_alpha;
+}
+
+static void noe_accumulate_fixed_steps(noe_Context *ctx, double frame_dt)
+{
+    ctx->fixed_accumulator += frame_dt;
+    int steps = (int)(ctx->fixed_accumulator / ctx->fixed_dt);
+    if(steps > ctx->fixed_max_steps) {
+        // Drop the time we can't catch up on instead of spiralling into longer frames
+        steps = ctx->fixed_max_steps;
+        ctx->fixed_accumulator = fmod(ctx->fixed_accumulator, ctx->fixed_dt);
+    } else {
+        ctx->fixed_accumulator -= steps * ctx->fixed_dt;
+    }
+    ctx->fixed_steps = steps;
+    ctx->fixed_alpha = ctx->fixed_accumulator / ctx->fixed_dt;
+}
+
+//////////////////////////////////////////////////////
+///
+/// Present thread
+///
+/// With N buffers noe_step queues the finished canvas for the present thread
+/// and continues with the next buffer that isn't queued or being presented,
+/// waiting for one only when all of them are. Rendering the next frame thus
+/// overlaps pushing the last one to the window.
+///
+
+static int noe_present_thread(void *arg)
+{
+    noe_Context *ctx = arg;
+    noe_mutex_lock(ctx->present_mutex);
+    for(;;) {
+        while(!ctx->present_quit && ctx->present_queue_count == 0) noe_cond_wait(ctx->present_cond, ctx->present_mutex);
+        // Frames queued before quitting are still presented
+        if(ctx->present_queue_count == 0) break;
+        int index = ctx->present_queue[0];
+        noe_Image image = ctx->present_buffers[index].image;
+        noe_mutex_unlock(ctx->present_mutex);
+
+        NOE_PROFILE_BEGIN("present");
+        noe_platform_present_image(ctx, image);
+        NOE_PROFILE_END();
+
+        noe_mutex_lock(ctx->present_mutex);
+        ctx->present_queue_count -= 1;
+        memmove(ctx->present_queue, ctx->present_queue + 1, sizeof(int) * ctx->present_queue_count);
+        ctx->present_buffers[index].busy = false;
+        ctx->presented_buffer = index;
+        noe_cond_broadcast(ctx->present_cond);
+    }
+    noe_mutex_unlock(ctx->present_mutex);
+    return 0;
+}
+
+// Queues the canvas and makes the next free buffer the canvas
+static void noe_present_buffered(noe_Context *ctx)
+{
+    noe_PresentBuffer *back = &ctx->present_buffers[ctx->back_buffer];
+    back->image = ctx->canvas;
+    back->capacity_w = ctx->canvas_capacity_w;
+    back->capacity_h = ctx->canvas_capacity_h;
+
+    noe_mutex_lock(ctx->present_mutex);
+    back->busy = true;
+    ctx->present_queue[ctx->present_queue_count++] = ctx->back_buffer;
+    noe_cond_broadcast(ctx->present_cond);
+    int next = -1;
+    for(;;) {
+        for(int i = 1; i <= ctx->present_buffers_count && next < 0; ++i) {
+            int index = (ctx->back_buffer + i) % ctx->present_buffers_count;
+            if(!ctx->present_buffers[index].busy) next = index;
+        }
+        if(next >= 0) break;
+        // The fence, every buffer is still waiting to be presented
+        noe_cond_wait(ctx->present_cond, ctx->present_mutex);
+    }
+    noe_mutex_unlock(ctx->present_mutex);
+
+    int w = ctx->canvas.w, h = ctx->canvas.h;
+    ctx->back_buffer = next;
+    ctx->canvas = ctx->present_buffers[next].image;
+    ctx->canvas_capacity_w = ctx->present_buffers[next].capacity_w;
+    ctx->canvas_capacity_h = ctx->present_buffers[next].capacity_h;
+    // The window may have been resized since this buffer was drawn
+    noe_fit_canvas(ctx, w, h);
+}
+
+bool noe_set_present_buffers(noe_Context *ctx, int count)
+{
+    count = NOE_CLAMP(count, 1, NOE_MAX_PRESENT_BUFFERS);
+    if(count == NOE_MAX(ctx->present_buffers_count, 1)) return true;
+
+    if(ctx->present_thread) {
+        noe_mutex_lock(ctx->present_mutex);
+        ctx->present_quit = true;
+        noe_cond_broadcast(ctx->present_cond);
+        noe_mutex_unlock(ctx->present_mutex);
+        noe_thread_join(ctx->present_thread);
+        ctx->present_thread = NULL;
+        ctx->present_quit = false;
+    }
+    // Keep drawing into the current back buffer
+    for(int i = 0; i < ctx->present_buffers_count; ++i) {
+        if(i != ctx->back_buffer) noe_unload_image(ctx->present_buffers[i].image);
+    }
+    if(ctx->present_cond) noe_cond_destroy(ctx->present_cond);
+    if(ctx->present_mutex) noe_mutex_destroy(ctx->present_mutex);
+    ctx->present_cond = NULL;
+    ctx->present_mutex = NULL;
+    ctx->present_buffers_count = 0;
+    ctx->present_queue_count = 0;
+    ctx->presented_buffer = -1;
+    ctx->back_buffer = 0;
+    memset(ctx->present_buffers, 0, sizeof(ctx->present_buffers));
+    // Nothing is presented without a window
+    if(count == 1 || (ctx->flags & NOE_FLAG_HEADLESS)) return count == 1;
+
+    ctx->present_buffers[0].image = ctx->canvas;
+    ctx->present_buffers[0].capacity_w = ctx->canvas_capacity_w;
+    ctx->present_buffers[0].capacity_h = ctx->canvas_capacity_h;
+    bool ok = true;
+    for(int i = 1; i < count && ok; ++i) {
+        noe_Image image = noe_create_image(ctx->canvas.w, ctx->canvas.h, ctx->canvas.format);
+        ok = image.pixels != NULL;
+        if(ok) memset(image.pixels, 0, (size_t)image.w * image.h * g_pixelformatinfos[image.format].channels);
+        ctx->present_buffers[i].image = image;
+        ctx->present_buffers[i].capacity_w = image.w;
+        ctx->present_buffers[i].capacity_h = image.h;
+        ctx->present_buffers_count = i + 1;
+    }
+    if(ok) {
+        ctx->present_mutex = noe_mutex_create();
+        ctx->present_cond = noe_cond_create();
+        ok = ctx->present_mutex && ctx->present_cond;
+    }
+    if(ok) {
+        ctx->present_thread = noe_thread_create(noe_present_thread, ctx);
+        ok = ctx->present_thread != NULL;
+    }
+    if(!ok) {
+        noe_set_present_buffers(ctx, 1);
+        return false;
+    }
+    return true;
+}
+
+int noe_get_present_buffers(noe_Context *ctx)
+{
+    return NOE_MAX(ctx->present_buffers_count, 1);
+}
+
+bool noe_step(noe_Context *ctx, double *dt)
+{
+    const bool headless = ctx->flags & NOE_FLAG_HEADLESS;
+
+    // Hooks see the finished frame and count as the application's work
+    NOE_PROFILE_BEGIN("step_hooks");
+    for(int i = 0; i < ctx->step_hooks_count; ++i) {
+        noe_StepHook hook = ctx->step_hooks[i];
+        void *userdata = ctx->step_hooks_userdata[i];
+        hook(ctx, ctx->canvas, userdata);
+        // The hook removed itself, the next one moved into its slot
+        if(i >= ctx->step_hooks_count || ctx->step_hooks[i] != hook || ctx->step_hooks_userdata[i] != userdata) i -= 1;
+    }
+    NOE_PROFILE_END();
+    double step_begin = noe_gettime();
+
+    // Everything between two noe_step calls is the application's frame
+    NOE_PROFILE_ZONE("update", ctx->frame_begin_time, step_begin);
+
+    /// Draw to window
+    NOE_PROFILE_BEGIN("present");
+    if(!ctx->skip_present && !headless) {
+        if(ctx->present_buffers_count > 1) noe_present_buffered(ctx);
+        else noe_platform_redraw_surface(ctx);
+    }
+    ctx->skip_present = false;
+    NOE_PROFILE_END();
+    double present_end = noe_gettime();
+
+    // Handle delta time, replays run as fast as possible with the recorded timing
+    double frame_dt = 0.0;
+    if(!ctx->replay_file) {
+        NOE_PROFILE_BEGIN("sleep");
+        frame_dt = noe_pace_frame(ctx, step_begin, present_end);
+        NOE_PROFILE_END();
+    }
+    double sleep_end = noe_gettime();
+
+    NOE_PROFILE_BEGIN("poll_inputs");
+    ctx->resized = false;
+    if(!headless) noe_platform_poll_inputs(ctx);
+    NOE_PROFILE_END();
+    noe_finish_frame_stats(ctx, present_end - step_begin, sleep_end - present_end, noe_gettime() - sleep_end);
+
+    NOE_PROFILE_BEGIN("process_events");
+    noe_process_events(ctx);
+    if(ctx->replay_file) frame_dt = ctx->replay_dt;
+    if(ctx->record_file) noe_record_frame(ctx, frame_dt);
+    if(ctx->fixed_dt > 0) noe_accumulate_fixed_steps(ctx, frame_dt);
+    NOE_PROFILE_END();
+
+    if(dt) *dt = frame_dt;
+    ctx->frame_begin_time = noe_gettime();
+    return !ctx->should_close;
+}
 
-    // Save previous input states
-    ctx->prev_cursor_pos = ctx->curr_cursor_pos;
-    memset(ctx->prev_key_states, 0, sizeof(ctx->prev_key_states));
-    memset(ctx->prev_btn_states, 0, sizeof(ctx->prev_btn_states));
-    memset(ctx->curr_key_states, 0, sizeof(ctx->curr_key_states));
-    memset(ctx->curr_btn_states, 0, sizeof(ctx->curr_btn_states));
-    ctx->canvas.w = w;
-    ctx->canvas.h = h;
+bool noe_add_step_hook(noe_Context *ctx, noe_StepHook hook, void *userdata)
+{
+    if(ctx->step_hooks_count >= NOE_MAX_STEP_HOOKS) return false;
+    ctx->step_hooks[ctx->step_hooks_count] = hook;
+    ctx->step_hooks_userdata[ctx->step_hooks_count] = userdata;
+    ctx->step_hooks_count += 1;
+    return true;
+}
 
-    if(!noe_platform_init(ctx)) {
-        NOE_FREE(ctx);
-        return NULL;
+void noe_remove_step_hook(noe_Context *ctx, noe_StepHook hook, void *userdata)
+{
+    for(int i = 0; i < ctx->step_hooks_count; ++i) {
+        if(ctx->step_hooks[i] != hook || ctx->step_hooks_userdata[i] != userdata) continue;
+        // Keep the order the hooks were added in
+        for(int j = i + 1; j < ctx->step_hooks_count; ++j) {
+            ctx->step_hooks[j - 1] = ctx->step_hooks[j];
+            ctx->step_hooks_userdata[j - 1] = ctx->step_hooks_userdata[j];
+        }
+        ctx->step_hooks_count -= 1;
+        return;
     }
+}
 
-    ctx->target_frame_time = 1.0/60.0;
-    ctx->init_time = noe_gettime();
-    ctx->last_frame_time = ctx->init_time;
-    ctx->initialized = true;
-    return ctx;
+void noe_push_target(noe_Context *ctx, noe_Image image)
+{
+    NOE_ASSERT(ctx->targets_count < NOE_TARGET_STACK_SIZE && "Render target stack overflow");
+    if(ctx->targets_count >= NOE_TARGET_STACK_SIZE) {
+        ctx->targets_dropped += 1;
+        return;
+    }
+    ctx->targets_clip_base[ctx->targets_count] = ctx->clips_count;
+    ctx->targets_clips_dropped[ctx->targets_count] = ctx->clips_dropped;
+    ctx->targets[ctx->targets_count++] = image;
 }
 
-void noe_close(noe_Context *ctx)
+void noe_pop_target(noe_Context *ctx)
 {
-    if(!ctx) return;
-    noe_platform_close(ctx);
-    noe_unload_image(ctx->canvas);
-    NOE_FREE(ctx);
+    if(ctx->targets_dropped > 0) {
+        ctx->targets_dropped -= 1;
+        return;
+    }
+    NOE_ASSERT(ctx->targets_count > 0 && "Render target stack underflow");
+    if(ctx->targets_count <= 0) return;
+    ctx->targets_count -= 1;
+    // Clip rects pushed while the target was active belong to it
+    ctx->clips_count = ctx->targets_clip_base[ctx->targets_count];
+    ctx->clips_dropped = ctx->targets_clips_dropped[ctx->targets_count];
 }
 
-void noe_set_should_close(noe_Context *ctx, bool should_close)
+noe_Image noe_current_target(noe_Context *ctx)
 {
-    ctx->should_close = should_close;
+    if(ctx->targets_count > 0) return ctx->targets[ctx->targets_count - 1];
+    return ctx->canvas;
 }
 
-bool noe_step(noe_Context *ctx, double *dt)
+static int noe_clip_base(noe_Context *ctx)
 {
-    /// Draw to window
-    noe_platform_redraw_surface(ctx);
+    return ctx->targets_count > 0 ? ctx->targets_clip_base[ctx->targets_count - 1] : 0;
+}
 
-    // Handle delta time
-    double now = noe_gettime();
-    double prev = ctx->last_frame_time;
-    double wait = (prev + ctx->target_frame_time) - now;
-    if(wait > 0) {
-        noe_sleep(wait * 1000);
-        ctx->last_frame_time += ctx->target_frame_time;
-    } else {
-        ctx->last_frame_time = now;
+noe_Rect noe_get_clip_rect(noe_Context *ctx)
+{
+    noe_Image target = noe_current_target(ctx);
+    noe_Rect bounds = noe_rect(0, 0, target.w, target.h);
+    if(ctx->clips_count > noe_clip_base(ctx)) {
+        return noe_clip_rect(bounds, ctx->clips[ctx->clips_count - 1]);
     }
-    if(dt) *dt = ctx->last_frame_time - prev;
+    return bounds;
+}
 
-    ctx->prev_cursor_pos = ctx->curr_cursor_pos;
-    for(int i = 0; i < NOE_SUPPORTED_BTNS; ++i) {
-        ctx->prev_btn_states[i] = ctx->curr_btn_states[i];
-    }
-    for(int i = 0; i < NOE_SUPPORTED_KEYS; ++i) {
-        ctx->prev_key_states[i] = ctx->curr_key_states[i];
+void noe_push_clip_rect(noe_Context *ctx, noe_Rect r)
+{
+    NOE_ASSERT(ctx->clips_count < NOE_CLIP_STACK_SIZE && "Clip stack overflow");
+    if(ctx->clips_count >= NOE_CLIP_STACK_SIZE) {
+        ctx->clips_dropped += 1;
+        return;
     }
+    noe_Rect clip = noe_clip_rect(noe_get_clip_rect(ctx), r);
+    ctx->clips[ctx->clips_count++] = clip;
+}
 
-    noe_platform_poll_inputs(ctx);
-    return !ctx->should_close;
+void noe_pop_clip_rect(noe_Context *ctx)
+{
+    if(ctx->clips_dropped > 0) {
+        ctx->clips_dropped -= 1;
+        return;
+    }
+    NOE_ASSERT(ctx->clips_count > noe_clip_base(ctx) && "Clip stack underflow");
+    if(ctx->clips_count <= noe_clip_base(ctx)) return;
+    ctx->clips_count -= 1;
 }
 
 void noe_clear_background(noe_Context *ctx, noe_Color color)
 {
-    noe_draw_rect(ctx, color, 
-            noe_rect(0,0,ctx->canvas.w, ctx->canvas.h));
+    NOE_PROFILE_BEGIN("noe_clear_background");
+    noe_Image target = noe_current_target(ctx);
+    noe_count_draw(ctx, NOE_DRAW_CLEAR);
+    noe_count_pixels(ctx, noe_rect(0, 0, target.w, target.h), 0);
+    noe_raster_rect(target, noe_get_clip_rect(ctx), color, noe_rect(0, 0, target.w, target.h));
+    NOE_PROFILE_END();
 }
 
 void noe_draw_pixel(noe_Context *ctx, noe_Color color, int x, int y)
 {
-    noe_image_draw_pixel(ctx->canvas, color, x, y);
+    noe_count_draw(ctx, NOE_DRAW_PIXEL);
+    noe_Rect clip = noe_get_clip_rect(ctx);
+    if(x < clip.x || y < clip.y || x >= clip.x + clip.w || y >= clip.y + clip.h) return;
+    noe_count_pixels(ctx, noe_rect(x, y, 1, 1), 0);
+    noe_image_draw_pixel(noe_current_target(ctx), color, x, y);
 }
 
 void noe_draw_rect(noe_Context *ctx, noe_Color color, noe_Rect r)
 {
-    noe_image_draw_rect(ctx->canvas, color, r);
+    NOE_PROFILE_BEGIN("noe_draw_rect");
+    noe_count_draw(ctx, NOE_DRAW_RECT);
+    noe_count_pixels(ctx, r, 0);
+    noe_raster_rect(noe_current_target(ctx), noe_get_clip_rect(ctx), color, r);
+    NOE_PROFILE_END();
+}
+
+bool noe_screen_resized(noe_Context *ctx)
+{
+    return ctx->resized;
 }
 
 int noe_screen_width(noe_Context *ctx)
@@ -493,50 +2729,50 @@ int noe_screen_height(noe_Context *ctx)
 
 bool noe_key_pressed(noe_Context *ctx, int key)
 {
-    if(key < 0 && key > NOE_SUPPORTED_KEYS) return false;
-    return ctx->prev_key_states[key] == 0 && ctx->curr_key_states[key] == 1;
+    if(key < 0 || key >= NOE_SUPPORTED_KEYS) return false;
+    return NOE_BIT_GET(ctx->key_pressed_bits, key);
 }
 
 bool noe_key_released(noe_Context *ctx, int key)
 {
-    if(key < 0 && key > NOE_SUPPORTED_KEYS) return false;
-    return ctx->prev_key_states[key] == 1 && ctx->curr_key_states[key] == 0;
+    if(key < 0 || key >= NOE_SUPPORTED_KEYS) return false;
+    return NOE_BIT_GET(ctx->key_released_bits, key);
 }
 
 bool noe_key_down(noe_Context *ctx, int key)
 {
-    if(key < 0 && key > NOE_SUPPORTED_KEYS) return false;
-    return ctx->curr_key_states[key] == 1;
+    if(key < 0 || key >= NOE_SUPPORTED_KEYS) return false;
+    return ctx->curr_key_states[key];
 }
 
 bool noe_key_up(noe_Context *ctx, int key)
 {
-    if(key < 0 && key > NOE_SUPPORTED_KEYS) return false;
-    return ctx->curr_key_states[key] == 0;
+    if(key < 0 || key >= NOE_SUPPORTED_KEYS) return false;
+    return !ctx->curr_key_states[key];
 }
 
 bool noe_button_pressed(noe_Context *ctx, int button)
 {
-    if(button < 0 && button > NOE_SUPPORTED_BTNS) return false;
-    return ctx->prev_btn_states[button] == 0 && ctx->curr_btn_states[button] == 1;
+    if(button < 0 || button >= NOE_SUPPORTED_BTNS) return false;
+    return (ctx->btn_pressed_bits >> button) & 1;
 }
 
 bool noe_button_down(noe_Context *ctx, int button)
 {
-    if(button < 0 && button >= NOE_SUPPORTED_BTNS) return false;
-    return ctx->curr_btn_states[button] == 1;
+    if(button < 0 || button >= NOE_SUPPORTED_BTNS) return false;
+    return ctx->curr_btn_states[button];
 }
 
 bool noe_button_released(noe_Context *ctx, int button)
 {
-    if(button < 0 && button > NOE_SUPPORTED_BTNS) return false;
-    return ctx->prev_btn_states[button] == 1 && ctx->curr_btn_states[button] == 0;
+    if(button < 0 || button >= NOE_SUPPORTED_BTNS) return false;
+    return (ctx->btn_released_bits >> button) & 1;
 }
 
 bool noe_button_up(noe_Context *ctx, int button)
 {
-    if(button < 0 && button > NOE_SUPPORTED_BTNS) return false;
-    return ctx->curr_btn_states[button] == 0;
+    if(button < 0 || button >= NOE_SUPPORTED_BTNS) return false;
+    return !ctx->curr_btn_states[button];
 }
 
 noe_Vec2 noe_cursor_pos(noe_Context *ctx)
@@ -550,50 +2786,120 @@ noe_Vec2 noe_cursor_delta(noe_Context *ctx)
             ctx->curr_cursor_pos.y - ctx->prev_cursor_pos.y);
 }
 
-void noe_draw_image(noe_Context *ctx, noe_Image image, int x, int y)
+noe_Vec2 noe_wheel_delta(noe_Context *ctx)
 {
-    if((0 > x || x > image.w) || (0 > y || y > image.h)) return;
-
-    noe_Rect r = noe_rect(x,y,image.w,image.h);
-    r = noe_clip_rect(noe_rect(0,0,ctx->canvas.w,ctx->canvas.h), r);
+    return ctx->curr_wheel_mov;
+}
 
-    for(int dy = r.y; dy < r.y + r.h; ++dy) {
-        for(int dx = r.x; dx < r.x + r.w; ++dx) {
-            noe_image_draw_pixel(ctx->canvas, noe_image_get_pixel(image, dx, dy), dx, dy);
-        }
-    }
+void noe_draw_image(noe_Context *ctx, noe_Image image, int x, int y)
+{
+    NOE_PROFILE_BEGIN("noe_draw_image");
+    noe_count_draw(ctx, NOE_DRAW_IMAGE);
+    noe_count_pixels(ctx, noe_rect(x, y, image.w, image.h), 1);
+    noe_blit(noe_current_target(ctx), noe_get_clip_rect(ctx), image, x, y);
+    NOE_PROFILE_END();
 }
 
 void noe_draw_image2(noe_Context *ctx, noe_Image image, noe_Rect src, noe_Rect dst)
 {
-    const int pixelformat = image.format;
-    const int nchannels = g_pixelformatinfos[pixelformat].channels;
-    // TODO(bagasjs): This is sucks find a way so we allocate incrementally when we need either 
-    //                use arena (it will nice if we have global arena but this will not threadsafe)
-    uint8_t *srcbuf = NOE_MALLOC(src.w * src.h * nchannels);
-    noe_Image srci = noe_load_image(srcbuf,src.w,src.h,pixelformat);
+    NOE_PROFILE_BEGIN("noe_draw_image2");
+    noe_count_draw(ctx, NOE_DRAW_IMAGE2);
+    noe_count_pixels(ctx, dst, 1);
+    noe_resize_region(noe_current_target(ctx), noe_get_clip_rect(ctx), image, src, dst,
+            NOE_RESIZE_LINEAR, NOE_RESIZE_NEAREST);
+    NOE_PROFILE_END();
+}
 
-    for(int y = 0; y < src.h; ++y) {
-        for(int x = 0; x < src.w; ++x) {
-            noe_image_draw_pixel(srci, noe_image_get_pixel(image, src.x + x, src.y + y), x,y);
-        }
-    }
+void noe_draw_mask(noe_Context *ctx, noe_Image mask, noe_Rect src, noe_Rect dst, noe_Color color)
+{
+    NOE_PROFILE_BEGIN("noe_draw_mask");
+    noe_count_draw(ctx, NOE_DRAW_MASK);
+    noe_count_pixels(ctx, dst, 2);
+    noe_blend_mask_region(noe_current_target(ctx), noe_get_clip_rect(ctx), mask, src, dst, color);
+    NOE_PROFILE_END();
+}
 
-    noe_image_resize(&ctx->canvas, srci, dst, NOE_RESIZE_LINEAR, NOE_RESIZE_NEAREST);
-    NOE_FREE(srcbuf);
+void noe_draw_image_transformed(noe_Context *ctx, noe_Image image, noe_Rect src, noe_Mat2x3 transform, int filter)
+{
+    NOE_PROFILE_BEGIN("noe_draw_image_transformed");
+    noe_Vec2 corners[4] = {
+        noe_mat2x3_transform(transform, noe_vec2(0, 0)),
+        noe_mat2x3_transform(transform, noe_vec2(src.w, 0)),
+        noe_mat2x3_transform(transform, noe_vec2(0, src.h)),
+        noe_mat2x3_transform(transform, noe_vec2(src.w, src.h)),
+    };
+    noe_count_draw(ctx, NOE_DRAW_IMAGE_TRANSFORMED);
+    noe_count_pixels(ctx, noe_bounds_of_points(ctx, corners, 4, 0.0f), filter == NOE_RESIZE_LINEAR ? 4 : 1);
+    noe_blit_transformed(noe_current_target(ctx), noe_get_clip_rect(ctx), image, src, transform, filter);
+    NOE_PROFILE_END();
 }
 
 void noe_draw_image_scaled_to_screen(noe_Context *ctx, noe_Image image)
 {
-    noe_Rect r = noe_rect(0, 0, ctx->canvas.w, ctx->canvas.h);
-    noe_image_resize(&ctx->canvas, image, r, NOE_RESIZE_LINEAR, NOE_RESIZE_NEAREST);
+    NOE_PROFILE_BEGIN("noe_draw_image_scaled_to_screen");
+    noe_Image target = noe_current_target(ctx);
+    noe_Rect r = noe_rect(0, 0, target.w, target.h);
+    noe_count_draw(ctx, NOE_DRAW_IMAGE_SCALED_TO_SCREEN);
+    noe_count_pixels(ctx, r, 1);
+    noe_resize_region(target, noe_get_clip_rect(ctx), image, noe_rect(0, 0, image.w, image.h),
+            r, NOE_RESIZE_LINEAR, NOE_RESIZE_NEAREST);
+    NOE_PROFILE_END();
+}
+
+void noe_draw_triangle(noe_Context *ctx, noe_Color color, noe_Vec2 a, noe_Vec2 b, noe_Vec2 c)
+{
+    NOE_PROFILE_BEGIN("noe_draw_triangle");
+    noe_Vec2 points[3] = { a, b, c };
+    noe_count_draw(ctx, NOE_DRAW_TRIANGLE);
+    noe_count_pixels(ctx, noe_bounds_of_points(ctx, points, 3, 0.0f), 0);
+    noe_raster_triangle(noe_current_target(ctx), noe_get_clip_rect(ctx), a, b, c, NULL, color);
+    NOE_PROFILE_END();
+}
+
+void noe_draw_triangle_colors(noe_Context *ctx, noe_Vec2 a, noe_Vec2 b, noe_Vec2 c,
+        noe_Color ca, noe_Color cb, noe_Color cc)
+{
+    NOE_PROFILE_BEGIN("noe_draw_triangle_colors");
+    noe_Vec2 points[3] = { a, b, c };
+    noe_count_draw(ctx, NOE_DRAW_TRIANGLE_COLORS);
+    noe_count_pixels(ctx, noe_bounds_of_points(ctx, points, 3, 0.0f), 0);
+    noe_Color colors[3] = { ca, cb, cc };
+    noe_raster_triangle(noe_current_target(ctx), noe_get_clip_rect(ctx), a, b, c, colors, ca);
+    NOE_PROFILE_END();
+}
+
+void noe_draw_polygon(noe_Context *ctx, noe_Color color, const noe_Vec2 *points, int count)
+{
+    NOE_PROFILE_BEGIN("noe_draw_polygon");
+    noe_count_draw(ctx, NOE_DRAW_POLYGON);
+    noe_count_pixels(ctx, noe_bounds_of_points(ctx, points, count, 0.0f), 0);
+    noe_raster_polygon(noe_current_target(ctx), noe_get_clip_rect(ctx), color, points, count);
+    NOE_PROFILE_END();
+}
+
+void noe_fill_path(noe_Context *ctx, noe_Color color, const noe_Path *path, int fill_rule)
+{
+    NOE_PROFILE_BEGIN("noe_fill_path");
+    noe_count_draw(ctx, NOE_DRAW_FILL_PATH);
+    noe_count_pixels(ctx, noe_bounds_of_points(ctx, path->points, path->points_count, 0.0f), 1);
+    noe_raster_path(noe_current_target(ctx), noe_get_clip_rect(ctx), color, path, fill_rule);
+    NOE_PROFILE_END();
+}
+
+void noe_stroke_path(noe_Context *ctx, noe_Color color, const noe_Path *path, float width)
+{
+    NOE_PROFILE_BEGIN("noe_stroke_path");
+    noe_count_draw(ctx, NOE_DRAW_STROKE_PATH);
+    noe_count_pixels(ctx, noe_bounds_of_points(ctx, path->points, path->points_count, width*0.5f + 1.0f), 1);
+    noe_raster_stroke(noe_current_target(ctx), noe_get_clip_rect(ctx), color, path, width);
+    NOE_PROFILE_END();
 }
 
 noe_Font noe_create_font(noe_Image atlas, int codepoint_count)
 {
     noe_Font font;
     font.atlas = atlas;
-    font.codepoints = NOE_MALLOC(sizeof(*font.codepoints)*codepoint_count);
+    font.codepoints = noe_alloc(sizeof(*font.codepoints)*codepoint_count);
     font.codepoints_count = codepoint_count;
     return font;
 }
@@ -618,7 +2924,13 @@ void noe_draw_text(noe_Context *ctx, noe_Font font, noe_Color color, const char
     size_t textLength = strlen(text);
     noe_Vec2 pos = {x, y};
 
+    noe_count_draw(ctx, NOE_DRAW_TEXT);
+    noe_Rect clip = noe_get_clip_rect(ctx);
+    if(y >= clip.y + clip.h || y + font.atlas.h*scale <= clip.y) return;
+
+    NOE_PROFILE_BEGIN("noe_draw_text");
     for(int i = 0; i < (int)textLength; ++i) {
+        if(pos.x >= clip.x + clip.w) break;
         noe_Glyph cp = font.codepoints[text[i] - 32];
         noe_Rect src;
         src.x = cp.l;
@@ -631,9 +2943,11 @@ void noe_draw_text(noe_Context *ctx, noe_Font font, noe_Color color, const char
         dst.y = pos.y;
         dst.w = (cp.r-cp.l)*scale;
         dst.h = font.atlas.h*scale;
-        noe_draw_image2(ctx, font.atlas, src, dst);
+        noe_count_pixels(ctx, dst, 2);
+        noe_blend_mask_region(noe_current_target(ctx), clip, font.atlas, src, dst, color);
         pos.x += dst.w;
     }
+    NOE_PROFILE_END();
 }
 
 float noe_font_measure_text(noe_Font font, const char *text, int fontsize)
@@ -658,12 +2972,31 @@ float noe_font_measure_text(noe_Font font, const char *text, int fontsize)
 
 #include <windows.h>
 #include <windowsx.h>
+#include <mmsystem.h>
 
 struct noe_PlatformContext {
     HWND wnd;
     HINSTANCE inst;
+    WCHAR high_surrogate; // first half of a character outside the BMP, WM_CHAR sends them one by one
+    MOUSEMOVEPOINT last_move; // screen position and time of the last pushed motion, 0 before the first
 };
 
+static void noe_win32_blit(HDC hdc, noe_Image image)
+{
+    BITMAPINFO bmi = {
+        .bmiHeader.biSize = sizeof(BITMAPINFOHEADER),
+        .bmiHeader.biBitCount = 32,
+        .bmiHeader.biCompression = BI_RGB,
+        .bmiHeader.biPlanes = 1,
+        // The rows of the canvas may be longer than what is visible
+        .bmiHeader.biWidth = noe_stride(image) / 4,
+        .bmiHeader.biHeight = -image.h,
+    };
+    StretchDIBits(hdc, 0, 0, image.w, image.h,
+            0, 0, image.w, image.h,
+            image.pixels, &bmi, DIB_RGB_COLORS, SRCCOPY);
+}
+
 double noe_gettime(void)
 {
 #ifdef _WIN32
@@ -722,6 +3055,75 @@ static int _noe_win32_scancode_mapping[0x1FF] = {
     /** [0x04A] = NOE_KEY_KP_SUBTRACT, */
 };
 
+static void noe_resize_canvas(noe_Context *ctx, int w, int h)
+{
+    // Minimizing reports a size of 0
+    if(w <= 0 || h <= 0 || (w == ctx->canvas.w && h == ctx->canvas.h)) return;
+    ctx->resized = true;
+    noe_fit_canvas(ctx, w, h);
+}
+
+// Message times are GetTickCount milliseconds. Convert them to the noe_gettime
+// clock so the events tell when the input arrived, not when it was dispatched.
+// They are only as precise as the system tick.
+static double noe_win32_tick_to_time(DWORD tick)
+{
+    double now = noe_gettime();
+    LONG age = (LONG)(GetTickCount() - tick);
+    return age > 0 ? now - age / 1000.0 : now;
+}
+
+// When the message being handled was posted
+static double noe_win32_message_time(void)
+{
+    return noe_win32_tick_to_time((DWORD)GetMessageTime());
+}
+
+#define NOE_WIN32_MOVE_POINTS 64 // the most GetMouseMovePointsEx keeps
+
+// WM_MOUSEMOVE is coalesced, it only reports where the mouse is now. The
+// positions it went through since the last one are taken from the system's
+// move history and pushed first.
+static void noe_win32_push_motion(noe_Context *ctx, HWND wnd, LPARAM lp)
+{
+    noe_PlatformContext *platform = ctx->platform;
+    POINT pos = { GET_X_LPARAM(lp), GET_Y_LPARAM(lp) };
+    POINT screen = pos;
+    ClientToScreen(wnd, &screen);
+    // Negative coordinates of other monitors must be passed as 16 bit values
+    MOUSEMOVEPOINT curr = { .x = screen.x & 0xFFFF, .y = screen.y & 0xFFFF, .time = (DWORD)GetMessageTime() };
+
+    MOUSEMOVEPOINT points[NOE_WIN32_MOVE_POINTS];
+    int count = 0;
+    if(platform->last_move.time) {
+        count = GetMouseMovePointsEx(sizeof(MOUSEMOVEPOINT), &curr, points, NOE_WIN32_MOVE_POINTS, GMMP_USE_DISPLAY_POINTS);
+        if(count < 0) count = 0;
+    }
+    // The history goes from the newest point, the current one, to the oldest
+    int fresh = 0;
+    for(; fresh < count; ++fresh) {
+        const MOUSEMOVEPOINT *p = &points[fresh];
+        const MOUSEMOVEPOINT *last = &platform->last_move;
+        if((LONG)(p->time - last->time) < 0) break;
+        if(p->time == last->time && p->x == last->x && p->y == last->y) break;
+    }
+    for(int i = fresh - 1; i > 0; --i) {
+        POINT p = { points[i].x > 32767 ? points[i].x - 65536 : points[i].x,
+                    points[i].y > 32767 ? points[i].y - 65536 : points[i].y };
+        ScreenToClient(wnd, &p);
+        noe_Event ev = { .type = NOE_EVENT_MOTION, .time = noe_win32_tick_to_time(points[i].time) };
+        ev.x = p.x;
+        ev.y = p.y;
+        noe_platform_push_event(ctx, ev);
+    }
+
+    noe_Event ev = { .type = NOE_EVENT_MOTION, .time = noe_win32_tick_to_time(curr.time) };
+    ev.x = pos.x;
+    ev.y = pos.y;
+    noe_platform_push_event(ctx, ev);
+    platform->last_move = curr;
+}
+
 typedef struct BINFO{
     BITMAPINFOHEADER    bmiHeader;
     RGBQUAD             bmiColors[3];
@@ -731,12 +3133,23 @@ static LRESULT CALLBACK _noe_win32_window_proc(
     _In_ HWND wnd, _In_ UINT msg, _In_ WPARAM wp, _In_ LPARAM lp)
 {
     noe_Context *ctx = (noe_Context *)GetWindowLongPtr(wnd, GWLP_USERDATA);
+    // Messages sent while the window is being created arrive before the context is attached
+    if(!ctx) return DefWindowProc(wnd, msg, wp, lp);
 
     switch(msg) {
         case WM_MOUSEMOVE:
+            noe_win32_push_motion(ctx, wnd, lp);
+            break;
+        case WM_MOUSEWHEEL:
+#ifdef WM_MOUSEHWHEEL
+        case WM_MOUSEHWHEEL:
+#endif
             {
-                ctx->curr_cursor_pos.x = GET_X_LPARAM(lp);
-                ctx->curr_cursor_pos.y = GET_Y_LPARAM(lp);
+                noe_Event ev = { .type = NOE_EVENT_WHEEL, .time = noe_win32_message_time() };
+                float delta = (float)GET_WHEEL_DELTA_WPARAM(wp) / WHEEL_DELTA;
+                if(msg == WM_MOUSEWHEEL) ev.y = delta;
+                else ev.x = delta;
+                noe_platform_push_event(ctx, ev);
             }
             break;
         case WM_LBUTTONDOWN: 
@@ -772,7 +3185,11 @@ static LRESULT CALLBACK _noe_win32_window_proc(
                         break;
                 }
 
-                ctx->curr_btn_states[button] = state;
+                noe_Event ev = { .type = state ? NOE_EVENT_BUTTON_DOWN : NOE_EVENT_BUTTON_UP, .time = noe_win32_message_time() };
+                ev.code = button;
+                ev.x = GET_X_LPARAM(lp);
+                ev.y = GET_Y_LPARAM(lp);
+                noe_platform_push_event(ctx, ev);
                 if (state) {
                     SetCapture(wnd);
                 } else {
@@ -786,16 +3203,15 @@ static LRESULT CALLBACK _noe_win32_window_proc(
             {
                 int key, scancode;
                 bool key_state = !(HIWORD(lp) & KF_UP) ? 1 : 0;
+                int mods = 0;
 
-                // If it's pressed then set the modifier bits
-                if(key_state == 1) {
-                    if(GetKeyState(VK_SHIFT) & 0x8000) key_state |= NOE_KEYMOD_SHIFT;
-                    if(GetKeyState(VK_CONTROL) & 0x8000) key_state |= NOE_KEYMOD_CONTROL;
-                    if(GetKeyState(VK_MENU) & 0x8000) key_state |= NOE_KEYMOD_ALT;
-                    if((GetKeyState(VK_LWIN) | GetKeyState(VK_RWIN)) & 0x8000) key_state |= NOE_KEYMOD_SHIFT;
-                    if(GetKeyState(VK_CAPITAL) & 1) key_state |= NOE_KEYMOD_CAPSLOCK;
-                    if(GetKeyState(VK_NUMLOCK) & 1) key_state |= NOE_KEYMOD_NUMLOCK;
-                }
+                // The modifiers held when the key changed, releases included
+                if(GetKeyState(VK_SHIFT) & 0x8000) mods |= NOE_KEYMOD_SHIFT;
+                if(GetKeyState(VK_CONTROL) & 0x8000) mods |= NOE_KEYMOD_CONTROL;
+                if(GetKeyState(VK_MENU) & 0x8000) mods |= NOE_KEYMOD_ALT;
+                if((GetKeyState(VK_LWIN) | GetKeyState(VK_RWIN)) & 0x8000) mods |= NOE_KEYMOD_SUPER;
+                if(GetKeyState(VK_CAPITAL) & 1) mods |= NOE_KEYMOD_CAPSLOCK;
+                if(GetKeyState(VK_NUMLOCK) & 1) mods |= NOE_KEYMOD_NUMLOCK;
 
                 scancode = (HIWORD(lp) & (KF_EXTENDED | 0xff));
                 if(!scancode) scancode = MapVirtualKeyA((UINT)wp, MAPVK_VK_TO_VSC);
@@ -810,9 +3226,33 @@ static LRESULT CALLBACK _noe_win32_window_proc(
                 if (scancode == 0x136) scancode = 0x36;
                 key = _noe_win32_scancode_mapping[scancode];
 
-                if(0 <= key && key < NOE_SUPPORTED_KEYS) {
-                    ctx->curr_key_states[key] = key_state;
+                if(0 < key && key < NOE_SUPPORTED_KEYS) {
+                    noe_Event ev = { .type = key_state ? NOE_EVENT_KEY_DOWN : NOE_EVENT_KEY_UP, .time = noe_win32_message_time() };
+                    ev.code = key;
+                    ev.mods = mods;
+                    noe_platform_push_event(ctx, ev);
+                }
+            }
+            break;
+        case WM_CHAR:
+            {
+                WCHAR unit = (WCHAR)wp;
+                if(IS_HIGH_SURROGATE(unit)) {
+                    ctx->platform->high_surrogate = unit;
+                    break;
+                }
+                int codepoint = unit;
+                if(IS_LOW_SURROGATE(unit)) {
+                    WCHAR high = ctx->platform->high_surrogate;
+                    if(!high) break;
+                    codepoint = 0x10000 + ((high - 0xD800) << 10) + (unit - 0xDC00);
                 }
+                ctx->platform->high_surrogate = 0;
+                // Backspace, enter and friends already arrive as key events
+                if(codepoint < 32 || codepoint == 127) break;
+                noe_Event ev = { .type = NOE_EVENT_TEXT, .time = noe_win32_message_time() };
+                ev.code = codepoint;
+                noe_platform_push_event(ctx, ev);
             }
             break;
         case WM_SIZE:
@@ -820,20 +3260,7 @@ static LRESULT CALLBACK _noe_win32_window_proc(
                 if(ctx->initialized) {
                     RECT r;
                     GetClientRect(wnd, &r);
-                    int new_w = r.right - r.left;
-                    int new_h = r.bottom - r.top;
-                    noe_Image new_canvas = noe_create_image(new_w,new_h,ctx->canvas.format);
-                    // // Old code
-                    // noe_Rect dim = noe_rect(0, 0, new_w, new_h);
-                    // noe_image_resize(&new_canvas, ctx->canvas, dim, NOE_RESIZE_LINEAR, NOE_RESIZE_NEAREST);
-                    // noe_unload_image(ctx->canvas);
-                    // // End of Old code
-
-                    // TODO(bagasjs): This kind of resizing might be not what we wanted.
-                    // Since it will stretch the content of the image. What we want might be
-                    // just fill (if resizing up) or cropping (if resizing down)
-                    noe_image_resize_fill_and_crop(new_canvas, ctx->canvas);
-                    ctx->canvas = new_canvas;
+                    noe_resize_canvas(ctx, r.right - r.left, r.bottom - r.top);
                 }
             }
             break;
@@ -841,17 +3268,18 @@ static LRESULT CALLBACK _noe_win32_window_proc(
             {
                 PAINTSTRUCT ps;
                 HDC hdc = BeginPaint(wnd, &ps);
-                BITMAPINFO bmi = {
-                    .bmiHeader.biSize = sizeof(BITMAPINFOHEADER),
-                    .bmiHeader.biBitCount = 32,
-                    .bmiHeader.biCompression = BI_RGB,
-                    .bmiHeader.biPlanes = 1,
-                    .bmiHeader.biWidth = ctx->canvas.w,
-                    .bmiHeader.biHeight = -ctx->canvas.h,
-                };
-                StretchDIBits(hdc, 0, 0, ctx->canvas.w, ctx->canvas.h,
-                        0, 0, ctx->canvas.w, ctx->canvas.h,
-                        ctx->canvas.pixels, &bmi, DIB_RGB_COLORS, SRCCOPY);
+                if(!ctx->present_thread) {
+                    noe_win32_blit(hdc, ctx->canvas);
+                } else {
+                    // A skipped frame never gets presented, so repaint the
+                    // last one that was. Its buffer only becomes the canvas
+                    // again once it is done, the canvas is current then.
+                    noe_mutex_lock(ctx->present_mutex);
+                    int index = ctx->presented_buffer;
+                    if(index == ctx->back_buffer) noe_win32_blit(hdc, ctx->canvas);
+                    else if(index >= 0) noe_win32_blit(hdc, ctx->present_buffers[index].image);
+                    noe_mutex_unlock(ctx->present_mutex);
+                }
                 EndPaint(wnd, &ps);
             }
             break;
@@ -869,11 +3297,14 @@ static LRESULT CALLBACK _noe_win32_window_proc(
 
 bool noe_platform_init(noe_Context *ctx)
 {
+    // Makes Sleep(1) last about 1ms instead of a whole scheduler tick
+    timeBeginPeriod(1);
     ctx->canvas = noe_create_image(ctx->canvas.w, ctx->canvas.h, NOE_PIXELFORMAT_B8G8R8A8);
-    noe_PlatformContext *platform = NOE_MALLOC(sizeof(noe_PlatformContext));
+    noe_PlatformContext *platform = noe_alloc(sizeof(noe_PlatformContext));
     if(!platform) {
         return false;
     }
+    memset(platform, 0, sizeof(*platform));
 
     platform->inst = GetModuleHandle(NULL);
     WNDCLASSEX wc = {0};
@@ -897,15 +3328,17 @@ bool noe_platform_init(noe_Context *ctx)
         return false;
     }
 
+    // The window procedure reaches the platform through the context
+    ctx->platform = platform;
     SetWindowLongPtr(platform->wnd, GWLP_USERDATA, (LONG_PTR)ctx);
     ShowWindow(platform->wnd, SW_NORMAL);
     UpdateWindow(platform->wnd);
-    ctx->platform = platform;
     return true;
 }
 
 void noe_platform_close(noe_Context *ctx)
 {
+    timeEndPeriod(1);
     NOE_FREE(ctx->platform);
     (void)ctx;
 }
@@ -927,11 +3360,285 @@ void noe_platform_redraw_surface(noe_Context *ctx)
     RedrawWindow(ctx->platform->wnd, 0, 0, RDW_INVALIDATE | RDW_UPDATENOW);
 }
 
+void noe_platform_present_image(noe_Context *ctx, noe_Image image)
+{
+    // GDI may draw to a window from any thread through its own DC
+    HDC hdc = GetDC(ctx->platform->wnd);
+    noe_win32_blit(hdc, image);
+    ReleaseDC(ctx->platform->wnd, hdc);
+}
+
 void noe_set_window_title(noe_Context *ctx, const char *title)
 {
+    if(!ctx->platform) return;
     SetWindowText(ctx->platform->wnd, title);
 }
 
+
+struct noe_Thread {
+    HANDLE handle;
+    int (*fn)(void *arg);
+    void *arg;
+    int result;
+};
+
+struct noe_Mutex {
+    SRWLOCK lock;
+};
+
+struct noe_Cond {
+    CONDITION_VARIABLE cv;
+};
+
+static DWORD WINAPI noe_thread_entry(LPVOID param)
+{
+    noe_Thread *thread = param;
+    thread->result = thread->fn(thread->arg);
+    return 0;
+}
+
+noe_Thread *noe_thread_create(int (*fn)(void *arg), void *arg)
+{
+    noe_Thread *thread = noe_alloc(sizeof(*thread));
+    if(!thread) return NULL;
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->result = 0;
+    thread->handle = CreateThread(NULL, 0, noe_thread_entry, thread, 0, NULL);
+    if(!thread->handle) {
+        NOE_FREE(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+int noe_thread_join(noe_Thread *thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    int result = thread->result;
+    NOE_FREE(thread);
+    return result;
+}
+
+int noe_cpu_count(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return NOE_MAX((int)info.dwNumberOfProcessors, 1);
+}
+
+noe_Mutex *noe_mutex_create(void)
+{
+    noe_Mutex *mutex = noe_alloc(sizeof(*mutex));
+    if(mutex) InitializeSRWLock(&mutex->lock);
+    return mutex;
+}
+
+void noe_mutex_destroy(noe_Mutex *mutex)
+{
+    NOE_FREE(mutex);
+}
+
+void noe_mutex_lock(noe_Mutex *mutex)
+{
+    AcquireSRWLockExclusive(&mutex->lock);
+}
+
+void noe_mutex_unlock(noe_Mutex *mutex)
+{
+    ReleaseSRWLockExclusive(&mutex->lock);
+}
+
+noe_Cond *noe_cond_create(void)
+{
+    noe_Cond *cond = noe_alloc(sizeof(*cond));
+    if(cond) InitializeConditionVariable(&cond->cv);
+    return cond;
+}
+
+void noe_cond_destroy(noe_Cond *cond)
+{
+    NOE_FREE(cond);
+}
+
+void noe_cond_wait(noe_Cond *cond, noe_Mutex *mutex)
+{
+    SleepConditionVariableSRW(&cond->cv, &mutex->lock, INFINITE, 0);
+}
+
+void noe_cond_signal(noe_Cond *cond)
+{
+    WakeConditionVariable(&cond->cv);
+}
+
+void noe_cond_broadcast(noe_Cond *cond)
+{
+    WakeAllConditionVariable(&cond->cv);
+}
+
+#else
+
+// There is no windowing platform for other systems yet, but timing works and
+// headless contexts can be used to render offscreen.
+
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+struct noe_PlatformContext {
+    int unused;
+};
+
+double noe_gettime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void noe_sleep(int milis)
+{
+    if(milis <= 0) return;
+    struct timespec ts = { milis / 1000, (long)(milis % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+bool noe_platform_init(noe_Context *ctx)
+{
+    (void)ctx;
+    fprintf(stderr, "noe: no windowing platform available, use NOE_FLAG_HEADLESS\n");
+    return false;
+}
+
+void noe_platform_close(noe_Context *ctx)
+{
+    (void)ctx;
+}
+
+void noe_platform_poll_inputs(noe_Context *ctx)
+{
+    (void)ctx;
+}
+
+void noe_platform_redraw_surface(noe_Context *ctx)
+{
+    (void)ctx;
+}
+
+void noe_platform_present_image(noe_Context *ctx, noe_Image image)
+{
+    (void)ctx;
+    (void)image;
+}
+
+void noe_set_window_title(noe_Context *ctx, const char *title)
+{
+    (void)ctx;
+    (void)title;
+}
+
+struct noe_Thread {
+    pthread_t handle;
+    int (*fn)(void *arg);
+    void *arg;
+    int result;
+};
+
+struct noe_Mutex {
+    pthread_mutex_t lock;
+};
+
+struct noe_Cond {
+    pthread_cond_t cv;
+};
+
+static void *noe_thread_entry(void *param)
+{
+    noe_Thread *thread = param;
+    thread->result = thread->fn(thread->arg);
+    return NULL;
+}
+
+noe_Thread *noe_thread_create(int (*fn)(void *arg), void *arg)
+{
+    noe_Thread *thread = noe_alloc(sizeof(*thread));
+    if(!thread) return NULL;
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->result = 0;
+    if(pthread_create(&thread->handle, NULL, noe_thread_entry, thread) != 0) {
+        NOE_FREE(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+int noe_thread_join(noe_Thread *thread)
+{
+    pthread_join(thread->handle, NULL);
+    int result = thread->result;
+    NOE_FREE(thread);
+    return result;
+}
+
+int noe_cpu_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+noe_Mutex *noe_mutex_create(void)
+{
+    noe_Mutex *mutex = noe_alloc(sizeof(*mutex));
+    if(mutex) pthread_mutex_init(&mutex->lock, NULL);
+    return mutex;
+}
+
+void noe_mutex_destroy(noe_Mutex *mutex)
+{
+    pthread_mutex_destroy(&mutex->lock);
+    NOE_FREE(mutex);
+}
+
+void noe_mutex_lock(noe_Mutex *mutex)
+{
+    pthread_mutex_lock(&mutex->lock);
+}
+
+void noe_mutex_unlock(noe_Mutex *mutex)
+{
+    pthread_mutex_unlock(&mutex->lock);
+}
+
+noe_Cond *noe_cond_create(void)
+{
+    noe_Cond *cond = noe_alloc(sizeof(*cond));
+    if(cond) pthread_cond_init(&cond->cv, NULL);
+    return cond;
+}
+
+void noe_cond_destroy(noe_Cond *cond)
+{
+    pthread_cond_destroy(&cond->cv);
+    NOE_FREE(cond);
+}
+
+void noe_cond_wait(noe_Cond *cond, noe_Mutex *mutex)
+{
+    pthread_cond_wait(&cond->cv, &mutex->lock);
+}
+
+void noe_cond_signal(noe_Cond *cond)
+{
+    pthread_cond_signal(&cond->cv);
+}
+
+void noe_cond_broadcast(noe_Cond *cond)
+{
+    pthread_cond_broadcast(&cond->cv);
+}
+
 #endif // _WIN32
 
 
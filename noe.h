@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <math.h>
+#include <float.h>
 
 #ifndef NOE_ASSERT
 #include <assert.h>
@@ -141,11 +142,23 @@ enum noe_button {
     NOE_BUTTON_MIDDLE,
 };
 
+enum noe_event_type {
+    NOE_EVENT_NONE = 0,
+    NOE_EVENT_KEY_DOWN,
+    NOE_EVENT_KEY_UP,
+    NOE_EVENT_BUTTON_DOWN,
+    NOE_EVENT_BUTTON_UP,
+    NOE_EVENT_MOTION,
+    NOE_EVENT_WHEEL,
+    NOE_EVENT_TEXT, // a typed character, code is its Unicode codepoint
+};
+
 enum noe_flag {
     NOE_FLAG_VISIBLE    = (1 << 0),
     NOE_FLAG_RESIZABLE  = (1 << 0),
     NOE_FLAG_FULLSCREEN = (1 << 1),
     NOE_FLAG_USE_OPENGL = (1 << 2),
+    NOE_FLAG_HEADLESS   = (1 << 3), // no window, the canvas is only rendered offscreen
 };
 
 enum noe_resize_strategy {
@@ -153,6 +166,29 @@ enum noe_resize_strategy {
     NOE_RESIZE_LINEAR,
 };
 
+enum noe_fill_rule {
+    NOE_FILL_NONZERO = 0,
+    NOE_FILL_EVENODD,
+};
+
+enum noe_draw_call {
+    NOE_DRAW_CLEAR = 0,
+    NOE_DRAW_PIXEL,
+    NOE_DRAW_RECT,
+    NOE_DRAW_IMAGE,
+    NOE_DRAW_IMAGE2,
+    NOE_DRAW_IMAGE_SCALED_TO_SCREEN,
+    NOE_DRAW_IMAGE_TRANSFORMED,
+    NOE_DRAW_MASK,
+    NOE_DRAW_TRIANGLE,
+    NOE_DRAW_TRIANGLE_COLORS,
+    NOE_DRAW_POLYGON,
+    NOE_DRAW_FILL_PATH,
+    NOE_DRAW_STROKE_PATH,
+    NOE_DRAW_TEXT,
+    NOE_DRAW_CALL_COUNT,
+};
+
 #define NOE_FLAG_DEFAULT (NOE_FLAG_VISIBLE | NOE_FLAG_RESIZABLE)
 
 #ifndef NOE_CLITERAL
@@ -172,6 +208,7 @@ enum noe_resize_strategy {
 #include <stdlib.h>
 #define NOE_MALLOC malloc
 #define NOE_FREE free
+#define NOE_REALLOC realloc
 #endif
 
 #if !defined(NOE_MALLOC) || !defined(NOE_FREE)
@@ -182,22 +219,69 @@ typedef struct { float x, y; } noe_Vec2;
 typedef struct { float x, y, z; } noe_Vec3;
 typedef struct { float x, y, z, w; } noe_Vec4;
 typedef union { noe_Vec4 rows[4]; float es[4*4]; } noe_Mat4;
+typedef struct { float es[2*3]; } noe_Mat2x3; // row major affine transform: | a b tx | c d ty |
 typedef struct { int x, y, w, h; } noe_Rect;
 typedef struct { uint8_t r, g, b, a; } noe_Color;
 
+typedef struct noe_Event {
+    int type;
+    double time;   // noe_gettime() when the platform received the event
+    int code;      // key, button or codepoint
+    int mods;      // noe_keymod bits for key events
+    float x, y;    // cursor position, or the scroll amount for NOE_EVENT_WHEEL
+} noe_Event;
+
+// Timings of the last frame in seconds, filled by noe_step
+typedef struct noe_PacingStats {
+    double work_time;      // from the previous noe_step returning until this one was called
+    double present_time;   // pushing the canvas to the window
+    double sleep_time;     // waiting for the frame deadline
+    double lateness;       // how far past the deadline the frame ended
+    double frame_time;     // the delta time reported for the frame
+    double avg_frame_time;
+    double max_lateness;
+    uint64_t frames;
+    uint64_t missed_frames;
+} noe_PacingStats;
+
+// Counters of the last frame, filled by noe_step. Pixel counts are taken from
+// the clipped bounds of every draw call, so shapes that don't cover their
+// bounds (triangles, paths, text) are counted as if they did.
+typedef struct noe_FrameStats {
+    uint32_t draw_calls[NOE_DRAW_CALL_COUNT]; // indexed by noe_draw_call
+    uint32_t draw_calls_total;
+    uint64_t pixels_written;
+    uint64_t pixels_read;     // from source images and from the target when blending
+    uint64_t bytes_allocated; // through noe during the frame
+    double present_time;
+    double sleep_time;
+    double poll_time;
+    float overdraw;           // pixels written to the canvas per canvas pixel
+} noe_FrameStats;
+
 typedef struct { 
     void *texture;
     uint8_t *pixels; 
     int format;
     int w, h; 
+    int stride; // bytes from one row to the next, 0 when the rows are packed
 } noe_Image;
 
+typedef struct noe_ImageDiff {
+    uint64_t differing_pixels;
+    int max_delta;   // largest difference of a single channel
+    double mse;      // mean squared error per channel
+    double psnr;     // in dB, INFINITY when the images are identical
+} noe_ImageDiff;
+
 typedef struct noe_Glyph {
     int codepoint;
     int l, t;
     int r, b;
 } noe_Glyph;
 
+typedef struct noe_Path noe_Path;
+
 typedef struct noe_Font {
     noe_Image atlas;
     noe_Glyph *codepoints;
@@ -218,18 +302,66 @@ typedef struct noe_Font {
 #define NOE_BLUE  noe_rgba(0x00, 0x00, 0xFF, 0xFF)
 
 typedef struct noe_Context noe_Context;
+typedef struct noe_Thread noe_Thread;
+typedef struct noe_Mutex noe_Mutex;
+typedef struct noe_Cond noe_Cond;
 
 void noe_sleep(int milis);
+void noe_sleep_precise(double seconds);
 double noe_gettime(void);
 int noe_pixelformat_channel_amount(int format);
+int noe_image_stride(noe_Image image);
+
+// Minimal threading on top of the platform, used by the asynchronous parts of noe
+noe_Thread *noe_thread_create(int (*fn)(void *arg), void *arg);
+int noe_thread_join(noe_Thread *thread); // returns what fn returned and frees the thread
+int noe_cpu_count(void);
+noe_Mutex *noe_mutex_create(void);
+void noe_mutex_destroy(noe_Mutex *mutex);
+void noe_mutex_lock(noe_Mutex *mutex);
+void noe_mutex_unlock(noe_Mutex *mutex);
+noe_Cond *noe_cond_create(void);
+void noe_cond_destroy(noe_Cond *cond);
+void noe_cond_wait(noe_Cond *cond, noe_Mutex *mutex);
+void noe_cond_signal(noe_Cond *cond);
+void noe_cond_broadcast(noe_Cond *cond);
 
 noe_Rect noe_clip_rect(noe_Rect outer, noe_Rect inner);
 
+// Called by noe_step on its own thread before presenting, when canvas holds
+// the finished frame. Lets extensions run once per frame, a hook may remove
+// itself but no other hook while it runs.
+typedef void (*noe_StepHook)(noe_Context *ctx, noe_Image canvas, void *userdata);
+
 noe_Context *noe_init(const char *name, int w, int h, uint8_t flags);
 void noe_close(noe_Context *ctx);
 void noe_set_should_close(noe_Context *ctx, bool should_close);
 void noe_set_window_title(noe_Context *ctx, const char *title);
 bool noe_step(noe_Context *ctx, double *deltaTime);
+void noe_skip_present(noe_Context *ctx); // the next noe_step keeps the window content as is
+// With 2 or 3 buffers a present thread pushes finished frames to the window
+// while the next one is drawn, 1 presents inside noe_step. The canvas becomes
+// a different buffer after every noe_step, so the whole frame has to be drawn
+// each time. Returns false when the buffers or the thread can't be created, or
+// for headless contexts, which then keep presenting synchronously.
+bool noe_set_present_buffers(noe_Context *ctx, int count);
+int noe_get_present_buffers(noe_Context *ctx);
+void noe_set_target_fps(noe_Context *ctx, double fps); // 0 or less runs unlimited
+double noe_get_target_fps(noe_Context *ctx);
+noe_PacingStats noe_get_pacing_stats(noe_Context *ctx);
+noe_FrameStats noe_get_frame_stats(noe_Context *ctx);
+// While enabled, noe_step renders how often every canvas pixel was drawn into
+// an RGBA image, from black (never) over blue and green up to red (8+ times).
+void noe_set_overdraw_heatmap(noe_Context *ctx, bool enabled);
+noe_Image noe_get_overdraw_heatmap(noe_Context *ctx); // empty image while disabled
+// Every noe_step accumulates its delta time into fixed ticks of dt seconds. At most
+// max_steps ticks are reported per frame, the rest of a slow frame is dropped.
+// dt of 0 disables it.
+void noe_set_fixed_timestep(noe_Context *ctx, double dt, int max_steps);
+int noe_fixed_steps(noe_Context *ctx);    // ticks to simulate this frame
+double noe_fixed_alpha(noe_Context *ctx); // leftover fraction of a tick, for interpolating the render
+bool noe_add_step_hook(noe_Context *ctx, noe_StepHook hook, void *userdata); // false when all slots are taken
+void noe_remove_step_hook(noe_Context *ctx, noe_StepHook hook, void *userdata);
 bool noe_key_pressed(noe_Context *ctx, int key);
 bool noe_key_released(noe_Context *ctx, int key);
 bool noe_key_down(noe_Context *ctx, int key);
@@ -239,6 +371,18 @@ bool noe_button_down(noe_Context *ctx, int button);
 bool noe_button_released(noe_Context *ctx, int button);
 noe_Vec2 noe_cursor_pos(noe_Context *ctx);
 noe_Vec2 noe_cursor_delta(noe_Context *ctx);
+noe_Vec2 noe_wheel_delta(noe_Context *ctx);
+// Every input event received before the last noe_step, in arrival order
+const noe_Event *noe_get_events(noe_Context *ctx, int *count);
+unsigned noe_dropped_events(noe_Context *ctx);
+
+// Recording stores the delta time and input events every noe_step sees. A
+// replay feeds them back without sleeping and closes the context at the end.
+bool noe_record_begin(noe_Context *ctx, const char *filepath);
+void noe_record_end(noe_Context *ctx);
+bool noe_replay_begin(noe_Context *ctx, const char *filepath);
+void noe_replay_end(noe_Context *ctx);
+bool noe_is_replaying(noe_Context *ctx);
 int noe_screen_width(noe_Context *ctx);
 int noe_screen_height(noe_Context *ctx);
 bool noe_screen_resized(noe_Context *ctx);
@@ -250,26 +394,111 @@ float noe_font_measure_text(noe_Font font, const char *text, int fontsize);
 noe_Image noe_load_image(void *data, int width, int height, int format);
 noe_Image noe_create_image(int width, int height, int format);
 void noe_unload_image(noe_Image image);
+// Only between formats with the same channels, which swaps red and blue
+bool noe_image_convert_in_place(noe_Image *image, int format);
 void noe_image_resize(noe_Image *dst, noe_Image src, noe_Rect r, int min, int mag);
 void noe_image_draw_pixel(noe_Image image, noe_Color color, int x, int y);
 noe_Color noe_image_get_pixel(noe_Image image, int x, int y);
+bool noe_image_diff(noe_Image a, noe_Image b, noe_ImageDiff *diff); // false when size or format differ
 void noe_image_draw_rect(noe_Image image, noe_Color c, noe_Rect r);
+void noe_image_draw_triangle(noe_Image image, noe_Color color, noe_Vec2 a, noe_Vec2 b, noe_Vec2 c);
+void noe_image_draw_triangle_colors(noe_Image image, noe_Vec2 a, noe_Vec2 b, noe_Vec2 c, noe_Color ca, noe_Color cb, noe_Color cc);
+void noe_image_draw_polygon(noe_Image image, noe_Color color, const noe_Vec2 *points, int count); // points must form a convex polygon
+void noe_image_draw_mask(noe_Image image, noe_Image mask, noe_Rect src, noe_Rect dst, noe_Color color);
+void noe_image_draw_image_transformed(noe_Image dst, noe_Image image, noe_Rect src, noe_Mat2x3 transform, int filter);
+void noe_image_fill_path(noe_Image image, noe_Color color, const noe_Path *path, int fill_rule);
+void noe_image_stroke_path(noe_Image image, noe_Color color, const noe_Path *path, float width);
+
+noe_Path *noe_create_path(void);
+void noe_destroy_path(noe_Path *path);
+void noe_path_clear(noe_Path *path);
+void noe_path_move_to(noe_Path *path, float x, float y);
+void noe_path_line_to(noe_Path *path, float x, float y);
+void noe_path_quad_to(noe_Path *path, float cx, float cy, float x, float y);
+void noe_path_cubic_to(noe_Path *path, float c1x, float c1y, float c2x, float c2y, float x, float y);
+void noe_path_close(noe_Path *path);
+void noe_path_rounded_rect(noe_Path *path, float x, float y, float w, float h, float r);
+
+// Every noe_draw_* call renders into the image on top of the target stack, or
+// into the window canvas when the stack is empty. The image must stay alive
+// until it is popped. Pushing onto a full stack (16 deep) asserts, and without
+// asserts it is ignored together with its matching pop.
+void noe_push_target(noe_Context *ctx, noe_Image image);
+void noe_pop_target(noe_Context *ctx);
+noe_Image noe_current_target(noe_Context *ctx);
+
+// Clip rects are intersected with the one below them and are local to the
+// current render target. Popping a target also drops its clip rects. Like
+// targets, a push onto a full stack (32 deep) asserts or is ignored.
+void noe_push_clip_rect(noe_Context *ctx, noe_Rect r);
+void noe_pop_clip_rect(noe_Context *ctx);
+noe_Rect noe_get_clip_rect(noe_Context *ctx);
 
 void noe_clear_background(noe_Context *ctx, noe_Color color);
 void noe_draw_rect(noe_Context *ctx, noe_Color color, noe_Rect r);
 void noe_draw_image(noe_Context *ctx, noe_Image image, int x, int y);
 void noe_draw_image2(noe_Context *ctx, noe_Image image, noe_Rect src, noe_Rect dst);
 void noe_draw_image_scaled_to_screen(noe_Context *ctx, noe_Image image);
+void noe_draw_mask(noe_Context *ctx, noe_Image mask, noe_Rect src, noe_Rect dst, noe_Color color);
+void noe_draw_image_transformed(noe_Context *ctx, noe_Image image, noe_Rect src, noe_Mat2x3 transform, int filter);
 void noe_draw_pixel(noe_Context *ctx, noe_Color color, int x, int y);
 void noe_draw_text(noe_Context *ctx, noe_Font font, noe_Color color, const char *text, int x, int y, int fontsize);
+void noe_draw_triangle(noe_Context *ctx, noe_Color color, noe_Vec2 a, noe_Vec2 b, noe_Vec2 c);
+void noe_draw_triangle_colors(noe_Context *ctx, noe_Vec2 a, noe_Vec2 b, noe_Vec2 c, noe_Color ca, noe_Color cb, noe_Color cc);
+void noe_draw_polygon(noe_Context *ctx, noe_Color color, const noe_Vec2 *points, int count);
+void noe_fill_path(noe_Context *ctx, noe_Color color, const noe_Path *path, int fill_rule);
+void noe_stroke_path(noe_Context *ctx, noe_Color color, const noe_Path *path, float width);
 
 noe_Font noe_create_font(noe_Image atlas, int codepoint_count);
 void noe_destroy_font(noe_Font);
 
+// Profiler zones are only recorded when noe is compiled with NOE_PROFILE, the
+// macros expand to nothing otherwise. Zones nest and every thread records into
+// its own ring buffer, so the oldest zones are overwritten once it is full.
+// Names must outlive the profiler, string literals are the intended use.
+#ifdef NOE_PROFILE
+void noe_profile_begin(const char *name);
+void noe_profile_end(void);
+// Writes every recorded zone as a Chrome trace (chrome://tracing, Perfetto).
+// Other threads should not be recording while it runs.
+bool noe_profile_export_chrome_trace(const char *filepath);
+#define NOE_PROFILE_BEGIN(name) noe_profile_begin(name)
+#define NOE_PROFILE_END() noe_profile_end()
+#else
+#define NOE_PROFILE_BEGIN(name) ((void)0)
+#define NOE_PROFILE_END() ((void)0)
+#endif
+
 /////////////////////////////
 ///
 /// Vector operations
 ///
+/// Single vectors are left to the compiler, which keeps them in registers.
+/// The *_soa functions take the components in separate arrays and use SSE2
+/// when noe is built with it. The transforms do the same operations in the
+/// same order either way, so they give the same results bit for bit. Only
+/// noe_rsqrt differs: with SSE it refines the hardware estimate with one
+/// Newton step, which stays within NOE_RSQRT_TOLERANCE relative error of the
+/// 1/sqrtf the fallback returns. Zero, denormals and infinity would turn the
+/// Newton step into NaN, those take 1/sqrtf and match the fallback exactly.
+///
+
+#if !defined(NOE_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define NOE_HAS_SSE_RSQRT
+#include <xmmintrin.h>
+#endif
+
+#define NOE_RSQRT_TOLERANCE 5e-7f
+
+static inline float noe_rsqrt(float x) {
+#ifdef NOE_HAS_SSE_RSQRT
+    if(!(x >= FLT_MIN && x <= FLT_MAX)) return 1.0f/sqrtf(x);
+    float r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+    return r*(1.5f - 0.5f*x*r*r);
+#else
+    return 1.0f/sqrtf(x);
+#endif
+}
 
 static inline noe_Vec2 noe_vec2_add(noe_Vec2 a, noe_Vec2 b) {
     return noe_vec2(a.x + b.x, a.y + b.y);
@@ -279,6 +508,10 @@ static inline noe_Vec2 noe_vec2_sub(noe_Vec2 a, noe_Vec2 b) {
     return noe_vec2(a.x - b.x, a.y - b.y);
 }
 
+static inline noe_Vec2 noe_vec2_scale(noe_Vec2 a, float s) {
+    return noe_vec2(a.x*s, a.y*s);
+}
+
 static inline float noe_vec2_dot(noe_Vec2 a, noe_Vec2 b) {
     return a.x*b.x + a.y*b.y;
 }
@@ -288,7 +521,7 @@ static inline float noe_vec2_distance_sqr(noe_Vec2 a) {
 }
 
 static inline float noe_vec2_distance(noe_Vec2 a) {
-    return sqrt(noe_vec2_distance_sqr(a));
+    return sqrtf(noe_vec2_distance_sqr(a));
 }
 
 static inline noe_Vec2 noe_vec2_normalize(noe_Vec2 a) {
@@ -298,6 +531,253 @@ static inline noe_Vec2 noe_vec2_normalize(noe_Vec2 a) {
     return a;
 }
 
+// Within NOE_RSQRT_TOLERANCE of noe_vec2_normalize
+static inline noe_Vec2 noe_vec2_normalize_fast(noe_Vec2 a) {
+    return noe_vec2_scale(a, noe_rsqrt(noe_vec2_distance_sqr(a)));
+}
+
+static inline noe_Vec3 noe_vec3_add(noe_Vec3 a, noe_Vec3 b) {
+    return noe_vec3(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+static inline noe_Vec3 noe_vec3_sub(noe_Vec3 a, noe_Vec3 b) {
+    return noe_vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static inline noe_Vec3 noe_vec3_scale(noe_Vec3 a, float s) {
+    return noe_vec3(a.x*s, a.y*s, a.z*s);
+}
+
+static inline float noe_vec3_dot(noe_Vec3 a, noe_Vec3 b) {
+    return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+static inline noe_Vec3 noe_vec3_cross(noe_Vec3 a, noe_Vec3 b) {
+    return noe_vec3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+}
+
+static inline float noe_vec3_distance_sqr(noe_Vec3 a) {
+    return noe_vec3_dot(a,a);
+}
+
+static inline float noe_vec3_distance(noe_Vec3 a) {
+    return sqrtf(noe_vec3_distance_sqr(a));
+}
+
+static inline noe_Vec3 noe_vec3_normalize(noe_Vec3 a) {
+    return noe_vec3_scale(a, 1.0f/noe_vec3_distance(a));
+}
+
+static inline noe_Vec3 noe_vec3_normalize_fast(noe_Vec3 a) {
+    return noe_vec3_scale(a, noe_rsqrt(noe_vec3_distance_sqr(a)));
+}
+
+static inline noe_Vec4 noe_vec4_add(noe_Vec4 a, noe_Vec4 b) {
+    return noe_vec4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w);
+}
+
+static inline noe_Vec4 noe_vec4_sub(noe_Vec4 a, noe_Vec4 b) {
+    return noe_vec4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w);
+}
+
+static inline noe_Vec4 noe_vec4_scale(noe_Vec4 a, float s) {
+    return noe_vec4(a.x*s, a.y*s, a.z*s, a.w*s);
+}
+
+static inline float noe_vec4_dot(noe_Vec4 a, noe_Vec4 b) {
+    return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w;
+}
+
+// Normalizes every (xs[i], ys[i]) in place with noe_rsqrt
+void noe_vec2_normalize_soa(float *xs, float *ys, int count);
+
+/////////////////////////////
+///
+/// Affine transforms
+///
+
+static inline noe_Mat2x3 noe_mat2x3_identity(void) {
+    noe_Mat2x3 m = {{ 1, 0, 0, 0, 1, 0 }};
+    return m;
+}
+
+static inline noe_Mat2x3 noe_mat2x3_translate(float x, float y) {
+    noe_Mat2x3 m = {{ 1, 0, x, 0, 1, y }};
+    return m;
+}
+
+static inline noe_Mat2x3 noe_mat2x3_scale(float x, float y) {
+    noe_Mat2x3 m = {{ x, 0, 0, 0, y, 0 }};
+    return m;
+}
+
+static inline noe_Mat2x3 noe_mat2x3_rotate(float radians) {
+    float c = cosf(radians), s = sinf(radians);
+    noe_Mat2x3 m = {{ c, -s, 0, s, c, 0 }};
+    return m;
+}
+
+static inline noe_Mat2x3 noe_mat2x3_shear(float x, float y) {
+    noe_Mat2x3 m = {{ 1, x, 0, y, 1, 0 }};
+    return m;
+}
+
+// Returns the transform that applies `b` first and then `a`
+static inline noe_Mat2x3 noe_mat2x3_multiply(noe_Mat2x3 a, noe_Mat2x3 b) {
+    noe_Mat2x3 m = {{
+        a.es[0]*b.es[0] + a.es[1]*b.es[3], a.es[0]*b.es[1] + a.es[1]*b.es[4], a.es[0]*b.es[2] + a.es[1]*b.es[5] + a.es[2],
+        a.es[3]*b.es[0] + a.es[4]*b.es[3], a.es[3]*b.es[1] + a.es[4]*b.es[4], a.es[3]*b.es[2] + a.es[4]*b.es[5] + a.es[5],
+    }};
+    return m;
+}
+
+static inline bool noe_mat2x3_invert(noe_Mat2x3 m, noe_Mat2x3 *out) {
+    float det = m.es[0]*m.es[4] - m.es[1]*m.es[3];
+    if(det == 0.0f) return false;
+    float id = 1.0f/det;
+    out->es[0] =  m.es[4]*id;
+    out->es[1] = -m.es[1]*id;
+    out->es[3] = -m.es[3]*id;
+    out->es[4] =  m.es[0]*id;
+    out->es[2] = -(out->es[0]*m.es[2] + out->es[1]*m.es[5]);
+    out->es[5] = -(out->es[3]*m.es[2] + out->es[4]*m.es[5]);
+    return true;
+}
+
+static inline noe_Vec2 noe_mat2x3_transform(noe_Mat2x3 m, noe_Vec2 p) {
+    return noe_vec2(m.es[0]*p.x + m.es[1]*p.y + m.es[2], m.es[3]*p.x + m.es[4]*p.y + m.es[5]);
+}
+
+// Transforms every (xs[i], ys[i]), the outputs may be the inputs
+void noe_mat2x3_transform_soa(noe_Mat2x3 m, const float *xs, const float *ys, float *out_xs, float *out_ys, int count);
+
+/////////////////////////////
+///
+/// 4x4 matrices
+///
+/// Row major like noe_Mat2x3 and applied to column vectors, so every row is
+/// one output component and lines up with a SIMD register. The projections
+/// follow OpenGL: a right handed view space and a clip space depth of -1..1.
+///
+
+static inline noe_Mat4 noe_mat4_identity(void) {
+    noe_Mat4 m = {{ {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1} }};
+    return m;
+}
+
+static inline noe_Mat4 noe_mat4_translate(float x, float y, float z) {
+    noe_Mat4 m = {{ {1, 0, 0, x}, {0, 1, 0, y}, {0, 0, 1, z}, {0, 0, 0, 1} }};
+    return m;
+}
+
+static inline noe_Mat4 noe_mat4_scale(float x, float y, float z) {
+    noe_Mat4 m = {{ {x, 0, 0, 0}, {0, y, 0, 0}, {0, 0, z, 0}, {0, 0, 0, 1} }};
+    return m;
+}
+
+// Counter clockwise around `axis` when it points at the viewer
+static inline noe_Mat4 noe_mat4_rotate(noe_Vec3 axis, float radians) {
+    noe_Vec3 a = noe_vec3_normalize(axis);
+    float c = cosf(radians), s = sinf(radians), t = 1.0f - c;
+    noe_Mat4 m = {{
+        { t*a.x*a.x + c,     t*a.x*a.y - s*a.z, t*a.x*a.z + s*a.y, 0 },
+        { t*a.x*a.y + s*a.z, t*a.y*a.y + c,     t*a.y*a.z - s*a.x, 0 },
+        { t*a.x*a.z - s*a.y, t*a.y*a.z + s*a.x, t*a.z*a.z + c,     0 },
+        { 0, 0, 0, 1 },
+    }};
+    return m;
+}
+
+static inline noe_Mat4 noe_mat4_ortho(float left, float right, float bottom, float top, float z_near, float z_far) {
+    noe_Mat4 m = {{
+        { 2.0f/(right - left), 0, 0, -(right + left)/(right - left) },
+        { 0, 2.0f/(top - bottom), 0, -(top + bottom)/(top - bottom) },
+        { 0, 0, -2.0f/(z_far - z_near), -(z_far + z_near)/(z_far - z_near) },
+        { 0, 0, 0, 1 },
+    }};
+    return m;
+}
+
+static inline noe_Mat4 noe_mat4_perspective(float fovy, float aspect, float z_near, float z_far) {
+    float f = 1.0f/tanf(fovy*0.5f);
+    noe_Mat4 m = {{
+        { f/aspect, 0, 0, 0 },
+        { 0, f, 0, 0 },
+        { 0, 0, (z_far + z_near)/(z_near - z_far), 2.0f*z_far*z_near/(z_near - z_far) },
+        { 0, 0, -1, 0 },
+    }};
+    return m;
+}
+
+// Returns the transform that applies `b` first and then `a`
+static inline noe_Mat4 noe_mat4_multiply(noe_Mat4 a, noe_Mat4 b) {
+    noe_Mat4 m;
+    for(int i = 0; i < 4; ++i) {
+        // Every row of the product weights the rows of `b`, four lanes at a time
+        noe_Vec4 r = a.rows[i];
+        m.rows[i] = noe_vec4_add(
+                noe_vec4_add(noe_vec4_scale(b.rows[0], r.x), noe_vec4_scale(b.rows[1], r.y)),
+                noe_vec4_add(noe_vec4_scale(b.rows[2], r.z), noe_vec4_scale(b.rows[3], r.w)));
+    }
+    return m;
+}
+
+static inline noe_Mat4 noe_mat4_transpose(noe_Mat4 m) {
+    noe_Mat4 t;
+    for(int i = 0; i < 4; ++i) {
+        for(int j = 0; j < 4; ++j) t.es[j*4 + i] = m.es[i*4 + j];
+    }
+    return t;
+}
+
+// Cofactors built from the 2x2 determinants of the top and the bottom two rows
+static inline bool noe_mat4_invert(noe_Mat4 m, noe_Mat4 *out) {
+    const float *a = m.es;
+    float s0 = a[0]*a[5] - a[4]*a[1], s1 = a[0]*a[6] - a[4]*a[2], s2 = a[0]*a[7] - a[4]*a[3];
+    float s3 = a[1]*a[6] - a[5]*a[2], s4 = a[1]*a[7] - a[5]*a[3], s5 = a[2]*a[7] - a[6]*a[3];
+    float c0 = a[8]*a[13] - a[12]*a[9], c1 = a[8]*a[14] - a[12]*a[10], c2 = a[8]*a[15] - a[12]*a[11];
+    float c3 = a[9]*a[14] - a[13]*a[10], c4 = a[9]*a[15] - a[13]*a[11], c5 = a[10]*a[15] - a[14]*a[11];
+    float det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+    if(det == 0.0f) return false;
+    float id = 1.0f/det;
+    float *b = out->es;
+    b[0]  = ( a[5]*c5 - a[6]*c4 + a[7]*c3)*id;
+    b[1]  = (-a[1]*c5 + a[2]*c4 - a[3]*c3)*id;
+    b[2]  = ( a[13]*s5 - a[14]*s4 + a[15]*s3)*id;
+    b[3]  = (-a[9]*s5 + a[10]*s4 - a[11]*s3)*id;
+    b[4]  = (-a[4]*c5 + a[6]*c2 - a[7]*c1)*id;
+    b[5]  = ( a[0]*c5 - a[2]*c2 + a[3]*c1)*id;
+    b[6]  = (-a[12]*s5 + a[14]*s2 - a[15]*s1)*id;
+    b[7]  = ( a[8]*s5 - a[10]*s2 + a[11]*s1)*id;
+    b[8]  = ( a[4]*c4 - a[5]*c2 + a[7]*c0)*id;
+    b[9]  = (-a[0]*c4 + a[1]*c2 - a[3]*c0)*id;
+    b[10] = ( a[12]*s4 - a[13]*s2 + a[15]*s0)*id;
+    b[11] = (-a[8]*s4 + a[9]*s2 - a[11]*s0)*id;
+    b[12] = (-a[4]*c3 + a[5]*c1 - a[6]*c0)*id;
+    b[13] = ( a[0]*c3 - a[1]*c1 + a[2]*c0)*id;
+    b[14] = (-a[12]*s3 + a[13]*s1 - a[14]*s0)*id;
+    b[15] = ( a[8]*s3 - a[9]*s1 + a[10]*s0)*id;
+    return true;
+}
+
+static inline noe_Vec4 noe_mat4_transform(noe_Mat4 m, noe_Vec4 v) {
+    return noe_vec4(noe_vec4_dot(m.rows[0], v), noe_vec4_dot(m.rows[1], v),
+            noe_vec4_dot(m.rows[2], v), noe_vec4_dot(m.rows[3], v));
+}
+
+// Takes w as 1 and drops the w of the result, use noe_mat4_transform for projections
+static inline noe_Vec3 noe_mat4_transform_point(noe_Mat4 m, noe_Vec3 p) {
+    return noe_vec3(
+            m.es[0]*p.x + m.es[1]*p.y + m.es[2]*p.z + m.es[3],
+            m.es[4]*p.x + m.es[5]*p.y + m.es[6]*p.z + m.es[7],
+            m.es[8]*p.x + m.es[9]*p.y + m.es[10]*p.z + m.es[11]);
+}
+
+// Transforms every (xs[i], ys[i], zs[i], 1) like noe_mat4_transform_point
+// does, the outputs may be the inputs. out_ws may be NULL when it isn't needed.
+void noe_mat4_transform_soa(const noe_Mat4 *m, const float *xs, const float *ys, const float *zs,
+        float *out_xs, float *out_ys, float *out_zs, float *out_ws, int count);
+
 #endif // NOE
 
 ///////////////////////////////////////////////////
@@ -1,18 +1,1177 @@
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
 #include "noe_ext.h"
 #include "noe.h"
 
+#if !defined(NOE_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define NOE_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+// Copies the pixels of an image into a packed buffer, images with padded rows
+// (like the window canvas) are copied row by row
+static void noe_copy_packed(uint8_t *dst, noe_Image image)
+{
+    size_t row_size = (size_t)image.w * noe_pixelformat_channel_amount(image.format);
+    size_t stride = noe_image_stride(image);
+    if(stride == row_size) {
+        memcpy(dst, image.pixels, row_size * image.h);
+        return;
+    }
+    for(int y = 0; y < image.h; ++y) memcpy(dst + y * row_size, image.pixels + y * stride, row_size);
+}
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Decoded pixels become noe_Image pixels, so stb_image has to allocate the way
+// noe frees. NOE_REALLOC is optional when the allocator is replaced, without
+// it a grow is a copy, which like realloc leaves `p` alone when it fails.
+#ifdef NOE_REALLOC
+#define STBI_REALLOC(p, newsz) NOE_REALLOC(p, newsz)
+#else
+static void *noe_ext_realloc_sized(void *p, size_t oldsz, size_t newsz)
+{
+    void *q = NOE_MALLOC(newsz);
+    if(!q) return NULL;
+    if(p) memcpy(q, p, oldsz < newsz ? oldsz : newsz);
+    NOE_FREE(p);
+    return q;
+}
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) noe_ext_realloc_sized(p, oldsz, newsz)
+#endif
+
+#define STBI_MALLOC(sz) NOE_MALLOC(sz)
+#define STBI_FREE(p) NOE_FREE(p)
+#define STB_IMAGE_IMPLEMENTATION
+#include "vendors/stb_image.h"
+
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "vendors/stb_truetype.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "vendors/stb_image_write.h"
+//////////////////////////////////////////////////////
+///
+/// PNG writer
+///
+/// The rows are split into one band per thread. Every band is filtered and
+/// deflated on its own and ends with a sync flush (an empty stored block), so
+/// the compressed bands can simply be concatenated into one zlib stream. Bands
+/// can't reference each other's data, which costs a little compression at the
+/// band borders. The Adler-32 of the stream is combined from the ones of the
+/// bands.
+///
+/// Deflate uses hash chains for matching (the level sets how far they are
+/// followed) and picks per block whether dynamic or fixed Huffman codes are
+/// smaller. Level 0 stores the data uncompressed.
+///
+
+#define NOE_DEFLATE_WINDOW 32768
+#define NOE_DEFLATE_HASH_BITS 15
+#define NOE_DEFLATE_MIN_MATCH 3
+#define NOE_DEFLATE_MAX_MATCH 258
+#define NOE_DEFLATE_BLOCK_SYMBOLS 16384
+#define NOE_PNG_MIN_BAND_ROWS 32
+#define NOE_PNG_MAX_THREADS 64
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint64_t bits;
+    int bits_count;
+    bool failed;
+} noe_BitWriter;
+
+typedef struct {
+    uint16_t litlen; // literal byte, or match length when dist != 0
+    uint16_t dist;
+} noe_DeflateSymbol;
+
+typedef struct {
+    const noe_Image *image;
+    int level;
+    int y0, y1;
+    noe_BitWriter out;
+    uint32_t adler;
+    size_t filtered_size;
+    bool last;
+} noe_PngBand;
+
+static const uint16_t g_length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t g_length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const uint16_t g_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+static const uint8_t g_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+static const uint8_t g_codelength_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15,
+};
+static const int g_chain_lengths[10] = { 0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096 };
+
+static bool noe_bits_reserve(noe_BitWriter *w, size_t extra)
+{
+    if(w->failed) return false;
+    if(w->size + extra <= w->capacity) return true;
+    size_t capacity = NOE_MAX(w->capacity * 2, w->size + extra + 4096);
+    uint8_t *data = NOE_MALLOC(capacity);
+    if(!data) {
+        w->failed = true;
+        return false;
+    }
+    if(w->data) memcpy(data, w->data, w->size);
+    NOE_FREE(w->data);
+    w->data = data;
+    w->capacity = capacity;
+    return true;
+}
+
+static void noe_bits_put(noe_BitWriter *w, uint32_t value, int count)
+{
+    // Nothing gets flushed after a failed grow, the shift would outgrow the 64 bits
+    if(w->failed) return;
+    w->bits |= (uint64_t)value << w->bits_count;
+    w->bits_count += count;
+    if(w->bits_count < 32) return;
+    if(!noe_bits_reserve(w, 4)) return;
+    for(int i = 0; i < 4; ++i) w->data[w->size++] = (uint8_t)(w->bits >> (i*8));
+    w->bits >>= 32;
+    w->bits_count -= 32;
+}
+
+static void noe_bits_align(noe_BitWriter *w)
+{
+    if(!noe_bits_reserve(w, 8)) return;
+    while(w->bits_count > 0) {
+        w->data[w->size++] = (uint8_t)w->bits;
+        w->bits >>= 8;
+        w->bits_count -= NOE_MIN(w->bits_count, 8);
+    }
+    w->bits = 0;
+}
+
+static uint32_t noe_reverse_bits(uint32_t code, int count)
+{
+    uint32_t result = 0;
+    for(int i = 0; i < count; ++i, code >>= 1) result = (result << 1) | (code & 1);
+    return result;
+}
+
+// Moffat and Katajainen's in-place minimum redundancy code lengths: a holds the
+// weights sorted ascending and receives the code lengths of the same order
+static void noe_minimum_redundancy(int *a, int n)
+{
+    if(n == 0) return;
+    if(n == 1) {
+        a[0] = 1;
+        return;
+    }
+    a[0] += a[1];
+    int root = 0, leaf = 2, next;
+    for(next = 1; next < n - 1; ++next) {
+        if(leaf >= n || a[root] < a[leaf]) {
+            a[next] = a[root];
+            a[root++] = next;
+        } else {
+            a[next] = a[leaf++];
+        }
+        if(leaf >= n || (root < next && a[root] < a[leaf])) {
+            a[next] += a[root];
+            a[root++] = next;
+        } else {
+            a[next] += a[leaf++];
+        }
+    }
+    a[n - 2] = 0;
+    for(next = n - 3; next >= 0; --next) a[next] = a[a[next]] + 1;
+    int avbl = 1, used = 0, depth = 0;
+    root = n - 2;
+    next = n - 1;
+    while(avbl > 0) {
+        while(root >= 0 && a[root] == depth) {
+            used += 1;
+            root -= 1;
+        }
+        while(avbl > used) {
+            a[next--] = depth;
+            avbl -= 1;
+        }
+        avbl = 2 * used;
+        depth += 1;
+        used = 0;
+    }
+}
+
+// Huffman code lengths no longer than limit for freqs[0..n), unused symbols get 0
+static void noe_huffman_lengths(const uint32_t *freqs, int n, int limit, uint8_t *lengths)
+{
+    int symbols[288], weights[288];
+    int count = 0;
+    for(int i = 0; i < n; ++i) {
+        lengths[i] = 0;
+        if(freqs[i] == 0) continue;
+        // Insertion sort by frequency, at most 288 symbols
+        int j = count++;
+        while(j > 0 && freqs[symbols[j - 1]] > freqs[i]) {
+            symbols[j] = symbols[j - 1];
+            j -= 1;
+        }
+        symbols[j] = i;
+    }
+    if(count == 0) return;
+    for(int i = 0; i < count; ++i) weights[i] = (int)NOE_MIN(freqs[symbols[i]], 1u << 30 >> 9);
+    noe_minimum_redundancy(weights, count);
+
+    // Pull over-long codes back into the limit while keeping the code complete (JPEG Annex K.3)
+    int bl_count[290] = {0};
+    int max_len = 0;
+    for(int i = 0; i < count; ++i) {
+        bl_count[weights[i]] += 1;
+        max_len = NOE_MAX(max_len, weights[i]);
+    }
+    for(int i = max_len; i > limit; --i) {
+        while(bl_count[i] > 0) {
+            int j = i - 2;
+            while(bl_count[j] == 0) j -= 1;
+            bl_count[i] -= 2;
+            bl_count[i - 1] += 1;
+            bl_count[j + 1] += 2;
+            bl_count[j] -= 1;
+        }
+    }
+    // The rarest symbols get the longest codes
+    int k = 0;
+    for(int len = NOE_MIN(max_len, limit); len > 0; --len) {
+        for(int c = 0; c < bl_count[len]; ++c) lengths[symbols[k++]] = (uint8_t)len;
+    }
+}
+
+static void noe_huffman_codes(const uint8_t *lengths, int n, uint16_t *codes)
+{
+    int bl_count[16] = {0}, next_code[16] = {0};
+    for(int i = 0; i < n; ++i) bl_count[lengths[i]] += 1;
+    bl_count[0] = 0;
+    int code = 0;
+    for(int bits = 1; bits < 16; ++bits) {
+        code = (code + bl_count[bits - 1]) << 1;
+        next_code[bits] = code;
+    }
+    for(int i = 0; i < n; ++i) {
+        codes[i] = lengths[i] ? (uint16_t)noe_reverse_bits(next_code[lengths[i]]++, lengths[i]) : 0;
+    }
+}
+
+static int noe_length_code(int len)
+{
+    int code = 28;
+    while(g_length_base[code] > len) code -= 1;
+    return code;
+}
+
+static int noe_dist_code(int dist)
+{
+    int code = 29;
+    while(g_dist_base[code] > dist) code -= 1;
+    return code;
+}
+
+static void noe_deflate_symbols(noe_BitWriter *w, const noe_DeflateSymbol *syms, int count,
+        const uint16_t *lcodes, const uint8_t *llens, const uint16_t *dcodes, const uint8_t *dlens)
+{
+    for(int i = 0; i < count; ++i) {
+        if(syms[i].dist == 0) {
+            noe_bits_put(w, lcodes[syms[i].litlen], llens[syms[i].litlen]);
+            continue;
+        }
+        int lc = noe_length_code(syms[i].litlen), dc = noe_dist_code(syms[i].dist);
+        noe_bits_put(w, lcodes[257 + lc], llens[257 + lc]);
+        noe_bits_put(w, syms[i].litlen - g_length_base[lc], g_length_extra[lc]);
+        noe_bits_put(w, dcodes[dc], dlens[dc]);
+        noe_bits_put(w, syms[i].dist - g_dist_base[dc], g_dist_extra[dc]);
+    }
+    noe_bits_put(w, lcodes[256], llens[256]);
+}
+
+// Run length encodes code lengths into the code length alphabet (16, 17 and 18 repeat)
+static int noe_rle_lengths(const uint8_t *lengths, int n, uint8_t *out_syms, uint8_t *out_extra)
+{
+    int count = 0;
+    for(int i = 0; i < n;) {
+        int run = 1;
+        while(i + run < n && lengths[i + run] == lengths[i]) run += 1;
+        if(lengths[i] == 0 && run >= 3) {
+            int r = NOE_MIN(run, 138);
+            out_syms[count] = r >= 11 ? 18 : 17;
+            out_extra[count++] = (uint8_t)(r >= 11 ? r - 11 : r - 3);
+            i += r;
+        } else if(lengths[i] != 0 && run >= 4) {
+            out_syms[count] = lengths[i];
+            out_extra[count++] = 0;
+            int r = NOE_MIN(run - 1, 6);
+            out_syms[count] = 16;
+            out_extra[count++] = (uint8_t)(r - 3);
+            i += 1 + r;
+        } else {
+            out_syms[count] = lengths[i];
+            out_extra[count++] = 0;
+            i += 1;
+        }
+    }
+    return count;
+}
+
+static void noe_deflate_block(noe_BitWriter *w, const noe_DeflateSymbol *syms, int count, bool final)
+{
+    uint32_t lfreqs[286] = {0}, dfreqs[30] = {0};
+    for(int i = 0; i < count; ++i) {
+        if(syms[i].dist == 0) {
+            lfreqs[syms[i].litlen] += 1;
+        } else {
+            lfreqs[257 + noe_length_code(syms[i].litlen)] += 1;
+            dfreqs[noe_dist_code(syms[i].dist)] += 1;
+        }
+    }
+    lfreqs[256] = 1;
+
+    uint8_t llens[286], dlens[30];
+    noe_huffman_lengths(lfreqs, 286, 15, llens);
+    noe_huffman_lengths(dfreqs, 30, 15, dlens);
+    // Decoders want at least one distance code
+    bool has_dist = false;
+    for(int i = 0; i < 30; ++i) has_dist |= dlens[i] != 0;
+    if(!has_dist) dlens[0] = 1;
+
+    int hlit = 286, hdist = 30;
+    while(hlit > 257 && llens[hlit - 1] == 0) hlit -= 1;
+    while(hdist > 1 && dlens[hdist - 1] == 0) hdist -= 1;
+    uint8_t all[316], rle_syms[316], rle_extra[316];
+    memcpy(all, llens, hlit);
+    memcpy(all + hlit, dlens, hdist);
+    int rle_count = noe_rle_lengths(all, hlit + hdist, rle_syms, rle_extra);
+
+    uint32_t cfreqs[19] = {0};
+    for(int i = 0; i < rle_count; ++i) cfreqs[rle_syms[i]] += 1;
+    uint8_t clens[19];
+    uint16_t ccodes[19];
+    noe_huffman_lengths(cfreqs, 19, 7, clens);
+    noe_huffman_codes(clens, 19, ccodes);
+    int hclen = 19;
+    while(hclen > 4 && clens[g_codelength_order[hclen - 1]] == 0) hclen -= 1;
+
+    // Compare the cost in bits of both code kinds, the extra bits are the same for both
+    uint64_t dynamic_bits = 14 + 3*hclen, fixed_bits = 0;
+    static const uint8_t extra_of_rle[19] = { [16] = 2, [17] = 3, [18] = 7 };
+    for(int i = 0; i < rle_count; ++i) dynamic_bits += clens[rle_syms[i]] + extra_of_rle[rle_syms[i]];
+    for(int i = 0; i < 286; ++i) {
+        int fixed_len = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        dynamic_bits += (uint64_t)lfreqs[i] * llens[i];
+        fixed_bits += (uint64_t)lfreqs[i] * fixed_len;
+    }
+    for(int i = 0; i < 30; ++i) {
+        dynamic_bits += (uint64_t)dfreqs[i] * dlens[i];
+        fixed_bits += (uint64_t)dfreqs[i] * 5;
+    }
+
+    uint16_t lcodes[288], dcodes[30];
+    if(fixed_bits <= dynamic_bits) {
+        uint8_t fixed_llens[288], fixed_dlens[30];
+        for(int i = 0; i < 288; ++i) fixed_llens[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        for(int i = 0; i < 30; ++i) fixed_dlens[i] = 5;
+        noe_huffman_codes(fixed_llens, 288, lcodes);
+        noe_huffman_codes(fixed_dlens, 30, dcodes);
+        noe_bits_put(w, final ? 1 : 0, 1);
+        noe_bits_put(w, 1, 2);
+        noe_deflate_symbols(w, syms, count, lcodes, fixed_llens, dcodes, fixed_dlens);
+        return;
+    }
+
+    noe_huffman_codes(llens, 286, lcodes);
+    noe_huffman_codes(dlens, 30, dcodes);
+    noe_bits_put(w, final ? 1 : 0, 1);
+    noe_bits_put(w, 2, 2);
+    noe_bits_put(w, hlit - 257, 5);
+    noe_bits_put(w, hdist - 1, 5);
+    noe_bits_put(w, hclen - 4, 4);
+    for(int i = 0; i < hclen; ++i) noe_bits_put(w, clens[g_codelength_order[i]], 3);
+    for(int i = 0; i < rle_count; ++i) {
+        noe_bits_put(w, ccodes[rle_syms[i]], clens[rle_syms[i]]);
+        noe_bits_put(w, rle_extra[i], extra_of_rle[rle_syms[i]]);
+    }
+    noe_deflate_symbols(w, syms, count, lcodes, llens, dcodes, dlens);
+}
+
+static void noe_deflate_stored(noe_BitWriter *w, const uint8_t *data, size_t size, bool final)
+{
+    do {
+        size_t len = NOE_MIN(size, 65535);
+        noe_bits_put(w, final && len == size ? 1 : 0, 1);
+        noe_bits_put(w, 0, 2);
+        noe_bits_align(w);
+        if(!noe_bits_reserve(w, len + 4)) return;
+        w->data[w->size++] = (uint8_t)(len & 0xFF);
+        w->data[w->size++] = (uint8_t)(len >> 8);
+        w->data[w->size++] = (uint8_t)(~len & 0xFF);
+        w->data[w->size++] = (uint8_t)((~len >> 8) & 0xFF);
+        if(len) memcpy(w->data + w->size, data, len);
+        w->size += len;
+        data += len;
+        size -= len;
+    } while(size > 0);
+}
+
+// Raw deflate of data. Unless final, it ends with a sync flush so more can follow.
+static void noe_deflate(noe_BitWriter *w, const uint8_t *data, size_t size, int level, bool final)
+{
+    if(level <= 0) {
+        noe_deflate_stored(w, data, size, final);
+        if(!final) noe_deflate_stored(w, NULL, 0, false);
+        return;
+    }
+
+    int *head = NOE_MALLOC(sizeof(int) << NOE_DEFLATE_HASH_BITS);
+    int *prev = NOE_MALLOC(sizeof(int) * NOE_DEFLATE_WINDOW);
+    noe_DeflateSymbol *syms = NOE_MALLOC(sizeof(*syms) * NOE_DEFLATE_BLOCK_SYMBOLS);
+    if(!head || !prev || !syms) {
+        NOE_FREE(head);
+        NOE_FREE(prev);
+        NOE_FREE(syms);
+        w->failed = true;
+        return;
+    }
+    for(int i = 0; i < (1 << NOE_DEFLATE_HASH_BITS); ++i) head[i] = -1;
+
+    const int max_chain = g_chain_lengths[NOE_MIN(level, 9)];
+    const int nice_len = level >= 8 ? NOE_DEFLATE_MAX_MATCH : 16 << (level / 2);
+    int count = 0;
+    size_t i = 0;
+    while(i < size) {
+        int best_len = 0, best_dist = 0;
+        if(i + NOE_DEFLATE_MIN_MATCH <= size) {
+            uint32_t h = ((data[i] << 16) | (data[i+1] << 8) | data[i+2]) * 2654435761u >> (32 - NOE_DEFLATE_HASH_BITS);
+            int limit = (int)NOE_MIN(size - i, NOE_DEFLATE_MAX_MATCH);
+            int candidate = head[h];
+            for(int chain = max_chain; candidate >= 0 && chain > 0 && best_len < limit; --chain) {
+                if(i - candidate > NOE_DEFLATE_WINDOW - 1) break;
+                const uint8_t *a = data + candidate, *b = data + i;
+                if(a[best_len] == b[best_len]) {
+                    int len = 0;
+                    while(len < limit && a[len] == b[len]) len += 1;
+                    if(len > best_len) {
+                        best_len = len;
+                        best_dist = (int)(i - candidate);
+                        if(len >= nice_len) break;
+                    }
+                }
+                int next = prev[candidate % NOE_DEFLATE_WINDOW];
+                if(next >= candidate) break;
+                candidate = next;
+            }
+            prev[i % NOE_DEFLATE_WINDOW] = head[h];
+            head[h] = (int)i;
+        }
+
+        if(best_len >= NOE_DEFLATE_MIN_MATCH) {
+            syms[count].litlen = (uint16_t)best_len;
+            syms[count].dist = (uint16_t)best_dist;
+            // Insert the skipped positions so later matches can find them
+            for(size_t j = i + 1; j < i + best_len && j + NOE_DEFLATE_MIN_MATCH <= size; ++j) {
+                uint32_t h = ((data[j] << 16) | (data[j+1] << 8) | data[j+2]) * 2654435761u >> (32 - NOE_DEFLATE_HASH_BITS);
+                prev[j % NOE_DEFLATE_WINDOW] = head[h];
+                head[h] = (int)j;
+            }
+            i += best_len;
+        } else {
+            syms[count].litlen = data[i];
+            syms[count].dist = 0;
+            i += 1;
+        }
+        count += 1;
+        if(count == NOE_DEFLATE_BLOCK_SYMBOLS) {
+            noe_deflate_block(w, syms, count, final && i == size);
+            count = 0;
+        }
+    }
+    if(count > 0 || size == 0) noe_deflate_block(w, syms, count, final);
+    if(!final) noe_deflate_stored(w, NULL, 0, false);
+
+    NOE_FREE(head);
+    NOE_FREE(prev);
+    NOE_FREE(syms);
+}
+
+static uint32_t noe_adler32(uint32_t adler, const uint8_t *data, size_t size)
+{
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while(size > 0) {
+        size_t n = NOE_MIN(size, 5552);
+        for(size_t i = 0; i < n; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += n;
+        size -= n;
+    }
+    return (b << 16) | a;
+}
+
+// Adler-32 of two concatenated buffers out of the ones of each (same as zlib's adler32_combine)
+static uint32_t noe_adler32_combine(uint32_t adler1, uint32_t adler2, size_t len2)
+{
+    const uint32_t base = 65521;
+    uint32_t rem = (uint32_t)(len2 % base);
+    uint32_t sum1 = adler1 & 0xFFFF;
+    uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % base);
+    sum1 += (adler2 & 0xFFFF) + base - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+    if(sum1 >= base) sum1 -= base;
+    if(sum1 >= base) sum1 -= base;
+    if(sum2 >= 2*base) sum2 -= 2*base;
+    if(sum2 >= base) sum2 -= base;
+    return sum1 | (sum2 << 16);
+}
+
+// The table for the reflected polynomial 0xEDB88320, constant so that saves
+// running on several threads never race to fill it
+static const uint32_t g_crc32_table[256] = {
+    0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
+    0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
+    0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+    0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
+    0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172, 0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
+    0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+    0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
+    0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924, 0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
+    0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+    0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
+    0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E, 0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
+    0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+    0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
+    0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0, 0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
+    0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+    0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
+    0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A, 0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
+    0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+    0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
+    0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC, 0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
+    0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+    0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
+    0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236, 0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
+    0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+    0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
+    0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38, 0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
+    0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+    0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
+    0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2, 0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
+    0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+    0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
+    0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D,
+};
+
+static uint32_t noe_crc32(uint32_t crc, const uint8_t *data, size_t size)
+{
+    crc = ~crc;
+    for(size_t i = 0; i < size; ++i) crc = g_crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint8_t noe_paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if(pa <= pb && pa <= pc) return (uint8_t)a;
+    return (uint8_t)(pb <= pc ? b : c);
+}
+
+// Copies a row in the channel order PNG wants
+static void noe_png_row(const noe_Image *image, int y, uint8_t *out)
+{
+    int chans = noe_pixelformat_channel_amount(image->format);
+    const uint8_t *in = image->pixels + (size_t)y * noe_image_stride(*image);
+    memcpy(out, in, (size_t)image->w * chans);
+    if(image->format == NOE_PIXELFORMAT_B8G8R8A8 || image->format == NOE_PIXELFORMAT_B8G8R8) {
+        for(int x = 0; x < image->w; ++x) NOE_SWAP(uint8_t, out[x*chans + 0], out[x*chans + 2]);
+    }
+}
+
+// Writes filter type and filtered row into out, picking the filter with the
+// smallest sum of absolute values (the heuristic libpng uses) above level 1
+static void noe_png_filter_row(const uint8_t *row, const uint8_t *above, size_t len, int bpp, int level, uint8_t *out, uint8_t *scratch)
+{
+    int best_filter = level <= 1 ? (above ? 2 : 1) : -1;
+    uint64_t best_sum = UINT64_MAX;
+    for(int filter = 0; filter < 5; ++filter) {
+        if(best_filter >= 0 && filter != best_filter) continue;
+        uint64_t sum = 0;
+        for(size_t i = 0; i < len; ++i) {
+            int a = i >= (size_t)bpp ? row[i - bpp] : 0;
+            int b = above ? above[i] : 0;
+            int c = above && i >= (size_t)bpp ? above[i - bpp] : 0;
+            uint8_t v = row[i];
+            switch(filter) {
+                case 1: v -= a; break;
+                case 2: v -= b; break;
+                case 3: v -= (a + b) / 2; break;
+                case 4: v -= noe_paeth(a, b, c); break;
+            }
+            scratch[i] = v;
+            sum += v < 128 ? v : 256 - v;
+        }
+        if(sum < best_sum || best_filter == filter) {
+            best_sum = sum;
+            out[0] = (uint8_t)filter;
+            memcpy(out + 1, scratch, len);
+            if(best_filter == filter) break;
+        }
+    }
+}
+
+static int noe_png_encode_band(void *arg)
+{
+    noe_PngBand *band = arg;
+    const noe_Image *image = band->image;
+    int chans = noe_pixelformat_channel_amount(image->format);
+    size_t row_size = (size_t)image->w * chans;
+    size_t filtered_size = (row_size + 1) * (band->y1 - band->y0);
+    uint8_t *filtered = NOE_MALLOC(filtered_size ? filtered_size : 1);
+    uint8_t *rows = NOE_MALLOC(row_size * 3 + 1);
+    if(!filtered || !rows) {
+        NOE_FREE(filtered);
+        NOE_FREE(rows);
+        band->out.failed = true;
+        return 1;
+    }
+
+    uint8_t *above = rows, *row = rows + row_size, *scratch = rows + row_size * 2;
+    if(band->y0 > 0) noe_png_row(image, band->y0 - 1, above);
+    for(int y = band->y0; y < band->y1; ++y) {
+        noe_png_row(image, y, row);
+        noe_png_filter_row(row, y > 0 ? above : NULL, row_size, chans, band->level,
+                filtered + (row_size + 1) * (y - band->y0), scratch);
+        NOE_SWAP(uint8_t *, above, row);
+    }
+
+    band->filtered_size = filtered_size;
+    band->adler = noe_adler32(1, filtered, filtered_size);
+    noe_deflate(&band->out, filtered, filtered_size, band->level, band->last);
+    noe_bits_align(&band->out);
+    NOE_FREE(filtered);
+    NOE_FREE(rows);
+    return band->out.failed ? 1 : 0;
+}
+
+static bool noe_png_write_chunk(FILE *f, const char *type, const uint8_t *data, size_t size)
+{
+    uint8_t header[8] = {
+        (uint8_t)(size >> 24), (uint8_t)(size >> 16), (uint8_t)(size >> 8), (uint8_t)size,
+        (uint8_t)type[0], (uint8_t)type[1], (uint8_t)type[2], (uint8_t)type[3],
+    };
+    uint32_t crc = noe_crc32(0, header + 4, 4);
+    if(size) crc = noe_crc32(crc, data, size);
+    uint8_t trailer[4] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc };
+    return fwrite(header, 8, 1, f) == 1
+        && (size == 0 || fwrite(data, size, 1, f) == 1)
+        && fwrite(trailer, 4, 1, f) == 1;
+}
+
+const char *noe_png_error_string(int error)
+{
+    switch(error) {
+        case NOE_PNG_OK:           return "no error";
+        case NOE_PNG_ERROR_FORMAT: return "the image has no pixels or an unknown pixel format";
+        case NOE_PNG_ERROR_MEMORY: return "out of memory";
+        case NOE_PNG_ERROR_IO:     return "failed to write the file";
+    }
+    return "unknown error";
+}
+
+int noe_image_write_png(noe_Image image, const char *filepath, int level, int threads)
+{
+    static const uint8_t color_types[_COUNT_NOE_PIXELFORMATS] = { 6, 2, 6, 2, 0 };
+    int chans = noe_pixelformat_channel_amount(image.format);
+    if(chans < 0 || !image.pixels || image.w <= 0 || image.h <= 0) return NOE_PNG_ERROR_FORMAT;
+    level = NOE_CLAMP(level, 0, 9);
+    if(threads <= 0) threads = noe_cpu_count();
+    threads = NOE_CLAMP(threads, 1, NOE_PNG_MAX_THREADS);
+    // Small bands would cost more in lost matches and thread startup than they gain
+    int bands_count = NOE_CLAMP(image.h / NOE_PNG_MIN_BAND_ROWS, 1, threads);
+
+    noe_PngBand bands[NOE_PNG_MAX_THREADS];
+    noe_Thread *workers[NOE_PNG_MAX_THREADS] = {0};
+    memset(bands, 0, sizeof(bands));
+    for(int i = 0; i < bands_count; ++i) {
+        bands[i].image = &image;
+        bands[i].level = level;
+        bands[i].y0 = (int)((int64_t)image.h * i / bands_count);
+        bands[i].y1 = (int)((int64_t)image.h * (i + 1) / bands_count);
+        bands[i].last = i == bands_count - 1;
+        // The calling thread encodes the first band itself
+        if(i > 0) workers[i] = noe_thread_create(noe_png_encode_band, &bands[i]);
+    }
+    int result = NOE_PNG_OK;
+    for(int i = 0; i < bands_count; ++i) {
+        if(i == 0 || !workers[i]) {
+            if(noe_png_encode_band(&bands[i]) != 0) result = NOE_PNG_ERROR_MEMORY;
+        }
+    }
+    for(int i = 1; i < bands_count; ++i) {
+        if(workers[i] && noe_thread_join(workers[i]) != 0) result = NOE_PNG_ERROR_MEMORY;
+    }
+
+    FILE *f = NULL;
+    if(result == NOE_PNG_OK) {
+        f = fopen(filepath, "wb");
+        if(!f) result = NOE_PNG_ERROR_IO;
+    }
+    if(result == NOE_PNG_OK) {
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        uint8_t ihdr[13] = {
+            (uint8_t)(image.w >> 24), (uint8_t)(image.w >> 16), (uint8_t)(image.w >> 8), (uint8_t)image.w,
+            (uint8_t)(image.h >> 24), (uint8_t)(image.h >> 16), (uint8_t)(image.h >> 8), (uint8_t)image.h,
+            8, color_types[image.format], 0, 0, 0,
+        };
+        // CMF/FLG for a 32K window, FLG makes the pair a multiple of 31
+        static const uint8_t zlib_header[2] = { 0x78, 0x9C };
+        bool ok = fwrite(signature, 8, 1, f) == 1
+            && noe_png_write_chunk(f, "IHDR", ihdr, sizeof(ihdr))
+            && noe_png_write_chunk(f, "IDAT", zlib_header, sizeof(zlib_header));
+
+        uint32_t adler = 1;
+        for(int i = 0; ok && i < bands_count; ++i) {
+            ok = noe_png_write_chunk(f, "IDAT", bands[i].out.data, bands[i].out.size);
+            adler = noe_adler32_combine(adler, bands[i].adler, bands[i].filtered_size);
+        }
+        uint8_t trailer[4] = { (uint8_t)(adler >> 24), (uint8_t)(adler >> 16), (uint8_t)(adler >> 8), (uint8_t)adler };
+        ok = ok && noe_png_write_chunk(f, "IDAT", trailer, sizeof(trailer));
+        ok = ok && noe_png_write_chunk(f, "IEND", NULL, 0);
+        if(fclose(f) != 0) ok = false;
+        if(!ok) result = NOE_PNG_ERROR_IO;
+    }
+
+    for(int i = 0; i < bands_count; ++i) NOE_FREE(bands[i].out.data);
+    return result;
+}
 
 bool noe_image_save_to_pngfile(noe_Image image, const char *filepath)
 {
-    int comp = noe_pixelformat_channel_amount(image.format);
-    if(comp < 0) return false;
-    stbi_write_png(filepath, image.w, image.h, comp, image.pixels, image.w * comp);
+    return noe_image_write_png(image, filepath, NOE_PNG_DEFAULT_LEVEL, 0) == NOE_PNG_OK;
+}
+
+//////////////////////////////////////////////////////
+///
+/// QOI codec
+///
+/// "The Quite OK Image Format" (qoiformat.org). Pixels are read and written in
+/// their own noe_pixelformat and swizzled on the fly. The encoder only keeps a
+/// small staging buffer that is flushed through the write callback, so the
+/// compressed image never exists as a whole unless the caller wants it to.
+///
+
+#define NOE_QOI_OP_INDEX 0x00
+#define NOE_QOI_OP_DIFF  0x40
+#define NOE_QOI_OP_LUMA  0x80
+#define NOE_QOI_OP_RUN   0xC0
+#define NOE_QOI_OP_RGB   0xFE
+#define NOE_QOI_OP_RGBA  0xFF
+#define NOE_QOI_MASK     0xC0
+#define NOE_QOI_HEADER_SIZE 14
+#define NOE_QOI_STAGING_SIZE (64*1024)
+
+static const uint8_t g_qoi_padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+typedef union {
+    struct { uint8_t r, g, b, a; } c;
+    uint32_t v;
+} noe_QoiPixel;
+
+#define NOE_QOI_HASH(p) (((p).c.r*3 + (p).c.g*5 + (p).c.b*7 + (p).c.a*11) % 64)
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    size_t written;
+} noe_QoiMemory;
+
+static inline noe_QoiPixel noe_qoi_read_pixel(const uint8_t *p, int format)
+{
+    noe_QoiPixel px;
+    switch(format) {
+        case NOE_PIXELFORMAT_R8G8B8A8: px.c.r = p[0]; px.c.g = p[1]; px.c.b = p[2]; px.c.a = p[3]; break;
+        case NOE_PIXELFORMAT_R8G8B8:   px.c.r = p[0]; px.c.g = p[1]; px.c.b = p[2]; px.c.a = 255;  break;
+        case NOE_PIXELFORMAT_B8G8R8A8: px.c.r = p[2]; px.c.g = p[1]; px.c.b = p[0]; px.c.a = p[3]; break;
+        case NOE_PIXELFORMAT_B8G8R8:   px.c.r = p[2]; px.c.g = p[1]; px.c.b = p[0]; px.c.a = 255;  break;
+        default:                       px.c.r = px.c.g = px.c.b = p[0]; px.c.a = 255;          break;
+    }
+    return px;
+}
+
+static inline void noe_qoi_write_pixel(uint8_t *p, int format, noe_QoiPixel px)
+{
+    switch(format) {
+        case NOE_PIXELFORMAT_R8G8B8A8: p[0] = px.c.r; p[1] = px.c.g; p[2] = px.c.b; p[3] = px.c.a; break;
+        case NOE_PIXELFORMAT_R8G8B8:   p[0] = px.c.r; p[1] = px.c.g; p[2] = px.c.b;                break;
+        case NOE_PIXELFORMAT_B8G8R8A8: p[0] = px.c.b; p[1] = px.c.g; p[2] = px.c.r; p[3] = px.c.a; break;
+        case NOE_PIXELFORMAT_B8G8R8:   p[0] = px.c.b; p[1] = px.c.g; p[2] = px.c.r;                break;
+        // Same weights as stb_image so both decoders agree, and gray written as RGB comes back exact
+        default: p[0] = (uint8_t)((px.c.r*77 + px.c.g*150 + px.c.b*29) >> 8); break;
+    }
+}
+
+static void noe_qoi_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t noe_qoi_get32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+size_t noe_qoi_max_size(noe_Image image)
+{
+    bool alpha = noe_pixelformat_channel_amount(image.format) == 4;
+    return (size_t)image.w * image.h * (alpha ? 5 : 4) + NOE_QOI_HEADER_SIZE + sizeof(g_qoi_padding);
+}
+
+bool noe_image_write_qoi(noe_Image image, noe_WriteFunc write, void *userdata)
+{
+    int chans = noe_pixelformat_channel_amount(image.format);
+    if(chans < 0 || !image.pixels || image.w <= 0 || image.h <= 0) return false;
+    uint8_t *staging = NOE_MALLOC(NOE_QOI_STAGING_SIZE);
+    if(!staging) return false;
+
+    uint8_t *out = staging;
+    noe_qoi_put32(out, 0x716F6966); // "qoif"
+    noe_qoi_put32(out + 4, (uint32_t)image.w);
+    noe_qoi_put32(out + 8, (uint32_t)image.h);
+    out[12] = chans == 4 ? 4 : 3;
+    out[13] = 0; // sRGB with linear alpha
+    out += NOE_QOI_HEADER_SIZE;
+
+    noe_QoiPixel index[64] = {0};
+    noe_QoiPixel prev = { .c = { 0, 0, 0, 255 } };
+    int run = 0;
+    bool ok = true;
+    const size_t count = (size_t)image.w * image.h;
+    const size_t row_padding = noe_image_stride(image) - (size_t)image.w * chans;
+    const uint8_t *in = image.pixels;
+    const int format = image.format;
+    for(size_t i = 0, x = 0; i < count && ok; ++i, in += chans) {
+        if(x++ == (size_t)image.w) {
+            in += row_padding;
+            x = 1;
+        }
+        // The longest op is 5 bytes
+        if(out - staging > NOE_QOI_STAGING_SIZE - 8) {
+            ok = write(userdata, staging, out - staging);
+            out = staging;
+        }
+        noe_QoiPixel px = noe_qoi_read_pixel(in, format);
+        if(px.v == prev.v) {
+            run += 1;
+            if(run == 62 || i == count - 1) {
+                *out++ = (uint8_t)(NOE_QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if(run > 0) {
+            *out++ = (uint8_t)(NOE_QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+        int hash = NOE_QOI_HASH(px);
+        if(index[hash].v == px.v) {
+            *out++ = (uint8_t)(NOE_QOI_OP_INDEX | hash);
+        } else if(px.c.a == prev.c.a) {
+            index[hash] = px;
+            int8_t dr = (int8_t)(px.c.r - prev.c.r);
+            int8_t dg = (int8_t)(px.c.g - prev.c.g);
+            int8_t db = (int8_t)(px.c.b - prev.c.b);
+            int8_t dr_dg = (int8_t)(dr - dg), db_dg = (int8_t)(db - dg);
+            if(dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+                *out++ = (uint8_t)(NOE_QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+            } else if(dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8) {
+                *out++ = (uint8_t)(NOE_QOI_OP_LUMA | (dg + 32));
+                *out++ = (uint8_t)((dr_dg + 8) << 4 | (db_dg + 8));
+            } else {
+                *out++ = NOE_QOI_OP_RGB;
+                *out++ = px.c.r;
+                *out++ = px.c.g;
+                *out++ = px.c.b;
+            }
+        } else {
+            index[hash] = px;
+            *out++ = NOE_QOI_OP_RGBA;
+            *out++ = px.c.r;
+            *out++ = px.c.g;
+            *out++ = px.c.b;
+            *out++ = px.c.a;
+        }
+        prev = px;
+    }
+    if(ok) {
+        memcpy(out, g_qoi_padding, sizeof(g_qoi_padding));
+        out += sizeof(g_qoi_padding);
+        ok = write(userdata, staging, out - staging);
+    }
+    NOE_FREE(staging);
+    return ok;
+}
+
+static bool noe_qoi_write_file(void *userdata, const void *data, size_t size)
+{
+    return fwrite(data, 1, size, (FILE *)userdata) == size;
+}
+
+static bool noe_qoi_write_memory(void *userdata, const void *data, size_t size)
+{
+    noe_QoiMemory *memory = userdata;
+    memory->written += size;
+    if(memory->size + size > memory->capacity) return false;
+    memcpy(memory->data + memory->size, data, size);
+    memory->size += size;
+    return true;
+}
+
+bool noe_image_save_to_qoifile(noe_Image image, const char *filepath)
+{
+    FILE *f = fopen(filepath, "wb");
+    if(!f) return false;
+    bool ok = noe_image_write_qoi(image, noe_qoi_write_file, f);
+    if(fclose(f) != 0) ok = false;
+    return ok;
+}
+
+size_t noe_image_encode_qoi(noe_Image image, void *buffer, size_t capacity)
+{
+    noe_QoiMemory memory = { .data = buffer, .capacity = capacity };
+    if(!noe_image_write_qoi(image, noe_qoi_write_memory, &memory)) return 0;
+    return memory.size;
+}
+
+static bool noe_is_qoi(const void *data, size_t size)
+{
+    return size >= NOE_QOI_HEADER_SIZE && memcmp(data, "qoif", 4) == 0;
+}
+
+static noe_Image noe_decode_qoi(const uint8_t *data, size_t size, int format)
+{
+    noe_Image image = {0};
+    int chans = noe_pixelformat_channel_amount(format);
+    if(chans < 0 || !noe_is_qoi(data, size)) return image;
+    uint32_t w = noe_qoi_get32(data + 4), h = noe_qoi_get32(data + 8);
+    if(w == 0 || h == 0 || (uint64_t)w * h > INT_MAX / 4 || data[12] < 3 || data[12] > 4) return image;
+
+    image = noe_create_image((int)w, (int)h, format);
+    if(!image.pixels) return image;
+
+    noe_QoiPixel index[64] = {0};
+    noe_QoiPixel px = { .c = { 0, 0, 0, 255 } };
+    const uint8_t *in = data + NOE_QOI_HEADER_SIZE;
+    // The padding is there so no op can read past it, only whole ops have to be checked
+    const uint8_t *end = data + size - sizeof(g_qoi_padding);
+    uint8_t *out = image.pixels;
+    uint8_t *out_end = image.pixels + (size_t)w * h * chans;
+    int run = 0;
+    for(; out < out_end; out += chans) {
+        if(run > 0) {
+            run -= 1;
+        } else if(in < end) {
+            int op = *in++;
+            if(op == NOE_QOI_OP_RGB) {
+                px.c.r = in[0];
+                px.c.g = in[1];
+                px.c.b = in[2];
+                in += 3;
+            } else if(op == NOE_QOI_OP_RGBA) {
+                px.c.r = in[0];
+                px.c.g = in[1];
+                px.c.b = in[2];
+                px.c.a = in[3];
+                in += 4;
+            } else if((op & NOE_QOI_MASK) == NOE_QOI_OP_INDEX) {
+                px = index[op];
+            } else if((op & NOE_QOI_MASK) == NOE_QOI_OP_DIFF) {
+                px.c.r += ((op >> 4) & 3) - 2;
+                px.c.g += ((op >> 2) & 3) - 2;
+                px.c.b += (op & 3) - 2;
+            } else if((op & NOE_QOI_MASK) == NOE_QOI_OP_LUMA) {
+                int b2 = *in++;
+                int dg = (op & 0x3F) - 32;
+                px.c.r += dg - 8 + ((b2 >> 4) & 0x0F);
+                px.c.g += dg;
+                px.c.b += dg - 8 + (b2 & 0x0F);
+            } else {
+                run = op & 0x3F;
+            }
+            index[NOE_QOI_HASH(px)] = px;
+        } else {
+            // Truncated stream
+            noe_unload_image(image);
+            return (noe_Image){0};
+        }
+        noe_qoi_write_pixel(out, format, px);
+    }
+    return image;
+}
+
+//////////////////////////////////////////////////////
+///
+/// Image loading
+///
+/// Files are mapped instead of read so the decoder works straight on the page
+/// cache. QOI goes to the codec above, everything else to stb_image, which
+/// decodes into the channel count of the requested format. The BGR orders are
+/// swizzled in place afterwards, no other copy is made.
+///
+
+typedef struct {
+    const void *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+} noe_FileView;
+
+// A copy on write view can be written to without touching the file
+static bool noe_map_file(const char *filepath, noe_FileView *view, bool copy_on_write)
+{
+    memset(view, 0, sizeof(*view));
+#ifdef _WIN32
+    view->file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(view->file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(view->file, &size) || size.QuadPart == 0) {
+        CloseHandle(view->file);
+        return false;
+    }
+    view->mapping = CreateFileMappingA(view->file, NULL, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+    if(view->mapping) view->data = MapViewOfFile(view->mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if(!view->data) {
+        if(view->mapping) CloseHandle(view->mapping);
+        CloseHandle(view->file);
+        return false;
+    }
+    view->size = (size_t)size.QuadPart;
+#else
+    int fd = open(filepath, O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    int prot = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *data = mmap(NULL, st.st_size, prot, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return false;
+    view->data = data;
+    view->size = st.st_size;
+#endif
+    return true;
+}
+
+static void noe_unmap_file(noe_FileView *view)
+{
+#ifdef _WIN32
+    UnmapViewOfFile((void *)view->data);
+    CloseHandle(view->mapping);
+    CloseHandle(view->file);
+#else
+    munmap((void *)view->data, view->size);
+#endif
+    memset(view, 0, sizeof(*view));
+}
+
+noe_Image noe_load_image_from_memory(const void *data, size_t size, int format)
+{
+    noe_Image image = {0};
+    int chans = noe_pixelformat_channel_amount(format);
+    if(chans < 0) return image;
+    if(noe_is_qoi(data, size)) return noe_decode_qoi(data, size, format);
+    if(size > INT_MAX) return image;
+
+    int w, h, file_chans;
+    stbi_uc *pixels = stbi_load_from_memory(data, (int)size, &w, &h, &file_chans, chans);
+    if(!pixels) return image;
+
+    int decoded = NOE_PIXELFORMAT_R8G8B8A8;
+    if(chans == 3) decoded = NOE_PIXELFORMAT_R8G8B8;
+    else if(chans == 1) decoded = NOE_PIXELFORMAT_GRAYSCALE;
+    image = noe_load_image(pixels, w, h, decoded);
+    noe_image_convert_in_place(&image, format);
+    return image;
+}
+
+noe_Image noe_load_image_from_file(const char *filepath, int format)
+{
+    noe_FileView view;
+    if(!noe_map_file(filepath, &view, false)) return (noe_Image){0};
+    noe_Image image = noe_load_image_from_memory(view.data, view.size, format);
+    noe_unmap_file(&view);
+    return image;
+}
+
+bool noe_probe_image_from_memory(const void *data, size_t size, int *w, int *h, int *channels)
+{
+    if(noe_is_qoi(data, size)) {
+        const uint8_t *header = data;
+        if(w) *w = (int)noe_qoi_get32(header + 4);
+        if(h) *h = (int)noe_qoi_get32(header + 8);
+        if(channels) *channels = header[12];
+        return true;
+    }
+    if(size > INT_MAX) return false;
+    return stbi_info_from_memory(data, (int)size, w, h, channels) != 0;
+}
+
+bool noe_probe_image_file(const char *filepath, int *w, int *h, int *channels)
+{
+    // Only the header is read, no need to map the whole file
+    uint8_t header[NOE_QOI_HEADER_SIZE];
+    FILE *f = fopen(filepath, "rb");
+    if(!f) return false;
+    bool is_qoi = fread(header, sizeof(header), 1, f) == 1 && noe_is_qoi(header, sizeof(header));
+    fclose(f);
+    if(is_qoi) return noe_probe_image_from_memory(header, sizeof(header), w, h, channels);
+    return stbi_info(filepath, w, h, channels) != 0;
+}
+
+// stb_truetype trusts the table directory of the font, so it has to fit the
+// file along with every table it points at before the font is handed to it
+static bool noe_ttf_tables_fit(const uint8_t *data, size_t size)
+{
+    if(size < 12) return false;
+    uint32_t version = noe_qoi_get32(data);
+    if(version != 0x00010000 && memcmp(data, "OTTO", 4) != 0 && memcmp(data, "true", 4) != 0) return false;
+    size_t num_tables = ((size_t)data[4] << 8) | data[5];
+    if(12 + num_tables * 16 > size) return false;
+    for(size_t i = 0; i < num_tables; ++i) {
+        const uint8_t *entry = data + 12 + i * 16;
+        uint64_t offset = noe_qoi_get32(entry + 8), length = noe_qoi_get32(entry + 12);
+        if(offset + length > size) return false;
+    }
     return true;
 }
 
@@ -21,20 +1180,25 @@ noe_Font noe_load_font_from_ttf(const char *filepath, int fontsz)
     size_t size = 0;
     unsigned char* font_data = 0;
     FILE* font_file = fopen(filepath, "rb");
+    if(!font_file) return (noe_Font){0};
     fseek(font_file, 0, SEEK_END);
-    size = ftell(font_file); /* how long is the file ? */
+    long length = ftell(font_file); /* how long is the file ? */
     fseek(font_file, 0, SEEK_SET); /* reset */ 
-    font_data = malloc(size); 
-    fread(font_data, size, 1, font_file);
+    if(length > 0) {
+        size = (size_t)length;
+        font_data = malloc(size);
+    }
+    bool read = font_data && fread(font_data, size, 1, font_file) == 1;
     fclose(font_file);
 
     int codepoint_amount = 0;
     int *codepoints = 0;
     stbtt_fontinfo info;
- 
-    if (!stbtt_InitFont(&info, font_data, 0))
-    {
-        printf("failed\n");
+
+    // Not a font stb_truetype can read, every lookup below would go out of bounds
+    if(!read || !noe_ttf_tables_fit(font_data, size) || !stbtt_InitFont(&info, font_data, 0)) {
+        free(font_data);
+        return (noe_Font){0};
     }
 
     codepoint_amount = codepoint_amount != 0 ? codepoint_amount : 95;
@@ -42,6 +1206,10 @@ noe_Font noe_load_font_from_ttf(const char *filepath, int fontsz)
     if(!codepoints) {
         codepoint_generated = 1;
         codepoints = calloc(sizeof(int), codepoint_amount);
+        if(!codepoints) {
+            free(font_data);
+            return (noe_Font){0};
+        }
         for(int i = 0; i < 95; ++i)
             codepoints[i] = 32 + i;
     }
@@ -65,8 +1233,15 @@ noe_Font noe_load_font_from_ttf(const char *filepath, int fontsz)
         bw += roundf(ax * scale);
     }
 
-    uint8_t* bitmap = malloc(bw * bh * sizeof(uint8_t));
+    uint8_t* bitmap = calloc(bw * bh, sizeof(uint8_t));
     noe_Glyph *chars = malloc(sizeof(noe_Glyph) * codepoint_amount);
+    if(!bitmap || !chars) {
+        free(bitmap);
+        free(chars);
+        if(codepoint_generated) free(codepoints);
+        free(font_data);
+        return (noe_Font){0};
+    }
 
     ascent = roundf(ascent * scale);
     descent = roundf(descent * scale);
@@ -103,6 +1278,7 @@ noe_Font noe_load_font_from_ttf(const char *filepath, int fontsz)
 
     if(codepoint_generated)
         free(codepoints);
+    free(font_data);
     noe_Image image = noe_load_image(bitmap, bw, bh, NOE_PIXELFORMAT_GRAYSCALE);
     return noe_load_font(image, chars, codepoint_amount);
 }
@@ -146,3 +1322,1690 @@ void noe_font_to_c_header(noe_Font font, const char *filepath)
     fprintf(f, "};\n");
     fprintf(f, "#endif // NOE_FONT_DATA_H_\n");
 }
+
+//////////////////////////////////////////////////////
+///
+/// Video recording
+///
+/// A step hook copies the canvas into a free buffer of a small pool and queues
+/// it, the writer thread does the color conversion and the file IO. When every
+/// buffer is queued the frame is either dropped or noe_step waits for the
+/// writer, so the cost on the frame is one canvas copy otherwise.
+///
+
+#define NOE_VIDEO_BUFFERS 4
+
+typedef struct noe_VideoFrame {
+    struct noe_VideoFrame *next;
+    uint8_t *pixels;
+} noe_VideoFrame;
+
+struct noe_VideoRecorder {
+    noe_Context *ctx;
+    FILE *file;
+    int container;
+    int policy;
+    int w, h, format;
+    uint8_t *yuv; // writer only
+
+    noe_Mutex *mutex;
+    noe_Cond *frame_queued;
+    noe_Cond *frame_freed;
+    noe_VideoFrame frames[NOE_VIDEO_BUFFERS];
+    noe_VideoFrame *free_frames;
+    noe_VideoFrame *queue_head, *queue_tail;
+    noe_Thread *writer;
+    bool quit;
+    bool failed;
+    noe_VideoRecordStats stats;
+};
+
+// Full range BT.601 (what C420jpeg means in Y4M) with 2x2 averaged chroma
+static void noe_rgb_to_yuv420(const uint8_t *pixels, int w, int h, int format, uint8_t *yp, uint8_t *up, uint8_t *vp)
+{
+    int chans = noe_pixelformat_channel_amount(format);
+    int ri = 0, gi = 1, bi = 2;
+    if(format == NOE_PIXELFORMAT_B8G8R8A8 || format == NOE_PIXELFORMAT_B8G8R8) {
+        ri = 2;
+        bi = 0;
+    } else if(format == NOE_PIXELFORMAT_GRAYSCALE) {
+        ri = gi = bi = 0;
+    }
+    const size_t stride = (size_t)w * chans;
+    const int cw = (w + 1) / 2;
+
+    for(int y = 0; y < h; ++y) {
+        const uint8_t *row = pixels + y * stride;
+        uint8_t *out = yp + (size_t)y * w;
+        int x = 0;
+#ifdef NOE_HAS_SSE2
+        if(chans == 4) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i round = _mm_set1_epi32(128);
+            short c[4] = {0};
+            c[ri] = 77;
+            c[gi] = 150;
+            c[bi] = 29;
+            const __m128i coefs = _mm_setr_epi16(c[0], c[1], c[2], c[3], c[0], c[1], c[2], c[3]);
+            for(; x + 8 <= w; x += 8) {
+                __m128i p0 = _mm_loadu_si128((const __m128i *)(row + x*4));
+                __m128i p1 = _mm_loadu_si128((const __m128i *)(row + x*4 + 16));
+                // Two partial sums per pixel, added up into the low dword of every qword
+                __m128i s0 = _mm_madd_epi16(_mm_unpacklo_epi8(p0, zero), coefs);
+                __m128i s1 = _mm_madd_epi16(_mm_unpackhi_epi8(p0, zero), coefs);
+                __m128i s2 = _mm_madd_epi16(_mm_unpacklo_epi8(p1, zero), coefs);
+                __m128i s3 = _mm_madd_epi16(_mm_unpackhi_epi8(p1, zero), coefs);
+                s0 = _mm_shuffle_epi32(_mm_add_epi32(s0, _mm_srli_epi64(s0, 32)), _MM_SHUFFLE(3, 1, 2, 0));
+                s1 = _mm_shuffle_epi32(_mm_add_epi32(s1, _mm_srli_epi64(s1, 32)), _MM_SHUFFLE(3, 1, 2, 0));
+                s2 = _mm_shuffle_epi32(_mm_add_epi32(s2, _mm_srli_epi64(s2, 32)), _MM_SHUFFLE(3, 1, 2, 0));
+                s3 = _mm_shuffle_epi32(_mm_add_epi32(s3, _mm_srli_epi64(s3, 32)), _MM_SHUFFLE(3, 1, 2, 0));
+                __m128i lo = _mm_srli_epi32(_mm_add_epi32(_mm_unpacklo_epi64(s0, s1), round), 8);
+                __m128i hi = _mm_srli_epi32(_mm_add_epi32(_mm_unpacklo_epi64(s2, s3), round), 8);
+                __m128i luma = _mm_packs_epi32(lo, hi);
+                _mm_storel_epi64((__m128i *)(out + x), _mm_packus_epi16(luma, luma));
+            }
+        }
+#endif
+        for(; x < w; ++x) {
+            const uint8_t *p = row + x * chans;
+            out[x] = (uint8_t)((77*p[ri] + 150*p[gi] + 29*p[bi] + 128) >> 8);
+        }
+    }
+
+    for(int y = 0; y < h; y += 2) {
+        const uint8_t *row0 = pixels + y * stride;
+        const uint8_t *row1 = y + 1 < h ? row0 + stride : row0;
+        for(int x = 0; x < w; x += 2) {
+            size_t o0 = (size_t)x * chans, o1 = x + 1 < w ? o0 + chans : o0;
+            int r = (row0[o0+ri] + row0[o1+ri] + row1[o0+ri] + row1[o1+ri] + 2) >> 2;
+            int g = (row0[o0+gi] + row0[o1+gi] + row1[o0+gi] + row1[o1+gi] + 2) >> 2;
+            int b = (row0[o0+bi] + row0[o1+bi] + row1[o0+bi] + row1[o1+bi] + 2) >> 2;
+            // Offset by 128 << 8 so the sums stay positive before the shift
+            int u = (-43*r - 85*g + 128*b + 32896) >> 8;
+            int v = (128*r - 107*g - 21*b + 32896) >> 8;
+            size_t i = (size_t)(y / 2) * cw + x / 2;
+            up[i] = (uint8_t)NOE_MIN(u, 255);
+            vp[i] = (uint8_t)NOE_MIN(v, 255);
+        }
+    }
+}
+
+static bool noe_video_write_frame(noe_VideoRecorder *rec, const uint8_t *pixels)
+{
+    size_t frame_size = (size_t)rec->w * rec->h * noe_pixelformat_channel_amount(rec->format);
+    if(rec->container == NOE_VIDEO_RAW) return fwrite(pixels, 1, frame_size, rec->file) == frame_size;
+
+    size_t luma_size = (size_t)rec->w * rec->h;
+    size_t chroma_size = (size_t)((rec->w + 1) / 2) * ((rec->h + 1) / 2);
+    noe_rgb_to_yuv420(pixels, rec->w, rec->h, rec->format, rec->yuv, rec->yuv + luma_size, rec->yuv + luma_size + chroma_size);
+    return fputs("FRAME\n", rec->file) >= 0
+        && fwrite(rec->yuv, 1, luma_size + 2*chroma_size, rec->file) == luma_size + 2*chroma_size;
+}
+
+static int noe_video_writer(void *arg)
+{
+    noe_VideoRecorder *rec = arg;
+    for(;;) {
+        noe_mutex_lock(rec->mutex);
+        while(!rec->quit && !rec->queue_head) noe_cond_wait(rec->frame_queued, rec->mutex);
+        noe_VideoFrame *frame = rec->queue_head;
+        if(!frame) {
+            // Only quits once everything queued is written
+            noe_mutex_unlock(rec->mutex);
+            return 0;
+        }
+        rec->queue_head = frame->next;
+        if(!rec->queue_head) rec->queue_tail = NULL;
+        bool failed = rec->failed;
+        noe_mutex_unlock(rec->mutex);
+
+        // Keep recycling the buffers after an error so noe_step never waits forever
+        if(!failed) failed = !noe_video_write_frame(rec, frame->pixels);
+
+        noe_mutex_lock(rec->mutex);
+        rec->failed = failed;
+        if(!failed) rec->stats.frames_written += 1;
+        frame->next = rec->free_frames;
+        rec->free_frames = frame;
+        noe_cond_signal(rec->frame_freed);
+        noe_mutex_unlock(rec->mutex);
+    }
+}
+
+static void noe_video_capture(noe_Context *ctx, noe_Image canvas, void *userdata)
+{
+    (void)ctx;
+    noe_VideoRecorder *rec = userdata;
+    double begin = noe_gettime();
+    double blocked = 0.0;
+
+    noe_mutex_lock(rec->mutex);
+    if(!rec->free_frames && rec->policy == NOE_VIDEO_BLOCK) {
+        while(!rec->free_frames) noe_cond_wait(rec->frame_freed, rec->mutex);
+        blocked = noe_gettime() - begin;
+    }
+    noe_VideoFrame *frame = canvas.format == rec->format ? rec->free_frames : NULL;
+    if(frame) rec->free_frames = frame->next;
+    else rec->stats.frames_dropped += 1;
+    noe_mutex_unlock(rec->mutex);
+
+    if(frame) {
+        int chans = noe_pixelformat_channel_amount(rec->format);
+        if(canvas.w == rec->w && canvas.h == rec->h) {
+            noe_copy_packed(frame->pixels, canvas);
+        } else {
+            // The window was resized, keep the video size and fill the rest with black
+            size_t row_size = (size_t)rec->w * chans;
+            size_t copy_size = (size_t)NOE_MIN(rec->w, canvas.w) * chans;
+            for(int y = 0; y < rec->h; ++y) {
+                uint8_t *dst = frame->pixels + y * row_size;
+                size_t copied = y < canvas.h ? copy_size : 0;
+                if(copied) memcpy(dst, canvas.pixels + (size_t)y * noe_image_stride(canvas), copied);
+                memset(dst + copied, 0, row_size - copied);
+            }
+        }
+    }
+
+    noe_mutex_lock(rec->mutex);
+    if(frame) {
+        frame->next = NULL;
+        if(rec->queue_tail) rec->queue_tail->next = frame;
+        else rec->queue_head = frame;
+        rec->queue_tail = frame;
+        rec->stats.frames_captured += 1;
+        noe_cond_signal(rec->frame_queued);
+    }
+    rec->stats.capture_time = noe_gettime() - begin;
+    rec->stats.max_capture_time = NOE_MAX(rec->stats.max_capture_time, rec->stats.capture_time);
+    rec->stats.blocked_time += blocked;
+    noe_mutex_unlock(rec->mutex);
+}
+
+static void noe_video_destroy(noe_VideoRecorder *rec)
+{
+    for(int i = 0; i < NOE_VIDEO_BUFFERS; ++i) NOE_FREE(rec->frames[i].pixels);
+    NOE_FREE(rec->yuv);
+    if(rec->frame_freed) noe_cond_destroy(rec->frame_freed);
+    if(rec->frame_queued) noe_cond_destroy(rec->frame_queued);
+    if(rec->mutex) noe_mutex_destroy(rec->mutex);
+    if(rec->file) fclose(rec->file);
+    NOE_FREE(rec);
+}
+
+noe_VideoRecorder *noe_video_record_begin(noe_Context *ctx, const char *filepath, int container, double fps, int policy)
+{
+    noe_VideoRecorder *rec = NOE_MALLOC(sizeof(*rec));
+    if(!rec) return NULL;
+    memset(rec, 0, sizeof(*rec));
+    rec->ctx = ctx;
+    rec->container = container;
+    rec->policy = policy;
+    rec->w = noe_screen_width(ctx);
+    rec->h = noe_screen_height(ctx);
+    rec->format = NOE_PIXELFORMAT_B8G8R8A8; // the format of every canvas
+
+    // Everything the capture needs is allocated up front
+    size_t frame_size = (size_t)rec->w * rec->h * noe_pixelformat_channel_amount(rec->format);
+    bool ok = rec->w > 0 && rec->h > 0;
+    for(int i = 0; ok && i < NOE_VIDEO_BUFFERS; ++i) {
+        rec->frames[i].pixels = NOE_MALLOC(frame_size);
+        rec->frames[i].next = rec->free_frames;
+        rec->free_frames = &rec->frames[i];
+        ok = rec->frames[i].pixels != NULL;
+        // Touch the pages now instead of faulting them in during a capture
+        if(ok) memset(rec->frames[i].pixels, 0, frame_size);
+    }
+    if(ok && container == NOE_VIDEO_Y4M) {
+        rec->yuv = NOE_MALLOC((size_t)rec->w * rec->h + 2 * (size_t)((rec->w + 1) / 2) * ((rec->h + 1) / 2));
+        ok = rec->yuv != NULL;
+    }
+    rec->mutex = noe_mutex_create();
+    rec->frame_queued = noe_cond_create();
+    rec->frame_freed = noe_cond_create();
+    ok = ok && rec->mutex && rec->frame_queued && rec->frame_freed;
+    if(ok) {
+        rec->file = fopen(filepath, "wb");
+        ok = rec->file != NULL;
+    }
+    if(ok && container == NOE_VIDEO_Y4M) {
+        if(fps <= 0) fps = noe_get_target_fps(ctx);
+        if(fps <= 0) fps = 60.0;
+        ok = fprintf(rec->file, "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C420jpeg\n", rec->w, rec->h, (int)(fps * 1000.0 + 0.5)) > 0;
+    }
+    if(ok) {
+        rec->writer = noe_thread_create(noe_video_writer, rec);
+        ok = rec->writer != NULL;
+    }
+    if(ok && !noe_add_step_hook(ctx, noe_video_capture, rec)) {
+        noe_mutex_lock(rec->mutex);
+        rec->quit = true;
+        noe_cond_signal(rec->frame_queued);
+        noe_mutex_unlock(rec->mutex);
+        noe_thread_join(rec->writer);
+        ok = false;
+    }
+    if(!ok) {
+        noe_video_destroy(rec);
+        return NULL;
+    }
+    return rec;
+}
+
+bool noe_video_record_end(noe_VideoRecorder *rec)
+{
+    if(!rec) return false;
+    noe_remove_step_hook(rec->ctx, noe_video_capture, rec);
+    noe_mutex_lock(rec->mutex);
+    rec->quit = true;
+    noe_cond_signal(rec->frame_queued);
+    noe_mutex_unlock(rec->mutex);
+    noe_thread_join(rec->writer);
+
+    bool ok = !rec->failed;
+    if(fclose(rec->file) != 0) ok = false;
+    rec->file = NULL;
+    noe_video_destroy(rec);
+    return ok;
+}
+
+noe_VideoRecordStats noe_video_record_stats(noe_VideoRecorder *rec)
+{
+    noe_mutex_lock(rec->mutex);
+    noe_VideoRecordStats stats = rec->stats;
+    noe_mutex_unlock(rec->mutex);
+    return stats;
+}
+
+//////////////////////////////////////////////////////
+///
+/// Asynchronous asset loading
+///
+/// Submitted jobs wait in a FIFO for one of the workers, which decodes them and
+/// moves them to the completion list. Nothing is handed to the application
+/// until it polls, so decoded assets only ever show up between frames.
+///
+
+#define NOE_ASSET_MAX_WORKERS 16
+
+typedef struct noe_AssetJob {
+    struct noe_AssetJob *next;
+    noe_AssetResult result;
+    char *filepath;
+    int param; // pixel format for images, size for fonts
+} noe_AssetJob;
+
+struct noe_AssetLoader {
+    noe_Mutex *mutex;
+    noe_Cond *work_available;
+    noe_AssetJob *queue_head, *queue_tail; // waiting for a worker
+    noe_AssetJob *done_head, *done_tail;   // decoded, waiting to be polled
+    noe_Thread *workers[NOE_ASSET_MAX_WORKERS];
+    int workers_count;
+    int pending;
+    noe_AssetHandle next_handle;
+    bool quit;
+};
+
+static void noe_asset_job_append(noe_AssetJob **head, noe_AssetJob **tail, noe_AssetJob *job)
+{
+    job->next = NULL;
+    if(*tail) (*tail)->next = job;
+    else *head = job;
+    *tail = job;
+}
+
+static noe_AssetJob *noe_asset_job_pop(noe_AssetJob **head, noe_AssetJob **tail)
+{
+    noe_AssetJob *job = *head;
+    if(!job) return NULL;
+    *head = job->next;
+    if(!*head) *tail = NULL;
+    return job;
+}
+
+static void noe_asset_job_destroy(noe_AssetJob *job, bool unload)
+{
+    if(unload && job->result.ok) {
+        if(job->result.kind == NOE_ASSET_IMAGE) {
+            noe_unload_image(job->result.image);
+        } else {
+            noe_unload_image(job->result.font.atlas);
+            noe_unload_font(job->result.font);
+        }
+    }
+    NOE_FREE(job->filepath);
+    NOE_FREE(job);
+}
+
+static int noe_asset_worker(void *arg)
+{
+    noe_AssetLoader *loader = arg;
+    for(;;) {
+        noe_mutex_lock(loader->mutex);
+        while(!loader->quit && !loader->queue_head) noe_cond_wait(loader->work_available, loader->mutex);
+        if(loader->quit) {
+            noe_mutex_unlock(loader->mutex);
+            return 0;
+        }
+        noe_AssetJob *job = noe_asset_job_pop(&loader->queue_head, &loader->queue_tail);
+        noe_mutex_unlock(loader->mutex);
+
+        noe_AssetResult *result = &job->result;
+        if(result->kind == NOE_ASSET_IMAGE) {
+            result->image = noe_load_image_from_file(job->filepath, job->param);
+            result->ok = result->image.pixels != NULL;
+        } else {
+            result->font = noe_load_font_from_ttf(job->filepath, job->param);
+            result->ok = result->font.atlas.pixels != NULL;
+        }
+
+        noe_mutex_lock(loader->mutex);
+        noe_asset_job_append(&loader->done_head, &loader->done_tail, job);
+        noe_mutex_unlock(loader->mutex);
+    }
+}
+
+noe_AssetLoader *noe_create_asset_loader(int workers)
+{
+    if(workers <= 0) workers = noe_cpu_count() - 1;
+    workers = NOE_CLAMP(workers, 1, NOE_ASSET_MAX_WORKERS);
+
+    noe_AssetLoader *loader = NOE_MALLOC(sizeof(*loader));
+    if(!loader) return NULL;
+    memset(loader, 0, sizeof(*loader));
+    loader->next_handle = 1;
+    loader->mutex = noe_mutex_create();
+    loader->work_available = noe_cond_create();
+    if(!loader->mutex || !loader->work_available) {
+        noe_destroy_asset_loader(loader);
+        return NULL;
+    }
+    for(int i = 0; i < workers; ++i) {
+        noe_Thread *thread = noe_thread_create(noe_asset_worker, loader);
+        if(!thread) break;
+        loader->workers[loader->workers_count++] = thread;
+    }
+    if(loader->workers_count == 0) {
+        noe_destroy_asset_loader(loader);
+        return NULL;
+    }
+    return loader;
+}
+
+void noe_destroy_asset_loader(noe_AssetLoader *loader)
+{
+    if(!loader) return;
+    if(loader->mutex) {
+        noe_mutex_lock(loader->mutex);
+        loader->quit = true;
+        noe_cond_broadcast(loader->work_available);
+        noe_mutex_unlock(loader->mutex);
+    }
+    for(int i = 0; i < loader->workers_count; ++i) noe_thread_join(loader->workers[i]);
+
+    noe_AssetJob *job;
+    while((job = noe_asset_job_pop(&loader->queue_head, &loader->queue_tail))) noe_asset_job_destroy(job, false);
+    while((job = noe_asset_job_pop(&loader->done_head, &loader->done_tail))) noe_asset_job_destroy(job, true);
+    if(loader->work_available) noe_cond_destroy(loader->work_available);
+    if(loader->mutex) noe_mutex_destroy(loader->mutex);
+    NOE_FREE(loader);
+}
+
+static noe_AssetHandle noe_asset_submit(noe_AssetLoader *loader, int kind, const char *filepath, int param, void *userdata)
+{
+    noe_AssetJob *job = NOE_MALLOC(sizeof(*job));
+    size_t len = strlen(filepath);
+    char *path = NOE_MALLOC(len + 1);
+    if(!job || !path) {
+        NOE_FREE(job);
+        NOE_FREE(path);
+        return 0;
+    }
+    memset(job, 0, sizeof(*job));
+    memcpy(path, filepath, len + 1);
+    job->filepath = path;
+    job->param = param;
+    job->result.kind = kind;
+    job->result.userdata = userdata;
+
+    noe_mutex_lock(loader->mutex);
+    job->result.handle = loader->next_handle++;
+    if(loader->next_handle == 0) loader->next_handle = 1;
+    loader->pending += 1;
+    noe_asset_job_append(&loader->queue_head, &loader->queue_tail, job);
+    noe_cond_signal(loader->work_available);
+    noe_mutex_unlock(loader->mutex);
+    return job->result.handle;
+}
+
+noe_AssetHandle noe_load_image_async(noe_AssetLoader *loader, const char *filepath, int format, void *userdata)
+{
+    return noe_asset_submit(loader, NOE_ASSET_IMAGE, filepath, format, userdata);
+}
+
+noe_AssetHandle noe_load_font_async(noe_AssetLoader *loader, const char *filepath, int fontsz, void *userdata)
+{
+    return noe_asset_submit(loader, NOE_ASSET_FONT, filepath, fontsz, userdata);
+}
+
+int noe_asset_loader_poll(noe_AssetLoader *loader, noe_AssetResult *results, int max_results)
+{
+    // Take the finished jobs out under the lock and free them without it
+    noe_AssetJob *taken = NULL, *taken_tail = NULL;
+    int count = 0;
+    noe_mutex_lock(loader->mutex);
+    while(count < max_results && loader->done_head) {
+        noe_asset_job_append(&taken, &taken_tail, noe_asset_job_pop(&loader->done_head, &loader->done_tail));
+        count += 1;
+    }
+    loader->pending -= count;
+    noe_mutex_unlock(loader->mutex);
+
+    for(int i = 0; i < count; ++i) {
+        noe_AssetJob *job = noe_asset_job_pop(&taken, &taken_tail);
+        results[i] = job->result;
+        noe_asset_job_destroy(job, false);
+    }
+    return count;
+}
+
+int noe_asset_loader_pending(noe_AssetLoader *loader)
+{
+    noe_mutex_lock(loader->mutex);
+    int pending = loader->pending;
+    noe_mutex_unlock(loader->mutex);
+    return pending;
+}
+
+//////////////////////////////////////////////////////
+///
+/// Asynchronous image saving
+///
+/// The image is copied into a pooled buffer right away, so the caller can keep
+/// drawing into it. A save to a file that is still queued overwrites the queued
+/// copy instead. One background thread encodes the queued saves in order
+/// and exits when the queue runs dry. Finished saves wait until the next
+/// noe_step of their context, where a step hook runs their callbacks. At most
+/// max_queued saves wait for the worker, more either block or are dropped.
+///
+
+#define NOE_SAVE_POOL_SIZE 4
+#define NOE_SAVE_MAX_CONTEXTS 4
+
+enum {
+    NOE_SAVER_UNINITIALIZED = 0,
+    NOE_SAVER_INITIALIZING,
+    NOE_SAVER_READY,
+};
+
+typedef struct noe_SaveJob {
+    struct noe_SaveJob *next;
+    noe_Context *ctx;
+    noe_Image image; // the snapshot, its pixels stay with the job in the pool
+    size_t capacity;
+    char *filepath;
+    int file_format;
+    noe_SaveCallback callback;
+    void *userdata;
+    bool ok;
+} noe_SaveJob;
+
+static struct {
+    noe_Mutex *mutex;
+    noe_Cond *job_done;
+    noe_SaveJob *queue_head, *queue_tail; // waiting for the worker
+    noe_SaveJob *done_head, *done_tail;   // waiting for noe_step
+    noe_SaveJob *pool;
+    int pool_count;
+    noe_Thread *worker;
+    bool worker_running;
+    int queued; // waiting for the worker or being written by it
+    int max_queued;
+    int policy;
+    struct { noe_Context *ctx; int pending; } contexts[NOE_SAVE_MAX_CONTEXTS];
+} g_saver = { .max_queued = NOE_SAVE_POOL_SIZE, .policy = NOE_SAVE_BLOCK };
+
+static atomic_int g_saver_state;
+
+// Creates the mutex and the condition variable exactly once, a failed attempt
+// leaves nothing behind so a later save can try again
+static bool noe_saver_init(void)
+{
+    for(;;) {
+        int state = NOE_SAVER_UNINITIALIZED;
+        if(atomic_compare_exchange_strong(&g_saver_state, &state, NOE_SAVER_INITIALIZING)) {
+            noe_Mutex *mutex = noe_mutex_create();
+            noe_Cond *job_done = noe_cond_create();
+            if(!mutex || !job_done) {
+                if(mutex) noe_mutex_destroy(mutex);
+                if(job_done) noe_cond_destroy(job_done);
+                atomic_store(&g_saver_state, NOE_SAVER_UNINITIALIZED);
+                return false;
+            }
+            g_saver.mutex = mutex;
+            g_saver.job_done = job_done;
+            atomic_store(&g_saver_state, NOE_SAVER_READY);
+            return true;
+        }
+        if(state == NOE_SAVER_READY) return true;
+        // Another thread is creating them right now
+        noe_sleep(0);
+    }
+}
+
+static bool noe_saver_ready(void)
+{
+    return atomic_load(&g_saver_state) == NOE_SAVER_READY;
+}
+
+void noe_image_save_set_limit(int max_queued, int policy)
+{
+    if(!noe_saver_init()) return;
+    noe_mutex_lock(g_saver.mutex);
+    g_saver.max_queued = NOE_MAX(max_queued, 1);
+    g_saver.policy = policy;
+    // Blocked saves may fit now
+    noe_cond_broadcast(g_saver.job_done);
+    noe_mutex_unlock(g_saver.mutex);
+}
+
+static void noe_save_job_append(noe_SaveJob **head, noe_SaveJob **tail, noe_SaveJob *job)
+{
+    job->next = NULL;
+    if(*tail) (*tail)->next = job;
+    else *head = job;
+    *tail = job;
+}
+
+// Must hold the mutex
+static void noe_save_job_release(noe_SaveJob *job)
+{
+    NOE_FREE(job->filepath);
+    job->filepath = NULL;
+    if(g_saver.pool_count < NOE_SAVE_POOL_SIZE) {
+        job->next = g_saver.pool;
+        g_saver.pool = job;
+        g_saver.pool_count += 1;
+        return;
+    }
+    NOE_FREE(job->image.pixels);
+    NOE_FREE(job);
+}
+
+// Must hold the mutex
+static noe_SaveJob *noe_save_job_acquire(size_t size)
+{
+    noe_SaveJob **it = &g_saver.pool;
+    while(*it && (*it)->capacity < size) it = &(*it)->next;
+    noe_SaveJob *job = *it;
+    if(job) {
+        *it = job->next;
+        g_saver.pool_count -= 1;
+        return job;
+    }
+    // None big enough, replace the first pooled one rather than growing the pool
+    job = g_saver.pool;
+    if(job) {
+        g_saver.pool = job->next;
+        g_saver.pool_count -= 1;
+        NOE_FREE(job->image.pixels);
+    } else {
+        job = NOE_MALLOC(sizeof(*job));
+        if(!job) return NULL;
+    }
+    memset(job, 0, sizeof(*job));
+    job->image.pixels = NOE_MALLOC(size ? size : 1);
+    if(!job->image.pixels) {
+        NOE_FREE(job);
+        return NULL;
+    }
+    job->capacity = size;
+    return job;
+}
+
+static int noe_save_worker(void *arg)
+{
+    (void)arg;
+    for(;;) {
+        noe_mutex_lock(g_saver.mutex);
+        noe_SaveJob *job = g_saver.queue_head;
+        if(!job) {
+            g_saver.worker_running = false;
+            noe_cond_broadcast(g_saver.job_done);
+            noe_mutex_unlock(g_saver.mutex);
+            return 0;
+        }
+        g_saver.queue_head = job->next;
+        if(!g_saver.queue_head) g_saver.queue_tail = NULL;
+        noe_mutex_unlock(g_saver.mutex);
+
+        if(job->file_format == NOE_IMAGE_FILE_QOI) {
+            job->ok = noe_image_save_to_qoifile(job->image, job->filepath);
+        } else {
+            // Leave a core to the thread running the game
+            int threads = NOE_MAX(noe_cpu_count() - 1, 1);
+            job->ok = noe_image_write_png(job->image, job->filepath, NOE_PNG_DEFAULT_LEVEL, threads) == NOE_PNG_OK;
+        }
+
+        noe_mutex_lock(g_saver.mutex);
+        noe_save_job_append(&g_saver.done_head, &g_saver.done_tail, job);
+        g_saver.queued -= 1;
+        noe_cond_broadcast(g_saver.job_done);
+        noe_mutex_unlock(g_saver.mutex);
+    }
+}
+
+static int noe_save_context_index(noe_Context *ctx)
+{
+    for(int i = 0; i < NOE_SAVE_MAX_CONTEXTS; ++i) {
+        if(g_saver.contexts[i].ctx == ctx) return i;
+    }
+    return -1;
+}
+
+// Runs the callbacks of the finished saves of ctx, returns how many are still pending
+static int noe_save_drain(noe_Context *ctx)
+{
+    noe_SaveJob *finished = NULL, **finished_tail = &finished;
+    noe_mutex_lock(g_saver.mutex);
+    noe_SaveJob **it = &g_saver.done_head;
+    g_saver.done_tail = NULL;
+    while(*it) {
+        noe_SaveJob *job = *it;
+        if(job->ctx == ctx) {
+            *it = job->next;
+            job->next = NULL;
+            *finished_tail = job;
+            finished_tail = &job->next;
+        } else {
+            g_saver.done_tail = job;
+            it = &job->next;
+        }
+    }
+    noe_mutex_unlock(g_saver.mutex);
+
+    int drained = 0;
+    for(noe_SaveJob *job = finished; job; job = job->next, ++drained) {
+        if(job->callback) job->callback(job->filepath, job->ok, job->userdata);
+    }
+
+    noe_mutex_lock(g_saver.mutex);
+    while(finished) {
+        noe_SaveJob *next = finished->next;
+        noe_save_job_release(finished);
+        finished = next;
+    }
+    int index = noe_save_context_index(ctx);
+    int pending = 0;
+    if(index >= 0) {
+        g_saver.contexts[index].pending -= drained;
+        pending = g_saver.contexts[index].pending;
+        if(pending == 0) g_saver.contexts[index].ctx = NULL;
+    }
+    // Reap a worker that ran out of work, it doesn't touch the mutex anymore
+    noe_Thread *idle_worker = NULL;
+    if(!g_saver.worker_running) {
+        idle_worker = g_saver.worker;
+        g_saver.worker = NULL;
+    }
+    noe_mutex_unlock(g_saver.mutex);
+    if(idle_worker) noe_thread_join(idle_worker);
+    return pending;
+}
+
+static void noe_save_step_hook(noe_Context *ctx, noe_Image canvas, void *userdata)
+{
+    (void)canvas;
+    (void)userdata;
+    if(noe_save_drain(ctx) == 0) noe_remove_step_hook(ctx, noe_save_step_hook, NULL);
+}
+
+bool noe_image_save_async(noe_Context *ctx, noe_Image image, const char *filepath, int file_format,
+        noe_SaveCallback callback, void *userdata)
+{
+    int chans = noe_pixelformat_channel_amount(image.format);
+    if(chans < 0 || !image.pixels || image.w <= 0 || image.h <= 0) return false;
+    if(!noe_saver_init()) return false;
+
+    size_t size = (size_t)image.w * image.h * chans;
+    noe_mutex_lock(g_saver.mutex);
+    // Saving again to a file that is still queued only replaces the image to
+    // write, so spamming export costs one copy into a buffer that is already there
+    for(noe_SaveJob *job = g_saver.queue_head; job; job = job->next) {
+        if(job->ctx != ctx || job->file_format != file_format || job->callback != callback
+                || job->userdata != userdata || job->capacity < size || strcmp(job->filepath, filepath) != 0) continue;
+        noe_copy_packed(job->image.pixels, image);
+        job->image.w = image.w;
+        job->image.h = image.h;
+        job->image.format = image.format;
+        noe_mutex_unlock(g_saver.mutex);
+        return true;
+    }
+    noe_mutex_unlock(g_saver.mutex);
+
+    size_t path_len = strlen(filepath);
+    char *path = NOE_MALLOC(path_len + 1);
+    if(!path) return false;
+    memcpy(path, filepath, path_len + 1);
+
+    noe_mutex_lock(g_saver.mutex);
+    // Past the limit every save would be another full copy of the image
+    while(g_saver.queued >= g_saver.max_queued && g_saver.policy == NOE_SAVE_BLOCK) {
+        noe_cond_wait(g_saver.job_done, g_saver.mutex);
+    }
+    if(g_saver.queued >= g_saver.max_queued) {
+        noe_mutex_unlock(g_saver.mutex);
+        NOE_FREE(path);
+        return false;
+    }
+    noe_SaveJob *job = noe_save_job_acquire(size);
+    int index = noe_save_context_index(ctx);
+    if(index < 0) index = noe_save_context_index(NULL);
+    if(!job || index < 0) {
+        if(job) noe_save_job_release(job);
+        noe_mutex_unlock(g_saver.mutex);
+        NOE_FREE(path);
+        return false;
+    }
+    if(g_saver.contexts[index].ctx != ctx) {
+        if(!noe_add_step_hook(ctx, noe_save_step_hook, NULL)) {
+            noe_save_job_release(job);
+            noe_mutex_unlock(g_saver.mutex);
+            NOE_FREE(path);
+            return false;
+        }
+        g_saver.contexts[index].ctx = ctx;
+    }
+    g_saver.contexts[index].pending += 1;
+    g_saver.queued += 1;
+    noe_mutex_unlock(g_saver.mutex);
+
+    // The copy is the only work done on the calling thread
+    noe_copy_packed(job->image.pixels, image);
+    job->image.w = image.w;
+    job->image.h = image.h;
+    job->image.format = image.format;
+    job->ctx = ctx;
+    job->filepath = path;
+    job->file_format = file_format;
+    job->callback = callback;
+    job->userdata = userdata;
+    job->ok = false;
+
+    noe_mutex_lock(g_saver.mutex);
+    noe_save_job_append(&g_saver.queue_head, &g_saver.queue_tail, job);
+    if(!g_saver.worker_running) {
+        // The previous worker ran out of work and is about to exit
+        if(g_saver.worker) noe_thread_join(g_saver.worker);
+        g_saver.worker = noe_thread_create(noe_save_worker, NULL);
+        g_saver.worker_running = g_saver.worker != NULL;
+    }
+    bool started = g_saver.worker_running;
+    noe_mutex_unlock(g_saver.mutex);
+
+    // No thread to be had, save right here rather than losing the image
+    if(!started) noe_save_worker(NULL);
+    return true;
+}
+
+void noe_image_save_wait(noe_Context *ctx)
+{
+    if(!noe_saver_ready()) return;
+    noe_mutex_lock(g_saver.mutex);
+    for(;;) {
+        int index = noe_save_context_index(ctx);
+        int done = 0;
+        for(noe_SaveJob *job = g_saver.done_head; job; job = job->next) done += job->ctx == ctx;
+        // With nothing else queued also wait for the worker to go idle so it gets reaped
+        bool idle = g_saver.queue_head || !g_saver.worker_running;
+        if(index < 0 || (done >= g_saver.contexts[index].pending && idle)) break;
+        noe_cond_wait(g_saver.job_done, g_saver.mutex);
+    }
+    noe_mutex_unlock(g_saver.mutex);
+    if(noe_save_drain(ctx) == 0) noe_remove_step_hook(ctx, noe_save_step_hook, NULL);
+}
+
+//////////////////////////////////////////////////////
+///
+/// Asset packs
+///
+/// Layout: a header, the entry payloads (each aligned to 16 bytes), the names
+/// and an index sorted by the FNV-1a hash of the name, so a lookup is a binary
+/// search. Images and fonts are stored already converted, an uncompressed
+/// entry is used in place from a copy on write mapping of the pack.
+///
+/// Compressed payloads use a small LZ77 format: every sequence is a token byte
+/// with the literal length in the high and the match length - 4 in the low
+/// nibble (15 means more length bytes follow, each adding up to 255), the
+/// literals and a 16 bit little endian match offset. The last sequence only has
+/// literals.
+///
+
+#define NOE_PACK_MAGIC 0x50454F4E // "NOEP"
+#define NOE_PACK_VERSION 1
+#define NOE_PACK_ALIGN 16
+#define NOE_PACK_COMPRESSED (1 << 0)
+#define NOE_LZ_MIN_MATCH 4
+#define NOE_LZ_MAX_EXPANSION 255 // output bytes per input byte at most
+#define NOE_LZ_HASH_BITS 14
+
+enum {
+    NOE_PACK_ENTRY_DATA = 0,
+    NOE_PACK_ENTRY_IMAGE,
+    NOE_PACK_ENTRY_FONT,
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entries_count;
+    uint32_t reserved;
+    uint64_t index_offset;
+    uint64_t strings_offset;
+} noe_PackHeader;
+
+typedef struct {
+    uint64_t hash;
+    uint32_t name_offset;
+    uint32_t name_len;
+    uint32_t kind;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t stored_size;
+    uint64_t size;
+} noe_PackEntry;
+
+// Precedes the pixels of image entries and the glyphs of font entries
+typedef struct {
+    uint32_t w, h;
+    uint32_t format;
+    uint32_t glyphs_count;
+} noe_PackImageHeader;
+
+struct noe_Pack {
+    noe_FileView view;
+    const noe_PackHeader *header;
+    const noe_PackEntry *entries;
+    const char *strings;
+    size_t strings_size;
+    uint8_t **decompressed; // per entry, filled the first time it is used
+};
+
+struct noe_PackWriter {
+    FILE *f;
+    noe_PackEntry *entries;
+    int entries_count;
+    int entries_capacity;
+    char *strings;
+    size_t strings_size;
+    size_t strings_capacity;
+    uint64_t offset;
+    bool failed;
+};
+
+static uint64_t noe_pack_hash(const char *name, size_t len)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t)name[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint8_t *noe_lz_put_length(uint8_t *op, size_t len)
+{
+    while(len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static size_t noe_lz_bound(size_t size)
+{
+    return size + size/255 + 16;
+}
+
+static uint8_t *noe_lz_put_sequence(uint8_t *op, const uint8_t *literals, size_t literals_len, size_t offset, size_t match_len)
+{
+    uint8_t *token = op++;
+    *token = (uint8_t)(NOE_MIN(literals_len, 15) << 4);
+    if(literals_len >= 15) op = noe_lz_put_length(op, literals_len - 15);
+    memcpy(op, literals, literals_len);
+    op += literals_len;
+    if(match_len == 0) return op;
+    *op++ = (uint8_t)(offset & 0xFF);
+    *op++ = (uint8_t)(offset >> 8);
+    match_len -= NOE_LZ_MIN_MATCH;
+    *token |= (uint8_t)NOE_MIN(match_len, 15);
+    if(match_len >= 15) op = noe_lz_put_length(op, match_len - 15);
+    return op;
+}
+
+// dst needs noe_lz_bound(size) bytes, returns the compressed size or 0 on failure
+static size_t noe_lz_compress(const uint8_t *src, size_t size, uint8_t *dst)
+{
+    if(size > UINT32_MAX) return 0;
+    uint32_t *table = NOE_MALLOC(sizeof(uint32_t) << NOE_LZ_HASH_BITS);
+    if(!table) return 0;
+    memset(table, 0, sizeof(uint32_t) << NOE_LZ_HASH_BITS);
+
+    uint8_t *op = dst;
+    size_t ip = 0, anchor = 0;
+    while(ip + NOE_LZ_MIN_MATCH <= size) {
+        uint32_t seq;
+        memcpy(&seq, src + ip, 4);
+        uint32_t h = (seq * 2654435761u) >> (32 - NOE_LZ_HASH_BITS);
+        size_t candidate = table[h];
+        table[h] = (uint32_t)ip;
+
+        uint32_t found;
+        memcpy(&found, src + candidate, 4);
+        if(candidate >= ip || ip - candidate > 0xFFFF || found != seq) {
+            ip += 1;
+            continue;
+        }
+        size_t len = NOE_LZ_MIN_MATCH;
+        while(ip + len < size && src[candidate + len] == src[ip + len]) len += 1;
+        op = noe_lz_put_sequence(op, src + anchor, ip - anchor, ip - candidate, len);
+        ip += len;
+        anchor = ip;
+    }
+    op = noe_lz_put_sequence(op, src + anchor, size - anchor, 0, 0);
+    NOE_FREE(table);
+    return op - dst;
+}
+
+static bool noe_lz_get_length(const uint8_t **ip, const uint8_t *end, size_t *len)
+{
+    uint8_t b;
+    do {
+        if(*ip >= end) return false;
+        b = *(*ip)++;
+        *len += b;
+    } while(b == 255);
+    return true;
+}
+
+static bool noe_lz_decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *ip = src, *end = src + size;
+    size_t op = 0;
+    while(ip < end) {
+        uint8_t token = *ip++;
+        size_t literals_len = token >> 4;
+        if(literals_len == 15 && !noe_lz_get_length(&ip, end, &literals_len)) return false;
+        if(literals_len > (size_t)(end - ip) || literals_len > dst_size - op) return false;
+        memcpy(dst + op, ip, literals_len);
+        ip += literals_len;
+        op += literals_len;
+        if(ip == end) break;
+
+        if(end - ip < 2) return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t match_len = token & 15;
+        if(match_len == 15 && !noe_lz_get_length(&ip, end, &match_len)) return false;
+        match_len += NOE_LZ_MIN_MATCH;
+        if(offset == 0 || offset > op || match_len > dst_size - op) return false;
+        // Byte by byte on purpose, matches may overlap what they produce
+        for(size_t i = 0; i < match_len; ++i, ++op) dst[op] = dst[op - offset];
+    }
+    return op == dst_size;
+}
+
+noe_PackWriter *noe_pack_writer_begin(const char *filepath)
+{
+    noe_PackWriter *writer = NOE_MALLOC(sizeof(*writer));
+    if(!writer) return NULL;
+    memset(writer, 0, sizeof(*writer));
+    writer->f = fopen(filepath, "wb");
+    if(!writer->f) {
+        NOE_FREE(writer);
+        return NULL;
+    }
+    noe_PackHeader header = {0};
+    writer->failed = fwrite(&header, sizeof(header), 1, writer->f) != 1;
+    writer->offset = sizeof(header);
+    return writer;
+}
+
+static bool noe_pack_writer_pad(noe_PackWriter *writer)
+{
+    static const uint8_t zeros[NOE_PACK_ALIGN] = {0};
+    size_t pad = (NOE_PACK_ALIGN - writer->offset % NOE_PACK_ALIGN) % NOE_PACK_ALIGN;
+    if(pad && fwrite(zeros, 1, pad, writer->f) != pad) return false;
+    writer->offset += pad;
+    return true;
+}
+
+// Takes the payload as a list of parts so headers don't need to be copied in front of the pixels
+static bool noe_pack_write_entry(noe_PackWriter *writer, const char *name, uint32_t kind,
+        const void **parts, const size_t *sizes, int parts_count, bool compress)
+{
+    if(writer->failed) return false;
+    size_t name_len = strlen(name);
+    size_t size = 0;
+    for(int i = 0; i < parts_count; ++i) size += sizes[i];
+
+    if(writer->entries_count == writer->entries_capacity) {
+        int capacity = writer->entries_capacity ? writer->entries_capacity * 2 : 64;
+        noe_PackEntry *entries = NOE_MALLOC(sizeof(*entries) * capacity);
+        if(!entries) {
+            writer->failed = true;
+            return false;
+        }
+        if(writer->entries) memcpy(entries, writer->entries, sizeof(*entries) * writer->entries_count);
+        NOE_FREE(writer->entries);
+        writer->entries = entries;
+        writer->entries_capacity = capacity;
+    }
+    if(writer->strings_size + name_len > writer->strings_capacity) {
+        size_t capacity = NOE_MAX(writer->strings_capacity * 2, writer->strings_size + name_len + 1024);
+        char *strings = NOE_MALLOC(capacity);
+        if(!strings) {
+            writer->failed = true;
+            return false;
+        }
+        if(writer->strings) memcpy(strings, writer->strings, writer->strings_size);
+        NOE_FREE(writer->strings);
+        writer->strings = strings;
+        writer->strings_capacity = capacity;
+    }
+
+    if(!noe_pack_writer_pad(writer)) {
+        writer->failed = true;
+        return false;
+    }
+    noe_PackEntry *entry = &writer->entries[writer->entries_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->hash = noe_pack_hash(name, name_len);
+    entry->name_offset = (uint32_t)writer->strings_size;
+    entry->name_len = (uint32_t)name_len;
+    entry->kind = kind;
+    entry->offset = writer->offset;
+    entry->size = size;
+    entry->stored_size = size;
+
+    bool written = false;
+    if(compress && size > 0) {
+        uint8_t *joined = NOE_MALLOC(size);
+        uint8_t *compressed = NOE_MALLOC(noe_lz_bound(size));
+        if(joined && compressed) {
+            size_t at = 0;
+            for(int i = 0; i < parts_count; ++i) {
+                memcpy(joined + at, parts[i], sizes[i]);
+                at += sizes[i];
+            }
+            size_t compressed_size = noe_lz_compress(joined, size, compressed);
+            // Not worth it when it barely shrinks, the entry could be used in place otherwise
+            if(compressed_size > 0 && compressed_size < size - size/8) {
+                if(fwrite(compressed, 1, compressed_size, writer->f) != compressed_size) writer->failed = true;
+                entry->flags |= NOE_PACK_COMPRESSED;
+                entry->stored_size = compressed_size;
+                written = true;
+            }
+        }
+        NOE_FREE(joined);
+        NOE_FREE(compressed);
+    }
+    for(int i = 0; !written && i < parts_count; ++i) {
+        if(sizes[i] && fwrite(parts[i], 1, sizes[i], writer->f) != sizes[i]) writer->failed = true;
+    }
+    if(writer->failed) return false;
+
+    memcpy(writer->strings + writer->strings_size, name, name_len);
+    writer->strings_size += name_len;
+    writer->offset += entry->stored_size;
+    writer->entries_count += 1;
+    return true;
+}
+
+bool noe_pack_write_data(noe_PackWriter *writer, const char *name, const void *data, size_t size, bool compress)
+{
+    const void *parts[] = { data };
+    size_t sizes[] = { size };
+    return noe_pack_write_entry(writer, name, NOE_PACK_ENTRY_DATA, parts, sizes, 1, compress);
+}
+
+bool noe_pack_write_image(noe_PackWriter *writer, const char *name, noe_Image image, bool compress)
+{
+    int chans = noe_pixelformat_channel_amount(image.format);
+    if(chans < 0 || !image.pixels) return false;
+    size_t pixels_size = (size_t)image.w * image.h * chans;
+    // Entries are always packed
+    uint8_t *packed = NULL;
+    if((size_t)noe_image_stride(image) != (size_t)image.w * chans) {
+        packed = NOE_MALLOC(pixels_size ? pixels_size : 1);
+        if(!packed) return false;
+        noe_copy_packed(packed, image);
+    }
+    noe_PackImageHeader header = { image.w, image.h, image.format, 0 };
+    const void *parts[] = { &header, packed ? packed : image.pixels };
+    size_t sizes[] = { sizeof(header), pixels_size };
+    bool ok = noe_pack_write_entry(writer, name, NOE_PACK_ENTRY_IMAGE, parts, sizes, 2, compress);
+    NOE_FREE(packed);
+    return ok;
+}
+
+bool noe_pack_write_font(noe_PackWriter *writer, const char *name, noe_Font font, bool compress)
+{
+    int chans = noe_pixelformat_channel_amount(font.atlas.format);
+    if(chans < 0 || !font.atlas.pixels) return false;
+    static const uint8_t zeros[NOE_PACK_ALIGN] = {0};
+    size_t glyphs_size = sizeof(noe_Glyph) * font.codepoints_count;
+    noe_PackImageHeader header = { font.atlas.w, font.atlas.h, font.atlas.format, font.codepoints_count };
+    // The atlas pixels start aligned like the ones of image entries
+    const void *parts[] = { &header, font.codepoints, zeros, font.atlas.pixels };
+    size_t sizes[] = {
+        sizeof(header), glyphs_size,
+        (NOE_PACK_ALIGN - glyphs_size % NOE_PACK_ALIGN) % NOE_PACK_ALIGN,
+        (size_t)font.atlas.w * font.atlas.h * chans,
+    };
+    return noe_pack_write_entry(writer, name, NOE_PACK_ENTRY_FONT, parts, sizes, 4, compress);
+}
+
+static int noe_pack_entry_compare(const void *a, const void *b)
+{
+    const noe_PackEntry *ea = a, *eb = b;
+    if(ea->hash != eb->hash) return ea->hash < eb->hash ? -1 : 1;
+    return 0;
+}
+
+bool noe_pack_writer_end(noe_PackWriter *writer)
+{
+    bool ok = !writer->failed;
+    if(ok) {
+        noe_PackHeader header = {0};
+        header.magic = NOE_PACK_MAGIC;
+        header.version = NOE_PACK_VERSION;
+        header.entries_count = writer->entries_count;
+        header.strings_offset = writer->offset;
+        if(writer->strings_size && fwrite(writer->strings, 1, writer->strings_size, writer->f) != writer->strings_size) ok = false;
+        writer->offset += writer->strings_size;
+        ok = ok && noe_pack_writer_pad(writer);
+        header.index_offset = writer->offset;
+        if(writer->entries_count) {
+            qsort(writer->entries, writer->entries_count, sizeof(*writer->entries), noe_pack_entry_compare);
+            if(fwrite(writer->entries, sizeof(*writer->entries), writer->entries_count, writer->f) != (size_t)writer->entries_count) ok = false;
+        }
+        ok = ok && fseek(writer->f, 0, SEEK_SET) == 0;
+        ok = ok && fwrite(&header, sizeof(header), 1, writer->f) == 1;
+    }
+    if(fclose(writer->f) != 0) ok = false;
+    NOE_FREE(writer->entries);
+    NOE_FREE(writer->strings);
+    NOE_FREE(writer);
+    return ok;
+}
+
+noe_Pack *noe_open_pack(const char *filepath)
+{
+    noe_Pack *pack = NOE_MALLOC(sizeof(*pack));
+    if(!pack) return NULL;
+    memset(pack, 0, sizeof(*pack));
+    if(!noe_map_file(filepath, &pack->view, true)) {
+        NOE_FREE(pack);
+        return NULL;
+    }
+
+    const noe_PackHeader *header = pack->view.data;
+    size_t size = pack->view.size;
+    bool valid = size >= sizeof(*header)
+        && header->magic == NOE_PACK_MAGIC && header->version == NOE_PACK_VERSION
+        && header->index_offset % NOE_PACK_ALIGN == 0
+        && header->index_offset <= size
+        && (size - header->index_offset) / sizeof(noe_PackEntry) >= header->entries_count
+        && header->strings_offset <= header->index_offset;
+    if(valid) {
+        pack->header = header;
+        pack->entries = (const noe_PackEntry *)((const uint8_t *)pack->view.data + header->index_offset);
+        pack->strings = (const char *)pack->view.data + header->strings_offset;
+        pack->strings_size = header->index_offset - header->strings_offset;
+        pack->decompressed = NOE_MALLOC(sizeof(*pack->decompressed) * NOE_MAX(header->entries_count, 1));
+        valid = pack->decompressed != NULL;
+    }
+    if(!valid) {
+        noe_unmap_file(&pack->view);
+        NOE_FREE(pack);
+        return NULL;
+    }
+    memset(pack->decompressed, 0, sizeof(*pack->decompressed) * header->entries_count);
+    return pack;
+}
+
+void noe_close_pack(noe_Pack *pack)
+{
+    if(!pack) return;
+    for(uint32_t i = 0; i < pack->header->entries_count; ++i) NOE_FREE(pack->decompressed[i]);
+    NOE_FREE(pack->decompressed);
+    noe_unmap_file(&pack->view);
+    NOE_FREE(pack);
+}
+
+static int noe_pack_find(noe_Pack *pack, const char *name)
+{
+    size_t len = strlen(name);
+    uint64_t hash = noe_pack_hash(name, len);
+    int lo = 0, hi = (int)pack->header->entries_count;
+    while(lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if(pack->entries[mid].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+    for(int i = lo; i < (int)pack->header->entries_count && pack->entries[i].hash == hash; ++i) {
+        const noe_PackEntry *entry = &pack->entries[i];
+        if(entry->name_len == len && (size_t)entry->name_offset + len <= pack->strings_size
+                && memcmp(pack->strings + entry->name_offset, name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// The payload of an entry, decompressed on first use when it has to be
+static const uint8_t *noe_pack_payload(noe_Pack *pack, const char *name, uint32_t kind, size_t *size)
+{
+    int index = noe_pack_find(pack, name);
+    if(index < 0) return NULL;
+    const noe_PackEntry *entry = &pack->entries[index];
+    if(entry->kind != kind || entry->offset > pack->header->strings_offset
+            || entry->stored_size > pack->header->strings_offset - entry->offset) {
+        return NULL;
+    }
+    const uint8_t *stored = (const uint8_t *)pack->view.data + entry->offset;
+    *size = entry->size;
+    if(!(entry->flags & NOE_PACK_COMPRESSED)) {
+        return entry->size == entry->stored_size ? stored : NULL;
+    }
+
+    if(!pack->decompressed[index]) {
+        // A length byte produces 255 bytes at most and nothing else produces
+        // more, so a larger size can only come from a damaged pack
+        if(entry->size > entry->stored_size * NOE_LZ_MAX_EXPANSION + 16) return NULL;
+        uint8_t *data = entry->size <= SIZE_MAX ? NOE_MALLOC(entry->size ? entry->size : 1) : NULL;
+        if(!data) return NULL;
+        if(!noe_lz_decompress(stored, entry->stored_size, data, entry->size)) {
+            NOE_FREE(data);
+            return NULL;
+        }
+        pack->decompressed[index] = data;
+    }
+    return pack->decompressed[index];
+}
+
+const void *noe_pack_data(noe_Pack *pack, const char *name, size_t *size)
+{
+    size_t payload_size = 0;
+    const uint8_t *payload = noe_pack_payload(pack, name, NOE_PACK_ENTRY_DATA, &payload_size);
+    if(size) *size = payload ? payload_size : 0;
+    return payload;
+}
+
+noe_Image noe_pack_image(noe_Pack *pack, const char *name)
+{
+    size_t size = 0;
+    const uint8_t *payload = noe_pack_payload(pack, name, NOE_PACK_ENTRY_IMAGE, &size);
+    noe_PackImageHeader header;
+    if(!payload || size < sizeof(header)) return (noe_Image){0};
+    memcpy(&header, payload, sizeof(header));
+    int chans = noe_pixelformat_channel_amount(header.format);
+    if(chans < 0 || (uint64_t)header.w * header.h * chans != size - sizeof(header)) return (noe_Image){0};
+    return noe_load_image((uint8_t *)payload + sizeof(header), header.w, header.h, header.format);
+}
+
+noe_Font noe_pack_font(noe_Pack *pack, const char *name)
+{
+    size_t size = 0;
+    const uint8_t *payload = noe_pack_payload(pack, name, NOE_PACK_ENTRY_FONT, &size);
+    noe_PackImageHeader header;
+    if(!payload || size < sizeof(header)) return (noe_Font){0};
+    memcpy(&header, payload, sizeof(header));
+    int chans = noe_pixelformat_channel_amount(header.format);
+    uint64_t glyphs_size = (uint64_t)sizeof(noe_Glyph) * header.glyphs_count;
+    uint64_t pixels_offset = sizeof(header) + glyphs_size;
+    pixels_offset += (NOE_PACK_ALIGN - glyphs_size % NOE_PACK_ALIGN) % NOE_PACK_ALIGN;
+    if(chans < 0 || pixels_offset + (uint64_t)header.w * header.h * chans != size) return (noe_Font){0};
+
+    noe_Image atlas = noe_load_image((uint8_t *)payload + pixels_offset, header.w, header.h, header.format);
+    return noe_load_font(atlas, (noe_Glyph *)(payload + sizeof(header)), header.glyphs_count);
+}
+
+//////////////////////////////////////////////////////
+///
+/// Collision grid
+///
+/// Entities only keep their rect, the cells are rebuilt from scratch by a
+/// counting sort of every (cell, entity) reference the first time they are
+/// needed after a change, which is linear and touches memory in order. Each
+/// cell keeps a copy of its rects next to the ids, so the pair test reads
+/// one flat array. An overlap is reported only by the cell holding the top
+/// left corner of the intersection, both rects always cover that one, so
+/// nothing needs deduplicating and queries don't write to the grid.
+///
+
+#define NOE_GRID_MAX_THREADS 16
+#define NOE_GRID_MIN_THREAD_IDS 8192 // fewer entities per thread don't pay for the thread
+
+struct noe_Grid {
+    noe_Rect bounds;
+    int cell_size;
+    int cols, rows;
+
+    // By id
+    noe_Rect *rects;
+    uint8_t *alive;
+    int *next_free;
+    int ids_capacity;
+    int ids_used; // every id below was handed out at some point
+    int free_head;
+    int count;
+
+    // Cell c holds cell_ids[cell_start[c]..cell_start[c + 1]], sorted by id
+    int *cell_start;
+    int *cell_ids;
+    noe_Rect *cell_rects;
+    int refs_capacity;
+    int *cursors; // a row of cells per build thread
+    int cursors_rows;
+    bool dirty;
+};
+
+typedef struct noe_GridBuildJob {
+    noe_Grid *grid;
+    int *cursor;
+    int begin, end;
+    int refs;
+} noe_GridBuildJob;
+
+static inline int noe_grid_cell(const noe_Grid *grid, int v, int cells)
+{
+    int c = v >= 0 ? v / grid->cell_size : -((grid->cell_size - 1 - v) / grid->cell_size);
+    return NOE_CLAMP(c, 0, cells - 1);
+}
+
+static bool noe_grid_span(const noe_Grid *grid, noe_Rect r, int *x0, int *y0, int *x1, int *y1)
+{
+    if(r.w <= 0 || r.h <= 0) return false;
+    int x = r.x - grid->bounds.x, y = r.y - grid->bounds.y;
+    *x0 = noe_grid_cell(grid, x, grid->cols);
+    *y0 = noe_grid_cell(grid, y, grid->rows);
+    *x1 = noe_grid_cell(grid, x + r.w - 1, grid->cols);
+    *y1 = noe_grid_cell(grid, y + r.h - 1, grid->rows);
+    return true;
+}
+
+// Border cells reach on past the bounds, matching the clamping of noe_grid_cell
+static inline bool noe_grid_cell_contains(const noe_Grid *grid, int x, int y, int px, int py)
+{
+    int left = grid->bounds.x + x * grid->cell_size, top = grid->bounds.y + y * grid->cell_size;
+    return (x == 0 || px >= left) && (x == grid->cols - 1 || px < left + grid->cell_size)
+        && (y == 0 || py >= top) && (y == grid->rows - 1 || py < top + grid->cell_size);
+}
+
+// Without short circuits, the compiler gets one hard to predict branch instead of four
+static inline bool noe_rects_overlap(noe_Rect a, noe_Rect b)
+{
+    return (a.x < b.x + b.w) & (b.x < a.x + a.w) & (a.y < b.y + b.h) & (b.y < a.y + a.h);
+}
+
+// Unlike realloc the old array is only freed once the new one exists
+static bool noe_grid_grow(void **array, size_t item_size, size_t count, size_t capacity)
+{
+    void *grown = NOE_MALLOC(item_size * capacity);
+    if(!grown) return false;
+    if(*array) memcpy(grown, *array, item_size * count);
+    NOE_FREE(*array);
+    *array = grown;
+    return true;
+}
+
+noe_Grid *noe_create_grid(noe_Rect bounds, int cell_size)
+{
+    if(cell_size <= 0 || bounds.w <= 0 || bounds.h <= 0) return NULL;
+    noe_Grid *grid = NOE_MALLOC(sizeof(*grid));
+    if(!grid) return NULL;
+    memset(grid, 0, sizeof(*grid));
+    grid->bounds = bounds;
+    grid->cell_size = cell_size;
+    grid->cols = (bounds.w + cell_size - 1) / cell_size;
+    grid->rows = (bounds.h + cell_size - 1) / cell_size;
+    grid->free_head = -1;
+    grid->cell_start = NOE_MALLOC(sizeof(int) * ((size_t)grid->cols * grid->rows + 1));
+    if(!grid->cell_start) {
+        NOE_FREE(grid);
+        return NULL;
+    }
+    memset(grid->cell_start, 0, sizeof(int) * ((size_t)grid->cols * grid->rows + 1));
+    return grid;
+}
+
+void noe_destroy_grid(noe_Grid *grid)
+{
+    if(!grid) return;
+    NOE_FREE(grid->rects);
+    NOE_FREE(grid->alive);
+    NOE_FREE(grid->next_free);
+    NOE_FREE(grid->cell_start);
+    NOE_FREE(grid->cell_ids);
+    NOE_FREE(grid->cell_rects);
+    NOE_FREE(grid->cursors);
+    NOE_FREE(grid);
+}
+
+int noe_grid_insert(noe_Grid *grid, noe_Rect rect)
+{
+    int id = grid->free_head;
+    if(id >= 0) {
+        grid->free_head = grid->next_free[id];
+    } else {
+        if(grid->ids_used == grid->ids_capacity) {
+            int capacity = grid->ids_capacity ? grid->ids_capacity * 2 : 256;
+            // Whatever did grow stays grown, the capacity only moves once all of them did
+            if(!noe_grid_grow((void **)&grid->rects, sizeof(noe_Rect), grid->ids_capacity, capacity)
+                    || !noe_grid_grow((void **)&grid->alive, 1, grid->ids_capacity, capacity)
+                    || !noe_grid_grow((void **)&grid->next_free, sizeof(int), grid->ids_capacity, capacity)) {
+                return -1;
+            }
+            grid->ids_capacity = capacity;
+        }
+        id = grid->ids_used++;
+    }
+    grid->rects[id] = rect;
+    grid->alive[id] = 1;
+    grid->count += 1;
+    grid->dirty = true;
+    return id;
+}
+
+void noe_grid_move(noe_Grid *grid, int id, noe_Rect rect)
+{
+    if(id < 0 || id >= grid->ids_used || !grid->alive[id]) return;
+    grid->rects[id] = rect;
+    grid->dirty = true;
+}
+
+void noe_grid_remove(noe_Grid *grid, int id)
+{
+    if(id < 0 || id >= grid->ids_used || !grid->alive[id]) return;
+    grid->alive[id] = 0;
+    grid->next_free[id] = grid->free_head;
+    grid->free_head = id;
+    grid->count -= 1;
+    grid->dirty = true;
+}
+
+noe_Rect noe_grid_rect(noe_Grid *grid, int id)
+{
+    if(id < 0 || id >= grid->ids_used || !grid->alive[id]) return noe_rect(0, 0, 0, 0);
+    return grid->rects[id];
+}
+
+int noe_grid_count(noe_Grid *grid)
+{
+    return grid->count;
+}
+
+// Counts the references of the ids of a job into its cursor row
+static int noe_grid_count_range(void *arg)
+{
+    noe_GridBuildJob *job = arg;
+    const noe_Grid *grid = job->grid;
+    int refs = 0, x0, y0, x1, y1;
+    for(int id = job->begin; id < job->end; ++id) {
+        if(!grid->alive[id] || !noe_grid_span(grid, grid->rects[id], &x0, &y0, &x1, &y1)) continue;
+        for(int y = y0; y <= y1; ++y) {
+            int *row = job->cursor + y * grid->cols;
+            for(int x = x0; x <= x1; ++x) row[x] += 1;
+        }
+        refs += (x1 - x0 + 1) * (y1 - y0 + 1);
+    }
+    job->refs = refs;
+    return 0;
+}
+
+// Writes the references of the ids of a job where its cursor row points
+static int noe_grid_fill_range(void *arg)
+{
+    noe_GridBuildJob *job = arg;
+    const noe_Grid *grid = job->grid;
+    int x0, y0, x1, y1;
+    for(int id = job->begin; id < job->end; ++id) {
+        if(!grid->alive[id] || !noe_grid_span(grid, grid->rects[id], &x0, &y0, &x1, &y1)) continue;
+        noe_Rect rect = grid->rects[id];
+        for(int y = y0; y <= y1; ++y) {
+            int *row = job->cursor + y * grid->cols;
+            for(int x = x0; x <= x1; ++x) {
+                int at = row[x]++;
+                grid->cell_ids[at] = id;
+                grid->cell_rects[at] = rect;
+            }
+        }
+    }
+    return 0;
+}
+
+// Runs fn on every job, the calling thread takes the first one
+static void noe_grid_run_jobs(noe_GridBuildJob *jobs, int count, int (*fn)(void *))
+{
+    noe_Thread *workers[NOE_GRID_MAX_THREADS] = {0};
+    for(int i = 1; i < count; ++i) workers[i] = noe_thread_create(fn, &jobs[i]);
+    for(int i = 0; i < count; ++i) {
+        if(i == 0 || !workers[i]) fn(&jobs[i]);
+    }
+    for(int i = 1; i < count; ++i) {
+        if(workers[i]) noe_thread_join(workers[i]);
+    }
+}
+
+bool noe_grid_build(noe_Grid *grid, int threads)
+{
+    if(!grid->dirty) return true;
+    if(threads <= 0) threads = noe_cpu_count();
+    threads = NOE_CLAMP(threads, 1, NOE_GRID_MAX_THREADS);
+    threads = NOE_CLAMP(grid->ids_used / NOE_GRID_MIN_THREAD_IDS, 1, threads);
+
+    int cells = grid->cols * grid->rows;
+    if(grid->cursors_rows < threads) {
+        int *cursors = NOE_MALLOC(sizeof(int) * (size_t)cells * threads);
+        if(!cursors) return false;
+        NOE_FREE(grid->cursors);
+        grid->cursors = cursors;
+        grid->cursors_rows = threads;
+    }
+    memset(grid->cursors, 0, sizeof(int) * (size_t)cells * threads);
+
+    noe_GridBuildJob jobs[NOE_GRID_MAX_THREADS];
+    for(int i = 0; i < threads; ++i) {
+        jobs[i].grid = grid;
+        jobs[i].cursor = grid->cursors + (size_t)cells * i;
+        jobs[i].begin = (int)((int64_t)grid->ids_used * i / threads);
+        jobs[i].end = (int)((int64_t)grid->ids_used * (i + 1) / threads);
+        jobs[i].refs = 0;
+    }
+    noe_grid_run_jobs(jobs, threads, noe_grid_count_range);
+
+    int64_t refs = 0;
+    for(int i = 0; i < threads; ++i) refs += jobs[i].refs;
+    if(refs > INT_MAX) return false;
+    if(refs > grid->refs_capacity) {
+        int capacity = NOE_MAX((int)refs, grid->refs_capacity + grid->refs_capacity / 2);
+        int *ids = NOE_MALLOC(sizeof(int) * (size_t)capacity);
+        noe_Rect *rects = NOE_MALLOC(sizeof(noe_Rect) * (size_t)capacity);
+        if(!ids || !rects) {
+            NOE_FREE(ids);
+            NOE_FREE(rects);
+            return false;
+        }
+        NOE_FREE(grid->cell_ids);
+        NOE_FREE(grid->cell_rects);
+        grid->cell_ids = ids;
+        grid->cell_rects = rects;
+        grid->refs_capacity = capacity;
+    }
+
+    // Turn the counts into where each thread starts writing into each cell,
+    // threads own increasing ids so every cell ends up sorted by id
+    int at = 0;
+    for(int c = 0; c < cells; ++c) {
+        grid->cell_start[c] = at;
+        for(int i = 0; i < threads; ++i) {
+            int n = jobs[i].cursor[c];
+            jobs[i].cursor[c] = at;
+            at += n;
+        }
+    }
+    grid->cell_start[cells] = at;
+    noe_grid_run_jobs(jobs, threads, noe_grid_fill_range);
+    grid->dirty = false;
+    return true;
+}
+
+int noe_grid_query(noe_Grid *grid, noe_Rect region, int *ids, int max_ids)
+{
+    int x0, y0, x1, y1;
+    if(!noe_grid_build(grid, 1) || !noe_grid_span(grid, region, &x0, &y0, &x1, &y1)) return 0;
+    int found = 0;
+    for(int y = y0; y <= y1; ++y) {
+        for(int x = x0; x <= x1; ++x) {
+            int c = y * grid->cols + x;
+            for(int i = grid->cell_start[c]; i < grid->cell_start[c + 1]; ++i) {
+                noe_Rect r = grid->cell_rects[i];
+                if(!noe_rects_overlap(r, region)) continue;
+                // Only the cell of the top left corner of the overlap reports it
+                if(!noe_grid_cell_contains(grid, x, y, NOE_MAX(r.x, region.x), NOE_MAX(r.y, region.y))) continue;
+                if(found < max_ids) ids[found] = grid->cell_ids[i];
+                found += 1;
+            }
+        }
+    }
+    return found;
+}
+
+int noe_grid_pairs(noe_Grid *grid, noe_GridPair *pairs, int max_pairs)
+{
+    if(!noe_grid_build(grid, 1)) return 0;
+    int found = 0;
+    for(int y = 0; y < grid->rows; ++y) {
+        for(int x = 0; x < grid->cols; ++x) {
+            int c = y * grid->cols + x;
+            int begin = grid->cell_start[c], end = grid->cell_start[c + 1];
+            for(int i = begin; i < end; ++i) {
+                noe_Rect a = grid->cell_rects[i];
+                for(int j = i + 1; j < end; ++j) {
+                    noe_Rect b = grid->cell_rects[j];
+                    if(!noe_rects_overlap(a, b)) continue;
+                    if(!noe_grid_cell_contains(grid, x, y, NOE_MAX(a.x, b.x), NOE_MAX(a.y, b.y))) continue;
+                    if(found < max_pairs) {
+                        pairs[found].a = grid->cell_ids[i];
+                        pairs[found].b = grid->cell_ids[j];
+                    }
+                    found += 1;
+                }
+            }
+        }
+    }
+    return found;
+}
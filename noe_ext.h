@@ -8,8 +8,162 @@
 
 #include "noe.h"
 
+#define NOE_PNG_DEFAULT_LEVEL 6
+
+enum noe_png_result {
+    NOE_PNG_OK = 0,
+    NOE_PNG_ERROR_FORMAT,
+    NOE_PNG_ERROR_MEMORY,
+    NOE_PNG_ERROR_IO,
+};
+
 bool noe_image_save_to_pngfile(noe_Image image, const char *filepath);
+// level goes from 0 (stored, fastest) to 9 (smallest). The rows are encoded in
+// bands on up to threads threads, 0 uses one per core. Returns a noe_png_result.
+int noe_image_write_png(noe_Image image, const char *filepath, int level, int threads);
+const char *noe_png_error_string(int error);
+// QOI is lossless like PNG but encodes and decodes many times faster, meant for
+// frame dumps and assets during development. The write callback gets the
+// output in pieces as it is produced and returns false to abort.
+typedef bool (*noe_WriteFunc)(void *userdata, const void *data, size_t size);
+bool noe_image_save_to_qoifile(noe_Image image, const char *filepath);
+bool noe_image_write_qoi(noe_Image image, noe_WriteFunc write, void *userdata);
+// Returns the size written or 0 when it doesn't fit, noe_qoi_max_size() always fits
+size_t noe_image_encode_qoi(noe_Image image, void *buffer, size_t capacity);
+size_t noe_qoi_max_size(noe_Image image);
+// Decodes QOI, PNG, JPEG, BMP, TGA, GIF, PSD, HDR or PNM straight into the requested
+// noe_pixelformat. Returns an image without pixels when it fails.
+noe_Image noe_load_image_from_file(const char *filepath, int format);
+noe_Image noe_load_image_from_memory(const void *data, size_t size, int format);
+// Reads the dimensions and channel count of the file without decoding it
+bool noe_probe_image_file(const char *filepath, int *w, int *h, int *channels);
+bool noe_probe_image_from_memory(const void *data, size_t size, int *w, int *h, int *channels);
 noe_Font noe_load_font_from_ttf(const char *filepath, int fontsz);
 void noe_font_to_c_header(noe_Font font, const char *filepath);
 
+// Saves a copy of the image on a background thread, the copy is all the caller
+// pays for. The callback runs on the thread calling noe_step, during the first
+// noe_step after the file was written. Saving to a file that is still queued
+// with the same callback replaces the image to write, the callback runs once.
+// Call noe_image_save_wait before noe_close to make sure every save got written
+// and reported.
+enum noe_image_file {
+    NOE_IMAGE_FILE_PNG = 0,
+    NOE_IMAGE_FILE_QOI,
+};
+
+// What a save does while max_queued saves are already waiting to be written
+enum noe_save_policy {
+    NOE_SAVE_BLOCK = 0, // wait for the worker to finish one (the default)
+    NOE_SAVE_DROP,      // don't queue it, noe_image_save_async returns false
+};
+
+typedef void (*noe_SaveCallback)(const char *filepath, bool ok, void *userdata);
+bool noe_image_save_async(noe_Context *ctx, noe_Image image, const char *filepath, int file_format,
+        noe_SaveCallback callback, void *userdata); // false when it couldn't even be queued
+void noe_image_save_wait(noe_Context *ctx);
+void noe_image_save_set_limit(int max_queued, int policy); // 4 and NOE_SAVE_BLOCK by default
+
+// Records the window to a video file. Once begun, every noe_step hands the
+// finished canvas to a writer thread which converts and writes it, frames keep
+// the size the window had when the recording began. NOE_VIDEO_Y4M is 4:2:0
+// YUV playable by ffmpeg, mpv or VLC. NOE_VIDEO_RAW is the canvas pixels as they
+// are (ffmpeg -f rawvideo -pix_fmt bgra -s WxH).
+typedef struct noe_VideoRecorder noe_VideoRecorder;
+
+enum noe_video_container {
+    NOE_VIDEO_Y4M = 0,
+    NOE_VIDEO_RAW,
+};
+
+// What noe_step does while the writer is behind and no buffer is free
+enum noe_video_policy {
+    NOE_VIDEO_DROP = 0, // skip the frame, the video runs shorter than the session
+    NOE_VIDEO_BLOCK,    // wait for the writer, the game slows down instead
+};
+
+typedef struct noe_VideoRecordStats {
+    uint64_t frames_captured;
+    uint64_t frames_written;
+    uint64_t frames_dropped;
+    double capture_time;     // added to the last noe_step, in seconds
+    double max_capture_time;
+    double blocked_time;     // total spent waiting for the writer
+} noe_VideoRecordStats;
+
+// fps only goes into the Y4M header, 0 takes the target fps of the context or 60
+noe_VideoRecorder *noe_video_record_begin(noe_Context *ctx, const char *filepath, int container, double fps, int policy);
+bool noe_video_record_end(noe_VideoRecorder *rec); // writes what is queued, false when anything failed
+noe_VideoRecordStats noe_video_record_stats(noe_VideoRecorder *rec);
+
+// Loads images and fonts on a pool of worker threads. Every submit returns a
+// handle right away, the decoded asset is handed back by noe_asset_loader_poll
+// which is meant to be called once per frame and never blocks on a decode.
+typedef struct noe_AssetLoader noe_AssetLoader;
+typedef uint32_t noe_AssetHandle; // 0 when the submit failed
+
+enum noe_asset_kind {
+    NOE_ASSET_IMAGE = 0,
+    NOE_ASSET_FONT,
+};
+
+typedef struct noe_AssetResult {
+    noe_AssetHandle handle;
+    int kind;
+    bool ok;
+    void *userdata;
+    noe_Image image; // NOE_ASSET_IMAGE
+    noe_Font font;   // NOE_ASSET_FONT
+} noe_AssetResult;
+
+noe_AssetLoader *noe_create_asset_loader(int workers); // 0 or less uses one per core but the calling one
+void noe_destroy_asset_loader(noe_AssetLoader *loader); // drops queued jobs and unloads unpolled assets
+noe_AssetHandle noe_load_image_async(noe_AssetLoader *loader, const char *filepath, int format, void *userdata);
+noe_AssetHandle noe_load_font_async(noe_AssetLoader *loader, const char *filepath, int fontsz, void *userdata);
+int noe_asset_loader_poll(noe_AssetLoader *loader, noe_AssetResult *results, int max_results);
+int noe_asset_loader_pending(noe_AssetLoader *loader); // submitted but not polled yet
+
+// A pack holds many assets in one file. Images and fonts are stored in their
+// final pixel format, so unless an entry was compressed what these return
+// points straight into a copy on write mapping of the pack. Everything they
+// return is owned by the pack and stays valid until it is closed, don't unload it.
+typedef struct noe_Pack noe_Pack;
+typedef struct noe_PackWriter noe_PackWriter;
+
+noe_Pack *noe_open_pack(const char *filepath);
+void noe_close_pack(noe_Pack *pack);
+const void *noe_pack_data(noe_Pack *pack, const char *name, size_t *size);
+noe_Image noe_pack_image(noe_Pack *pack, const char *name); // no pixels when it isn't in the pack
+noe_Font noe_pack_font(noe_Pack *pack, const char *name);
+
+noe_PackWriter *noe_pack_writer_begin(const char *filepath);
+bool noe_pack_write_data(noe_PackWriter *writer, const char *name, const void *data, size_t size, bool compress);
+bool noe_pack_write_image(noe_PackWriter *writer, const char *name, noe_Image image, bool compress);
+bool noe_pack_write_font(noe_PackWriter *writer, const char *name, noe_Font font, bool compress);
+bool noe_pack_writer_end(noe_PackWriter *writer); // false when anything failed to be written
+
+// A uniform grid over rects for collision queries. Inserts, moves and removes
+// only touch the rect of an id, the cells are rebuilt in linear time by the
+// first query after a change, or ahead of time by noe_grid_build. A cell size
+// around the size of a typical rect keeps the pair tests per cell low.
+// Rects reaching out of the bounds are clamped into the border cells, which
+// stays correct but gets slow when many of them end up there.
+typedef struct noe_Grid noe_Grid;
+typedef struct noe_GridPair { int a, b; } noe_GridPair; // a < b
+
+noe_Grid *noe_create_grid(noe_Rect bounds, int cell_size);
+void noe_destroy_grid(noe_Grid *grid);
+int noe_grid_insert(noe_Grid *grid, noe_Rect rect); // returns the id, -1 when out of memory
+void noe_grid_move(noe_Grid *grid, int id, noe_Rect rect);
+void noe_grid_remove(noe_Grid *grid, int id); // the id is reused by a later insert
+noe_Rect noe_grid_rect(noe_Grid *grid, int id);
+int noe_grid_count(noe_Grid *grid);
+// Rebuilds the cells if anything changed, split across threads (0 uses one
+// per core) when there are enough rects. False when out of memory.
+bool noe_grid_build(noe_Grid *grid, int threads);
+// Both return how many were found but write at most max of them. Every
+// overlap is found once, rects without area never overlap anything.
+int noe_grid_query(noe_Grid *grid, noe_Rect region, int *ids, int max_ids);
+int noe_grid_pairs(noe_Grid *grid, noe_GridPair *pairs, int max_pairs);
+
 #endif // NOE_EXT_STBTT_H_
@@ -0,0 +1,253 @@
+#include <string.h>
+#include "noe_microui.h"
+#include "noe.h"
+
+static int noe_mu_text_width(mu_Font font, const char *str, int len)
+{
+    const noe_Font *f = font;
+    if(len < 0) len = (int)strlen(str);
+    int width = 0;
+    for(int i = 0; i < len; ++i) {
+        int index = (unsigned char)str[i] - 32;
+        if(index < 0 || index >= (int)f->codepoints_count) continue;
+        width += f->codepoints[index].r - f->codepoints[index].l;
+    }
+    return width;
+}
+
+static int noe_mu_text_height(mu_Font font)
+{
+    const noe_Font *f = font;
+    return f->atlas.h;
+}
+
+static void noe_mu_bake_icons(noe_MuRenderer *r)
+{
+    const float s = NOE_MU_ICON_SIZE;
+    r->icons = noe_create_image(NOE_MU_ICON_SIZE * MU_ICON_MAX, NOE_MU_ICON_SIZE, NOE_PIXELFORMAT_GRAYSCALE);
+    noe_image_draw_rect(r->icons, NOE_BLACK, noe_rect(0, 0, r->icons.w, r->icons.h));
+
+    noe_Path *path = noe_create_path();
+    float x = MU_ICON_CLOSE * s;
+    noe_path_move_to(path, x + s*0.25f, s*0.25f);
+    noe_path_line_to(path, x + s*0.75f, s*0.75f);
+    noe_path_move_to(path, x + s*0.75f, s*0.25f);
+    noe_path_line_to(path, x + s*0.25f, s*0.75f);
+    noe_image_stroke_path(r->icons, NOE_WHITE, path, 2.0f);
+
+    noe_path_clear(path);
+    x = MU_ICON_CHECK * s;
+    noe_path_move_to(path, x + s*0.22f, s*0.52f);
+    noe_path_line_to(path, x + s*0.42f, s*0.72f);
+    noe_path_line_to(path, x + s*0.78f, s*0.30f);
+    noe_image_stroke_path(r->icons, NOE_WHITE, path, 2.0f);
+
+    noe_path_clear(path);
+    x = MU_ICON_COLLAPSED * s;
+    noe_path_move_to(path, x + s*0.35f, s*0.25f);
+    noe_path_line_to(path, x + s*0.70f, s*0.50f);
+    noe_path_line_to(path, x + s*0.35f, s*0.75f);
+    noe_path_close(path);
+    noe_image_fill_path(r->icons, NOE_WHITE, path, NOE_FILL_NONZERO);
+
+    noe_path_clear(path);
+    x = MU_ICON_EXPANDED * s;
+    noe_path_move_to(path, x + s*0.25f, s*0.35f);
+    noe_path_line_to(path, x + s*0.75f, s*0.35f);
+    noe_path_line_to(path, x + s*0.50f, s*0.70f);
+    noe_path_close(path);
+    noe_image_fill_path(r->icons, NOE_WHITE, path, NOE_FILL_NONZERO);
+
+    noe_destroy_path(path);
+}
+
+void noe_mu_init(noe_MuRenderer *r, mu_Context *mu, noe_Font font)
+{
+    memset(r, 0, sizeof(*r));
+    r->font = font;
+    r->clear_color = noe_rgb(0x20, 0x20, 0x20);
+    noe_mu_bake_icons(r);
+    mu->text_width = noe_mu_text_width;
+    mu->text_height = noe_mu_text_height;
+    mu->style->font = &r->font;
+}
+
+void noe_mu_deinit(noe_MuRenderer *r)
+{
+    noe_unload_image(r->icons);
+    memset(r, 0, sizeof(*r));
+}
+
+// Writes the codepoint and a NUL into out, false when it isn't a valid one
+static bool noe_mu_encode_utf8(int codepoint, char out[5])
+{
+    unsigned char *s = (unsigned char *)out;
+    if(codepoint < 0 || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) return false;
+    if(codepoint < 0x80) {
+        *s++ = (unsigned char)codepoint;
+    } else if(codepoint < 0x800) {
+        *s++ = (unsigned char)(0xC0 | (codepoint >> 6));
+        *s++ = (unsigned char)(0x80 | (codepoint & 0x3F));
+    } else if(codepoint < 0x10000) {
+        *s++ = (unsigned char)(0xE0 | (codepoint >> 12));
+        *s++ = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+        *s++ = (unsigned char)(0x80 | (codepoint & 0x3F));
+    } else {
+        *s++ = (unsigned char)(0xF0 | (codepoint >> 18));
+        *s++ = (unsigned char)(0x80 | ((codepoint >> 12) & 0x3F));
+        *s++ = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+        *s++ = (unsigned char)(0x80 | (codepoint & 0x3F));
+    }
+    *s = 0;
+    return true;
+}
+
+void noe_mu_input(noe_Context *ctx, mu_Context *mu)
+{
+    static const struct { int noe; int mu; } buttons[] = {
+        { NOE_BUTTON_LEFT,   MU_MOUSE_LEFT   },
+        { NOE_BUTTON_RIGHT,  MU_MOUSE_RIGHT  },
+        { NOE_BUTTON_MIDDLE, MU_MOUSE_MIDDLE },
+    };
+    static const struct { int noe; int mu; } keys[] = {
+        { NOE_KEY_SHIFT,     MU_KEY_SHIFT     },
+        { NOE_KEY_CONTROL,   MU_KEY_CTRL      },
+        { NOE_KEY_ALT,       MU_KEY_ALT       },
+        { NOE_KEY_BACKSPACE, MU_KEY_BACKSPACE },
+        { NOE_KEY_ENTER,     MU_KEY_RETURN    },
+    };
+
+    noe_Vec2 cursor = noe_cursor_pos(ctx);
+    int mx = (int)cursor.x, my = (int)cursor.y;
+    mu_input_mousemove(mu, mx, my);
+    for(size_t i = 0; i < sizeof(buttons)/sizeof(buttons[0]); ++i) {
+        if(noe_button_pressed(ctx, buttons[i].noe)) mu_input_mousedown(mu, mx, my, buttons[i].mu);
+        if(noe_button_released(ctx, buttons[i].noe)) mu_input_mouseup(mu, mx, my, buttons[i].mu);
+    }
+    for(size_t i = 0; i < sizeof(keys)/sizeof(keys[0]); ++i) {
+        if(noe_key_pressed(ctx, keys[i].noe)) mu_input_keydown(mu, keys[i].mu);
+        if(noe_key_released(ctx, keys[i].noe)) mu_input_keyup(mu, keys[i].mu);
+    }
+
+    // Wheel up scrolls the content up, microui counts down as positive
+    noe_Vec2 wheel = noe_wheel_delta(ctx);
+    if(wheel.x != 0.0f || wheel.y != 0.0f) {
+        mu_input_scroll(mu, (int)(wheel.x * NOE_MU_SCROLL_SPEED), (int)(-wheel.y * NOE_MU_SCROLL_SPEED));
+    }
+
+    // Typed characters go in as UTF-8, microui keeps up to 32 bytes per frame
+    int count = 0;
+    const noe_Event *events = noe_get_events(ctx, &count);
+    char text[5];
+    for(int i = 0; i < count; ++i) {
+        if(events[i].type != NOE_EVENT_TEXT) continue;
+        if(noe_mu_encode_utf8(events[i].code, text)) mu_input_text(mu, text);
+    }
+}
+
+void noe_mu_invalidate(noe_MuRenderer *r)
+{
+    r->has_frame = false;
+}
+
+static uint64_t noe_mu_hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for(size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// FNV-1a over every command that will be executed, jumps are resolved by
+// mu_next_command so only the visible order of the commands matters. Only the
+// fields that get drawn are hashed, a text command is followed by whatever
+// was in the command buffer before, past its NUL and in its padding.
+static uint64_t noe_mu_hash_commands(mu_Context *mu)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    mu_Command *cmd = NULL;
+    while(mu_next_command(mu, &cmd)) {
+        hash = noe_mu_hash_bytes(hash, &cmd->type, sizeof(cmd->type));
+        switch(cmd->type) {
+            case MU_COMMAND_CLIP:
+                hash = noe_mu_hash_bytes(hash, &cmd->clip.rect, sizeof(cmd->clip.rect));
+                break;
+            case MU_COMMAND_RECT:
+                hash = noe_mu_hash_bytes(hash, &cmd->rect.rect, sizeof(cmd->rect.rect));
+                hash = noe_mu_hash_bytes(hash, &cmd->rect.color, sizeof(cmd->rect.color));
+                break;
+            case MU_COMMAND_TEXT:
+                hash = noe_mu_hash_bytes(hash, &cmd->text.font, sizeof(cmd->text.font));
+                hash = noe_mu_hash_bytes(hash, &cmd->text.pos, sizeof(cmd->text.pos));
+                hash = noe_mu_hash_bytes(hash, &cmd->text.color, sizeof(cmd->text.color));
+                // The NUL too, so two texts in a row hash apart from their concatenation
+                hash = noe_mu_hash_bytes(hash, cmd->text.str, strlen(cmd->text.str) + 1);
+                break;
+            case MU_COMMAND_ICON:
+                hash = noe_mu_hash_bytes(hash, &cmd->icon.rect, sizeof(cmd->icon.rect));
+                hash = noe_mu_hash_bytes(hash, &cmd->icon.id, sizeof(cmd->icon.id));
+                hash = noe_mu_hash_bytes(hash, &cmd->icon.color, sizeof(cmd->icon.color));
+                break;
+        }
+    }
+    return hash;
+}
+
+static inline noe_Color noe_mu_color(mu_Color c)
+{
+    return noe_rgba(c.r, c.g, c.b, c.a);
+}
+
+bool noe_mu_render(noe_MuRenderer *r, noe_Context *ctx, mu_Context *mu)
+{
+    uint64_t hash = noe_mu_hash_commands(mu);
+    int w = noe_screen_width(ctx), h = noe_screen_height(ctx);
+    if(r->has_frame && hash == r->last_hash && w == r->last_w && h == r->last_h) {
+        noe_skip_present(ctx);
+        return false;
+    }
+    r->last_hash = hash;
+    r->last_w = w;
+    r->last_h = h;
+    r->has_frame = true;
+
+    noe_clear_background(ctx, r->clear_color);
+    bool clipped = false;
+    mu_Command *cmd = NULL;
+    while(mu_next_command(mu, &cmd)) {
+        switch(cmd->type) {
+            case MU_COMMAND_CLIP:
+                {
+                    if(clipped) noe_pop_clip_rect(ctx);
+                    mu_Rect c = cmd->clip.rect;
+                    noe_push_clip_rect(ctx, noe_rect(c.x, c.y, c.w, c.h));
+                    clipped = true;
+                } break;
+            case MU_COMMAND_RECT:
+                {
+                    mu_Rect rc = cmd->rect.rect;
+                    if(cmd->rect.color.a == 0) break;
+                    noe_draw_rect(ctx, noe_mu_color(cmd->rect.color), noe_rect(rc.x, rc.y, rc.w, rc.h));
+                } break;
+            case MU_COMMAND_TEXT:
+                {
+                    const noe_Font *font = cmd->text.font ? cmd->text.font : &r->font;
+                    noe_draw_text(ctx, *font, noe_mu_color(cmd->text.color), cmd->text.str,
+                            cmd->text.pos.x, cmd->text.pos.y, font->atlas.h);
+                } break;
+            case MU_COMMAND_ICON:
+                {
+                    mu_Rect rc = cmd->icon.rect;
+                    if(cmd->icon.id <= 0 || cmd->icon.id >= MU_ICON_MAX) break;
+                    noe_Rect src = noe_rect(cmd->icon.id * NOE_MU_ICON_SIZE, 0, NOE_MU_ICON_SIZE, NOE_MU_ICON_SIZE);
+                    noe_Rect dst = noe_rect(rc.x + (rc.w - NOE_MU_ICON_SIZE)/2, rc.y + (rc.h - NOE_MU_ICON_SIZE)/2,
+                            NOE_MU_ICON_SIZE, NOE_MU_ICON_SIZE);
+                    noe_draw_mask(ctx, r->icons, src, dst, noe_mu_color(cmd->icon.color));
+                } break;
+        }
+    }
+    if(clipped) noe_pop_clip_rect(ctx);
+    return true;
+}
@@ -0,0 +1,42 @@
+//
+// microui renderer backend for Noe. Translates the command list of a
+// mu_Context into noe draw calls and skips the whole frame when the command
+// list did not change since the last one that was rendered.
+//
+
+#ifndef NOE_MICROUI_H_
+#define NOE_MICROUI_H_
+
+#include "noe.h"
+#include "vendors/microui.h"
+
+#define NOE_MU_ICON_SIZE 16
+#define NOE_MU_SCROLL_SPEED 30 // pixels per wheel notch
+
+typedef struct noe_MuRenderer {
+    noe_Font font;
+    noe_Image icons;         // grayscale atlas, one NOE_MU_ICON_SIZE square per MU_ICON_*
+    noe_Color clear_color;   // the target is cleared with it before a frame is rendered
+    uint64_t last_hash;
+    int last_w, last_h;
+    bool has_frame;
+} noe_MuRenderer;
+
+// Installs the text measuring callbacks on `mu` and bakes the icon atlas.
+// The font is borrowed and must outlive the renderer.
+void noe_mu_init(noe_MuRenderer *r, mu_Context *mu, noe_Font font);
+void noe_mu_deinit(noe_MuRenderer *r);
+
+// Feeds the cursor, mouse buttons, wheel, control keys and typed text of this
+// frame into microui
+void noe_mu_input(noe_Context *ctx, mu_Context *mu);
+
+// Renders the command list of `mu` after mu_end(). When it hashes to the same
+// value as the last rendered frame nothing is drawn, the next present is
+// skipped and false is returned. The renderer assumes it owns the whole frame.
+bool noe_mu_render(noe_MuRenderer *r, noe_Context *ctx, mu_Context *mu);
+
+// Forgets the last frame so the next noe_mu_render always draws
+void noe_mu_invalidate(noe_MuRenderer *r);
+
+#endif // NOE_MICROUI_H_
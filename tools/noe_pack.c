@@ -0,0 +1,144 @@
+// Builds a noe asset pack out of files.
+//
+// Usage: noe_pack [options] -o <out.pack> <files...>
+//   -c, --compress        compress entries that shrink enough
+//   -f, --format <name>   pixel format images are stored in: rgba, rgb, bgra (default), bgr, gray
+//   -s, --font-size <n>   size fonts are baked at (default 16)
+//   -r, --raw             store every file as it is, without decoding
+//
+// Entries are named after the path given on the command line. Images that
+// stb_image can decode are stored as pixels and .ttf files as baked fonts,
+// anything else is stored as it is.
+
+#include "../noe.h"
+#include "../noe_ext.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *g_format_names[_COUNT_NOE_PIXELFORMATS] = {
+    "rgba", "rgb", "bgra", "bgr", "gray",
+};
+
+static bool has_extension(const char *path, const char *ext)
+{
+    size_t len = strlen(path), ext_len = strlen(ext);
+    if(len < ext_len) return false;
+    for(size_t i = 0; i < ext_len; ++i) {
+        char c = path[len - ext_len + i];
+        if(c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if(c != ext[i]) return false;
+    }
+    return true;
+}
+
+static void *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if(!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void *data = len >= 0 ? malloc(len ? len : 1) : NULL;
+    if(data && fread(data, 1, len, f) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *size = len;
+    return data;
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-c] [-r] [-f rgba|rgb|bgra|bgr|gray] [-s <font size>] -o <out.pack> <files...>\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    const char *out = NULL;
+    bool compress = false, raw = false;
+    int format = NOE_PIXELFORMAT_B8G8R8A8;
+    int fontsize = 16;
+    int first_file = argc;
+
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--compress") == 0) compress = true;
+        else if(strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--raw") == 0) raw = true;
+        else if((strcmp(argv[i], "-o") == 0) && i + 1 < argc) out = argv[++i];
+        else if((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--font-size") == 0) && i + 1 < argc) fontsize = atoi(argv[++i]);
+        else if((strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--format") == 0) && i + 1 < argc) {
+            const char *name = argv[++i];
+            format = -1;
+            for(int f = 0; f < _COUNT_NOE_PIXELFORMATS; ++f) {
+                if(strcmp(name, g_format_names[f]) == 0) format = f;
+            }
+            if(format < 0) {
+                fprintf(stderr, "Unknown pixel format %s\n", name);
+                return 1;
+            }
+        } else if(argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+    if(!out || first_file == argc || fontsize <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    noe_PackWriter *writer = noe_pack_writer_begin(out);
+    if(!writer) {
+        fprintf(stderr, "Failed to create %s\n", out);
+        return 1;
+    }
+
+    int failures = 0;
+    for(int i = first_file; i < argc; ++i) {
+        const char *path = argv[i];
+        const char *kind = "data";
+        bool ok = false, stored = false;
+        int w, h, channels;
+
+        if(!raw && has_extension(path, ".ttf")) {
+            noe_Font font = noe_load_font_from_ttf(path, fontsize);
+            if(font.atlas.pixels) {
+                kind = "font";
+                ok = noe_pack_write_font(writer, path, font, compress);
+                stored = true;
+                noe_unload_image(font.atlas);
+                noe_unload_font(font);
+            }
+        } else if(!raw && noe_probe_image_file(path, &w, &h, &channels)) {
+            noe_Image image = noe_load_image_from_file(path, format);
+            if(image.pixels) {
+                kind = "image";
+                ok = noe_pack_write_image(writer, path, image, compress);
+                stored = true;
+                noe_unload_image(image);
+            }
+        }
+        if(!stored) {
+            size_t size = 0;
+            void *data = read_file(path, &size);
+            if(data) ok = noe_pack_write_data(writer, path, data, size, compress);
+            free(data);
+        }
+
+        if(ok) {
+            printf("%-6s %s\n", kind, path);
+        } else {
+            fprintf(stderr, "Failed to pack %s\n", path);
+            failures += 1;
+        }
+    }
+
+    if(!noe_pack_writer_end(writer)) {
+        fprintf(stderr, "Failed to write %s\n", out);
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}